@@ -11,5 +11,19 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_GETPID  11
+#define SYS_READV   12
+#define SYS_WRITEV  13
+#define SYS_RING_SETUP  14
+#define SYS_RING_ENTER  15
+#define SYS_PIPE    16
+#define SYS_DUP2    17
+#define SYS_SPAWN   18
+#define SYS_POLL    19
+#define SYS_IOCTL   20
+#define SYS_YIELD   21
+#define SYS_VIDFLUSH 22
+#define SYS_SETMODE 23
+#define SYS_FBMAP 24
 
 #endif /* ECE391SYSNUM_H */
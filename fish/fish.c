@@ -5,6 +5,7 @@
 
 #define NULL 0
 #define WAIT 100
+#define SBUFSIZE 33
 uint8_t *vmem_base_addr;
 uint8_t *mp1_set_video_mode (void);
 void add_frames(uint8_t *, uint8_t *, int32_t);
@@ -20,10 +21,63 @@ extern void mp1_rtc_tasklet(unsigned long trash);
 
 static struct mp1_blink_struct blink_array[80*25];
 
+/* Frame timing, "fish -b" draws in RAM and flushes each frame */
+static int32_t double_buffer = 0;
+static uint32_t frames, frame_sum, frame_max, exposed_sum;
+
+/* Read the time stamp counter, only the low word is needed for deltas */
+static uint32_t
+rdtsc_low (void)
+{
+    uint32_t low, high;
+    asm volatile ("rdtsc" : "=a" (low), "=d" (high));
+    return low;
+}
+
+static void
+put_num (const char* before, uint32_t num, const char* after)
+{
+    uint8_t buf[SBUFSIZE];
+    int32_t i = SBUFSIZE - 1;
+
+    buf[i] = '\0';
+    do {
+        buf[--i] = '0' + num % 10;
+        num /= 10;
+    } while (num != 0);
+    ece391_fdputs (1, (uint8_t*)before);
+    ece391_fdputs (1, buf + i);
+    ece391_fdputs (1, (uint8_t*)after);
+}
+
+/*
+ * Draw one frame.  The screen shows a half drawn frame while the
+ * tasklet writes VRAM, or while the kernel copies the changed rows.
+ */
+static void
+draw_frame (int garbage)
+{
+    uint32_t start, drawn, shown;
+
+    start = rdtsc_low ();
+    mp1_rtc_tasklet (garbage);
+    drawn = rdtsc_low ();
+    if (double_buffer)
+        (void)ece391_vidflush ();
+    shown = rdtsc_low ();
+
+    frames++;
+    frame_sum += shown - start;
+    if (shown - start > frame_max)
+        frame_max = shown - start;
+    exposed_sum += double_buffer ? shown - drawn : drawn - start;
+}
+
 int main(void)
 {
     int rtc_fd, ret_val, i, garbage;
     struct mp1_blink_struct blink_struct;
+    uint8_t arg[SBUFSIZE];
 
     ece391_memset(blink_array, 0, sizeof(struct mp1_blink_struct)*80*25);
 
@@ -31,6 +85,13 @@ int main(void)
         return -1;
     }
 
+    if(0 == ece391_getargs(arg, SBUFSIZE) && '-' == arg[0] && 'b' == arg[1]) {
+        if(-1 == ece391_ioctl(0, TCSETVIDBUF, 1)) {
+            return -1;
+        }
+        double_buffer = 1;
+    }
+
     rtc_fd = ece391_open((uint8_t*)"rtc");
 
     add_frames(file0, file1, rtc_fd);
@@ -40,7 +101,7 @@ int main(void)
 
     for(i=0; i<WAIT; i++) {
         ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        draw_frame(garbage);
     }
 
     blink_struct.on_char = 'I';
@@ -53,25 +114,31 @@ int main(void)
 
     for(i=0; i<WAIT; i++) {
         ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        draw_frame(garbage);
     }
 
     mp1_ioctl((40 << 16 | (6*80+60)), RTC_SYNC);
 
     for(i=0; i<WAIT; i++) {
         ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        draw_frame(garbage);
     }
 
     mp1_ioctl(6*80+60, RTC_REMOVE);
 
     for(i=0; i<WAIT; i++) {
         ece391_read(rtc_fd, &garbage, 4);
-        mp1_rtc_tasklet(garbage);
+        draw_frame(garbage);
     }
 
     ece391_close(rtc_fd);
 
+    if(frames != 0) {
+        put_num(double_buffer ? "double buffered: " : "in place: ", frames, " frames");
+        put_num(", avg ", frame_sum / frames, " cycles");
+        put_num(", max ", frame_max, "");
+        put_num("; half drawn on screen for ", exposed_sum / frames, " cycles per frame\n");
+    }
     return 0;
 }
 
@@ -0,0 +1,358 @@
+/**
+ *  ansi.c - ANSI escape sequence parser of the terminal
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: ECMA-48, VT100 User Guide, vt100.net DEC parser
+ */
+
+#include "ansi.h"
+#include "lib.h"
+
+// Byte classes, the columns of the state table
+#define CLASS_CTRL 0                    // C0 controls and DEL
+#define CLASS_ESC 1
+#define CLASS_DIGIT 2
+#define CLASS_SEMI 3
+#define CLASS_PRIV 4                    // < = > ?
+#define CLASS_INTER 5                   // Intermediates, space to /
+#define CLASS_LBRACKET 6
+#define CLASS_FINAL 7                   // @ to ~ but [
+#define CLASS_OTHER 8                   // : and bytes above DEL
+#define CLASS_COUNT 9
+
+// Parser actions of the state table
+#define DO_NONE 0
+#define DO_PRINT 1
+#define DO_EXECUTE 2
+#define DO_START 3                      // ESC, forget the sequence before
+#define DO_PARAM 4
+#define DO_SEP 5
+#define DO_PRIV 6
+#define DO_CSI 7
+#define DO_ESC 8
+
+// Action and next state of a byte class in a state
+typedef struct ansi_edge_t
+{
+    uint8_t action;
+    uint8_t next;
+} ansi_edge_t;
+
+static const ansi_edge_t ansi_table[ANSI_STATE_COUNT][CLASS_COUNT] =
+{
+    // ANSI_GROUND, only ESC starts a sequence
+    {
+        { DO_PRINT, ANSI_GROUND },      // CTRL
+        { DO_START, ANSI_ESCAPE },      // ESC
+        { DO_PRINT, ANSI_GROUND },      // DIGIT
+        { DO_PRINT, ANSI_GROUND },      // SEMI
+        { DO_PRINT, ANSI_GROUND },      // PRIV
+        { DO_PRINT, ANSI_GROUND },      // INTER
+        { DO_PRINT, ANSI_GROUND },      // LBRACKET
+        { DO_PRINT, ANSI_GROUND },      // FINAL
+        { DO_PRINT, ANSI_GROUND }       // OTHER
+    },
+    // ANSI_ESCAPE, ESC 7 and ESC 8 end with a digit. An intermediate
+    // such as the ( of ESC ( B moves on to ANSI_ESC_INTER.
+    {
+        { DO_EXECUTE, ANSI_ESCAPE },
+        { DO_START, ANSI_ESCAPE },
+        { DO_ESC, ANSI_GROUND },
+        { DO_NONE, ANSI_GROUND },
+        { DO_ESC, ANSI_GROUND },
+        { DO_NONE, ANSI_ESC_INTER },
+        { DO_START, ANSI_CSI },
+        { DO_ESC, ANSI_GROUND },
+        { DO_NONE, ANSI_GROUND }
+    },
+    // ANSI_CSI
+    {
+        { DO_EXECUTE, ANSI_CSI },
+        { DO_START, ANSI_ESCAPE },
+        { DO_PARAM, ANSI_CSI },
+        { DO_SEP, ANSI_CSI },
+        { DO_PRIV, ANSI_CSI },
+        { DO_NONE, ANSI_IGNORE },
+        { DO_CSI, ANSI_GROUND },
+        { DO_CSI, ANSI_GROUND },
+        { DO_NONE, ANSI_IGNORE }
+    },
+    // ANSI_IGNORE, up to the final byte
+    {
+        { DO_EXECUTE, ANSI_IGNORE },
+        { DO_START, ANSI_ESCAPE },
+        { DO_NONE, ANSI_IGNORE },
+        { DO_NONE, ANSI_IGNORE },
+        { DO_NONE, ANSI_IGNORE },
+        { DO_NONE, ANSI_IGNORE },
+        { DO_NONE, ANSI_GROUND },
+        { DO_NONE, ANSI_GROUND },
+        { DO_NONE, ANSI_IGNORE }
+    },
+    // ANSI_ESC_INTER, character set and other selections are not
+    // supported, the final byte ends them without an action. So
+    // ESC ( D is not taken for ESC D.
+    {
+        { DO_EXECUTE, ANSI_ESC_INTER },
+        { DO_START, ANSI_ESCAPE },
+        { DO_NONE, ANSI_GROUND },
+        { DO_NONE, ANSI_GROUND },
+        { DO_NONE, ANSI_GROUND },
+        { DO_NONE, ANSI_ESC_INTER },
+        { DO_NONE, ANSI_GROUND },
+        { DO_NONE, ANSI_GROUND },
+        { DO_NONE, ANSI_GROUND }
+    }
+};
+
+// VGA color of each ANSI color, black red green yellow blue magenta cyan white
+static const uint8_t ansi_vga[8] = { 0, 4, 2, 6, 1, 5, 3, 7 };
+
+/*
+ * ansi_class
+ *   DESCRIPTION: Column of a byte in the state table
+ *   INPUTS: c - byte written
+ *   OUTPUTS: none
+ *   RETURN VALUE: CLASS_ of the byte
+ *   SIDE EFFECTS: none
+ */
+static uint8_t ansi_class(uint8_t c)
+{
+    if (c == ANSI_ESC)
+    {
+        return CLASS_ESC;
+    }
+    if (c < 0x20 || c == 0x7F)
+    {
+        return CLASS_CTRL;
+    }
+    if (c < 0x30)
+    {
+        return CLASS_INTER;
+    }
+    if (c <= '9')
+    {
+        return CLASS_DIGIT;
+    }
+    if (c == ';')
+    {
+        return CLASS_SEMI;
+    }
+    if (c >= '<' && c <= '?')
+    {
+        return CLASS_PRIV;
+    }
+    if (c == '[')
+    {
+        return CLASS_LBRACKET;
+    }
+    if (c >= '@' && c < 0x7F)
+    {
+        return CLASS_FINAL;
+    }
+    return CLASS_OTHER;
+}
+
+/*
+ * ansi_reset
+ *   DESCRIPTION: Drop a sequence half read, colors set by SGR and
+ *                the scroll region of a terminal.
+ *   INPUTS: ansi - state of the terminal
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void ansi_reset(ansi_t* ansi)
+{
+    ansi->state = ANSI_GROUND;
+    ansi->priv = 0;
+    ansi->final = 0;
+    ansi->nparams = 0;
+    ansi->attr = 0;
+    ansi->reverse = 0;
+    ansi->top = 0;
+    ansi->bottom = NUM_ROWS - 1;
+    ansi->saved_x = 0;
+    ansi->saved_y = 0;
+}
+
+/*
+ * ansi_feed
+ *   DESCRIPTION: Feed the next byte written to the state table.
+ *   INPUTS: ansi - state of the terminal
+ *           c - byte written
+ *   OUTPUTS: none
+ *   RETURN VALUE: ANSI_ACT_PRINT or ANSI_ACT_EXECUTE if the caller
+ *                 handles the byte as usual, ANSI_ACT_CSI or
+ *                 ANSI_ACT_ESC once a sequence is complete with its
+ *                 final byte and parameters in ansi, ANSI_ACT_NONE
+ *                 otherwise
+ *   SIDE EFFECTS: Parameters above ANSI_MAX_PARAM are clamped, those
+ *                 after ANSI_MAX_PARAMS are dropped.
+ */
+int32_t ansi_feed(ansi_t* ansi, uint8_t c)
+{
+    const ansi_edge_t* edge = &ansi_table[ansi->state][ansi_class(c)];
+    uint16_t* param;
+
+    ansi->state = edge->next;
+    switch (edge->action)
+    {
+        case DO_PRINT:
+            return ANSI_ACT_PRINT;
+
+        case DO_EXECUTE:
+            return ANSI_ACT_EXECUTE;
+
+        case DO_START:
+            ansi->priv = 0;
+            ansi->nparams = 0;
+            memset(ansi->params, 0, sizeof(ansi->params));
+            return ANSI_ACT_NONE;
+
+        case DO_PARAM:
+            if (ansi->nparams == 0)
+            {
+                ansi->nparams = 1;
+            }
+            if (ansi->nparams <= ANSI_MAX_PARAMS)
+            {
+                param = &ansi->params[ansi->nparams - 1];
+                *param = *param * 10 + (c - '0');
+                if (*param > ANSI_MAX_PARAM)
+                {
+                    *param = ANSI_MAX_PARAM;
+                }
+            }
+            return ANSI_ACT_NONE;
+
+        case DO_SEP:
+            // An empty parameter before the separator counts too
+            if (ansi->nparams == 0)
+            {
+                ansi->nparams = 1;
+            }
+            if (ansi->nparams <= ANSI_MAX_PARAMS)
+            {
+                ansi->nparams++;
+            }
+            return ANSI_ACT_NONE;
+
+        case DO_PRIV:
+            // Only valid before the parameters
+            if (ansi->nparams != 0 || ansi->priv != 0)
+            {
+                ansi->state = ANSI_IGNORE;
+                return ANSI_ACT_NONE;
+            }
+            ansi->priv = c;
+            return ANSI_ACT_NONE;
+
+        case DO_CSI:
+            ansi->final = c;
+            if (ansi->nparams > ANSI_MAX_PARAMS)
+            {
+                ansi->nparams = ANSI_MAX_PARAMS;
+            }
+            return ANSI_ACT_CSI;
+
+        case DO_ESC:
+            ansi->final = c;
+            return ANSI_ACT_ESC;
+
+        default:
+            return ANSI_ACT_NONE;
+    }
+}
+
+/*
+ * ansi_param
+ *   DESCRIPTION: Parameter of the sequence just complete.
+ *   INPUTS: ansi - state of the terminal
+ *           i - parameter number, from 0
+ *           def - value if the parameter is missing or 0
+ *   OUTPUTS: none
+ *   RETURN VALUE: parameter i or def
+ *   SIDE EFFECTS: none
+ */
+uint32_t ansi_param(const ansi_t* ansi, uint32_t i, uint32_t def)
+{
+    if (i >= ansi->nparams || ansi->params[i] == 0)
+    {
+        return def;
+    }
+    return ansi->params[i];
+}
+
+/*
+ * ansi_sgr
+ *   DESCRIPTION: Apply Select Graphic Rendition to an attribute.
+ *                0 resets to DEFAULT_COLOR, 1 and 22 set and clear
+ *                bright text, 7 and 27 turn reverse video on and off,
+ *                30 to 37, 39, 40 to 47, 49, 90 to 97 and 100 to 107
+ *                pick colors.
+ *   INPUTS: ansi - state of the terminal, final byte m
+ *           attr - attribute set so far, not reversed
+ *   OUTPUTS: none
+ *   RETURN VALUE: new attribute, 0 for DEFAULT_COLOR so kernel
+ *                 message colors show again
+ *   SIDE EFFECTS: 38 and 48 with 256 or RGB colors are not supported,
+ *                 they end the sequence.
+ */
+uint8_t ansi_sgr(ansi_t* ansi, uint8_t attr)
+{
+    uint32_t i, p;
+    uint32_t count = (ansi->nparams == 0) ? 1 : ansi->nparams;
+
+    for (i = 0; i < count; i++)
+    {
+        p = ansi->params[i];
+        if (p == 0)
+        {
+            attr = DEFAULT_COLOR;
+            ansi->reverse = 0;
+        }
+        else if (p == 1)
+        {
+            attr |= 0x08;
+        }
+        else if (p == 22)
+        {
+            attr &= ~0x08;
+        }
+        else if (p == 7 || p == 27)
+        {
+            // Kept apart from the colors, so 27 only undoes 7
+            ansi->reverse = (p == 7);
+        }
+        else if (p >= 30 && p <= 37)
+        {
+            attr = (attr & 0xF8) | ansi_vga[p - 30];
+        }
+        else if (p == 39)
+        {
+            attr = (attr & 0xF0) | (DEFAULT_COLOR & 0x0F);
+        }
+        else if (p >= 40 && p <= 47)
+        {
+            attr = (attr & 0x0F) | (ansi_vga[p - 40] << 4);
+        }
+        else if (p == 49)
+        {
+            attr = (attr & 0x0F) | (DEFAULT_COLOR & 0xF0);
+        }
+        else if (p >= 90 && p <= 97)
+        {
+            attr = (attr & 0xF0) | ansi_vga[p - 90] | 0x08;
+        }
+        else if (p >= 100 && p <= 107)
+        {
+            attr = (attr & 0x0F) | ((ansi_vga[p - 100] | 0x08) << 4);
+        }
+        else if (p == 38 || p == 48)
+        {
+            break;
+        }
+    }
+    return (attr == DEFAULT_COLOR) ? 0 : attr;
+}
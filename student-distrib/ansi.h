@@ -0,0 +1,64 @@
+/**
+ *  ansi.h - ANSI escape sequence parser of the terminal
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: ECMA-48, VT100 User Guide, vt100.net DEC parser
+ */
+
+#ifndef _ANSI_H
+#define _ANSI_H
+
+#include "types.h"
+
+#define ANSI_ESC 0x1B
+
+// Parameters kept of a control sequence, later ones are dropped
+#define ANSI_MAX_PARAMS 8
+#define ANSI_MAX_PARAM 9999
+
+// Parser states
+#define ANSI_GROUND 0                   // Plain text
+#define ANSI_ESCAPE 1                   // After ESC
+#define ANSI_CSI 2                      // After ESC [, reading parameters
+#define ANSI_IGNORE 3                   // Bad sequence, skipped to its final byte
+#define ANSI_ESC_INTER 4                // After ESC and an intermediate, e.g. ESC (
+#define ANSI_STATE_COUNT 5
+
+// What the caller does with the byte just fed
+#define ANSI_ACT_NONE 0                 // Taken by the parser
+#define ANSI_ACT_PRINT 1                // Not part of a sequence
+#define ANSI_ACT_EXECUTE 2              // Control character inside a sequence
+#define ANSI_ACT_CSI 3                  // Control sequence complete, see final
+#define ANSI_ACT_ESC 4                  // Escape sequence complete, see final
+
+#ifndef ASM
+
+// Parser and screen state of a terminal kept between writes
+typedef struct ansi_t
+{
+    uint8_t state;
+    uint8_t priv;                       // '?' before the parameters
+    uint8_t final;                      // Last byte of the sequence
+    uint8_t nparams;
+    uint16_t params[ANSI_MAX_PARAMS];
+    uint8_t attr;                       // Set by SGR, 0 for the kernel color
+    uint8_t reverse;                    // SGR 7, colors swapped as cells are written
+    uint8_t top, bottom;                // Scroll region, rows inclusive
+    uint8_t saved_x, saved_y;           // Cursor saved by ESC 7 or CSI s
+} ansi_t;
+
+// Drop a sequence half read, colors and the scroll region
+extern void ansi_reset(ansi_t* ansi);
+
+// Feed a byte to the parser, returns an ANSI_ACT_ code
+extern int32_t ansi_feed(ansi_t* ansi, uint8_t c);
+
+// Parameter i of the sequence, def if it is missing or 0
+extern uint32_t ansi_param(const ansi_t* ansi, uint32_t i, uint32_t def);
+
+// Apply an SGR sequence to an attribute byte and reverse video
+extern uint8_t ansi_sgr(ansi_t* ansi, uint8_t attr);
+
+#endif /* ASM */
+
+#endif /* _ANSI_H */
@@ -0,0 +1,252 @@
+/**
+ *  apic.c - Local APIC and IOAPIC interrupt controller
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: Intel x86 docs, 82093AA IOAPIC datasheet, OSDev
+ */
+
+#include "apic.h"
+#include "i8259.h"
+#include "paging.h"
+
+// File-scope variables
+static volatile uint32_t* lapic = NULL;
+static volatile uint32_t* ioapic = (volatile uint32_t*) IOAPIC_BASE;
+static uint32_t ioapic_pins = 0;
+static uint32_t lapic_id = 0;
+
+// LAPIC timer count for one scheduler tick
+static uint32_t timer_count = 0;
+
+// IOAPIC pin of each ISA IRQ, QEMU wires the PIT to pin 2
+static const uint8_t ioapic_pin[16] =
+{
+    2, 1, 0, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15
+};
+
+// File-scope helper functions
+// Helper function to access LAPIC registers
+static uint32_t lapic_read(uint32_t reg);
+static void lapic_write(uint32_t reg, uint32_t value);
+
+// Helper function to access IOAPIC registers
+static uint32_t ioapic_read(uint32_t reg);
+static void ioapic_write(uint32_t reg, uint32_t value);
+
+// Helper function to measure the LAPIC timer against the PIT
+static uint32_t apic_timer_calibrate(void);
+
+/* 
+ * apic_init
+ *   DESCRIPTION: Detect the LAPIC by CPUID and the IOAPIC at its
+ *                usual address. If both are there, mask the 8259,
+ *                mask every IOAPIC pin and calibrate the LAPIC
+ *                timer, which replaces the PIT as the scheduler
+ *                tick. IRQs keep their vectors from IRQ_OFFSET.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: apic_enable is set on success, call with
+ *                 interrupts off after i8259_init()
+ */
+void apic_init(void)
+{
+    uint32_t eax, ebx, ecx, edx, low, high, version, pin;
+
+    apic_enable = 0;
+#ifdef NO_APIC
+    printf("APIC disabled, using 8259.\n");
+    return;
+#endif
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_APIC))
+    {
+        printf("No local APIC, using 8259.\n");
+        return;
+    }
+
+    // LAPIC base comes from the MSR, IOAPIC sits in the same 4MB page on PCs
+    rdmsr(APIC_BASE_MSR, low, high);
+    lapic = (volatile uint32_t*) (low & APIC_BASE_MASK);
+    mapMMIOPage((uint32_t) lapic);
+    mapMMIOPage(IOAPIC_BASE);
+
+    version = ioapic_read(IOAPIC_VERSION);
+    if (version == 0xFFFFFFFF)
+    {
+        printf("No IOAPIC, using 8259.\n");
+        return;
+    }
+    ioapic_pins = ((version >> 16) & 0xFF) + 1;
+
+    // Nothing comes from the 8259 any more
+    outb(0xFF, Master_data);
+    outb(0xFF, Slave_data);
+
+    wrmsr(APIC_BASE_MSR, low | APIC_BASE_ENABLE, high);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_id = lapic_read(LAPIC_ID) >> 24;
+
+    for (pin = 0; pin < ioapic_pins; pin++)
+    {
+        ioapic_write(IOAPIC_REDIR + 2 * pin, IOAPIC_MASKED);
+        ioapic_write(IOAPIC_REDIR + 2 * pin + 1, lapic_id << 24);
+    }
+
+    timer_count = apic_timer_calibrate() * APIC_TIMER_MS / APIC_CALIBRATE_MS;
+    apic_enable = 1;
+    printf("LAPIC %u and IOAPIC with %u pins, timer count %u.\n", lapic_id, ioapic_pins, timer_count);
+}
+
+/* 
+ * apic_enable_irq
+ *   DESCRIPTION: Unmask an IRQ. ISA IRQs are routed by the IOAPIC
+ *                to this LAPIC, edge triggered. IRQ 0 starts the
+ *                LAPIC timer in periodic mode instead of the PIT.
+ *   INPUTS: irq_num - IRQ # to enable
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void apic_enable_irq(uint32_t irq_num)
+{
+    if (irq_num == 0)
+    {
+        lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | (ICW2_MASTER + irq_num));
+        lapic_write(LAPIC_TIMER_INIT, timer_count);
+        return;
+    }
+    if ((irq_num >= 16) || (ioapic_pin[irq_num] >= ioapic_pins))
+    {
+        return;
+    }
+    ioapic_write(IOAPIC_REDIR + 2 * ioapic_pin[irq_num], ICW2_MASTER + irq_num);
+}
+
+/* 
+ * apic_disable_irq
+ *   DESCRIPTION: Mask an IRQ
+ *   INPUTS: irq_num - IRQ # to disable
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: IRQ 0 stops the LAPIC timer
+ */
+void apic_disable_irq(uint32_t irq_num)
+{
+    if (irq_num == 0)
+    {
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+        return;
+    }
+    if ((irq_num >= 16) || (ioapic_pin[irq_num] >= ioapic_pins))
+    {
+        return;
+    }
+    ioapic_write(IOAPIC_REDIR + 2 * ioapic_pin[irq_num], IOAPIC_MASKED);
+}
+
+/* 
+ * apic_send_eoi
+ *   DESCRIPTION: End of interrupt to the LAPIC, which also ends
+ *                the interrupt for edge triggered IOAPIC pins.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void apic_send_eoi(void)
+{
+    lapic_write(LAPIC_EOI, 0);
+}
+
+/* 
+ * apic_timer_calibrate
+ *   DESCRIPTION: Count LAPIC timer ticks while PIT channel 2
+ *                counts down APIC_CALIBRATE_MS once.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: LAPIC timer ticks in APIC_CALIBRATE_MS
+ *   SIDE EFFECTS: PC speaker gate is left off
+ */
+static uint32_t apic_timer_calibrate(void)
+{
+    uint8_t gate;
+
+    // Gate channel 2 on with the speaker off, one shot mode
+    gate = (inb(0x61) & ~0x02) | 0x01;
+    outb(gate & ~0x01, 0x61);
+    outb(0xB0, 0x43);
+    outb(APIC_CALIBRATE_COUNT & 0xFF, 0x42);
+    outb(APIC_CALIBRATE_COUNT >> 8, 0x42);
+
+    lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    outb(gate, 0x61);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+
+    // Output of channel 2 goes high when it reaches 0
+    while (!(inb(0x61) & 0x20));
+
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    outb(gate & ~0x01, 0x61);
+    return 0xFFFFFFFF - lapic_read(LAPIC_TIMER_CURRENT);
+}
+
+/* 
+ * lapic_read
+ *   DESCRIPTION: Read a LAPIC register
+ *   INPUTS: reg - register offset
+ *   OUTPUTS: none
+ *   RETURN VALUE: register value
+ *   SIDE EFFECTS: none
+ */
+static uint32_t lapic_read(uint32_t reg)
+{
+    return lapic[reg >> 2];
+}
+
+/* 
+ * lapic_write
+ *   DESCRIPTION: Write a LAPIC register
+ *   INPUTS: reg - register offset, value - new value
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void lapic_write(uint32_t reg, uint32_t value)
+{
+    lapic[reg >> 2] = value;
+}
+
+/* 
+ * ioapic_read
+ *   DESCRIPTION: Read an IOAPIC register through its window
+ *   INPUTS: reg - register index
+ *   OUTPUTS: none
+ *   RETURN VALUE: register value
+ *   SIDE EFFECTS: none
+ */
+static uint32_t ioapic_read(uint32_t reg)
+{
+    ioapic[IOAPIC_REGSEL >> 2] = reg;
+    return ioapic[IOAPIC_WINDOW >> 2];
+}
+
+/* 
+ * ioapic_write
+ *   DESCRIPTION: Write an IOAPIC register through its window
+ *   INPUTS: reg - register index, value - new value
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void ioapic_write(uint32_t reg, uint32_t value)
+{
+    ioapic[IOAPIC_REGSEL >> 2] = reg;
+    ioapic[IOAPIC_WINDOW >> 2] = value;
+}
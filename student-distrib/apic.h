@@ -0,0 +1,77 @@
+/**
+ *  apic.h - Local APIC and IOAPIC interrupt controller
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: Intel x86 docs, 82093AA IOAPIC datasheet, OSDev
+ */
+
+#ifndef _APIC_H
+#define _APIC_H
+
+// Define to keep the 8259 even if an APIC is found, e.g. to compare
+// interrupt latency of both controllers in the process manager
+// #define NO_APIC
+
+// CPUID and MSR
+#define CPUID_APIC (1 << 9)
+#define APIC_BASE_MSR 0x1B
+#define APIC_BASE_ENABLE (1 << 11)
+#define APIC_BASE_MASK 0xFFFFF000
+
+// Local APIC registers, offsets from its base
+#define LAPIC_ID 0x20
+#define LAPIC_EOI 0xB0
+#define LAPIC_SVR 0xF0
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_LVT_LINT0 0x350
+#define LAPIC_LVT_LINT1 0x360
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3E0
+
+#define LAPIC_SVR_ENABLE (1 << 8)
+#define LAPIC_LVT_MASKED (1 << 16)
+#define LAPIC_TIMER_PERIODIC (1 << 17)
+#define LAPIC_TIMER_DIV16 0x3
+
+// IOAPIC, at the address every PC and QEMU use
+#define IOAPIC_BASE 0xFEC00000
+#define IOAPIC_REGSEL 0x00
+#define IOAPIC_WINDOW 0x10
+#define IOAPIC_VERSION 0x01
+#define IOAPIC_REDIR 0x10
+#define IOAPIC_MASKED (1 << 16)
+
+// Vector for spurious LAPIC interrupts, low 4 bits must be set
+#define APIC_SPURIOUS_VECTOR 0xFF
+
+// The LAPIC timer ticks as often as the PIT did at its 18.2 Hz default
+#define APIC_TIMER_MS 55
+
+// PIT channel 2 counts 10 ms to calibrate the LAPIC timer
+#define APIC_CALIBRATE_MS 10
+#define APIC_CALIBRATE_COUNT 11932
+
+#include "types.h"
+
+#ifndef ASM
+
+#include "lib.h"
+
+// Set if interrupts go through the IOAPIC and LAPIC instead of the 8259
+uint8_t apic_enable;
+
+// Detect and start the LAPIC and IOAPIC, the 8259 stays on if none
+extern void apic_init(void);
+
+// Unmask an IRQ, IRQ 0 is the LAPIC timer
+extern void apic_enable_irq(uint32_t irq_num);
+
+// Mask an IRQ
+extern void apic_disable_irq(uint32_t irq_num);
+
+// End of interrupt, one register write
+extern void apic_send_eoi(void);
+
+#endif /* ASM */
+#endif /* _APIC_H */
@@ -26,30 +26,25 @@ void unified_exception_handler(const int code, const int error)
      *  This kernel debug tool will override whatever current PCB,
      *  and put stuff on the active terminal. --PL
      */
-    // Backup progress flag
-    uint8_t progress_indicator = progress;
+    // A kernel section was interrupted if preemption was already off
+    uint32_t preempt_indicator = preempt_count;
 
-    // Set Progress Flag
-    progress = 1;
+    // Keep the scheduler away while the active terminal is borrowed
+    preempt_disable();
 
     // Mask the signal
     pcb->sig_mask = 1;
 
-    // Save current video mem pointer
-    char* vram_ptr_backup = video_mem;
-    video_mem = (char *) VIDEO_MEM_ADDR;
-
-    // Save VRAM information
-    int x_backup = screen_x;
-    int y_backup = screen_y;
-    
-    // Set coordinates accordingly
-    if (pcb->terminal_id != terminal_active)
+    // The kernel is rebooted below, it may have faulted while writing the screen
+    if (preempt_indicator && spin_is_locked(&terminal_lock))
     {
-        screen_x = terminals[terminal_active].screen_x;
-        screen_y = terminals[terminal_active].screen_y;
+        spin_unlock(&terminal_lock);
     }
 
+    // Point kernel output at the active terminal
+    screen_save_t save;
+    terminal_borrow(&save, NULL);
+
     // Print the exception message
     printf("\n<!> ");
     switch (code)
@@ -142,7 +137,7 @@ void unified_exception_handler(const int code, const int error)
 
     // Halt the program or OS
     // Determine if the exception happened is recoverable
-    if (progress_indicator)
+    if (preempt_indicator)
     {
         // Do something wild here, trigger a triple fault
         char prompt[] = "<!> Exception happened in kernel. Press any key to reboot the OS.\n";
@@ -179,24 +174,11 @@ void unified_exception_handler(const int code, const int error)
             sig_set(pcb, SEGFAULT);
         }
         
-        // Restore coordinates accordingly
-        if (pcb->terminal_id != terminal_active)
-        {
-            terminals[terminal_active].screen_x = screen_x;
-            terminals[terminal_active].screen_y = screen_y;
-            screen_x = x_backup;
-            screen_y = y_backup;
-        }
-
         // Restore video mem pointer and reset cursor
-        video_mem = vram_ptr_backup;
-        if ((video_mem == ((char *) VIDEO_MEM_ADDR)))
-        {
-            set_cursor_loc(screen_x, screen_y);
-        }
+        terminal_return(&save);
 
-        // Clear progress flag and kill the process
-        progress = 0;
+        // Allow switching again and kill the process
+        preempt_enable();
     }
 
     // Should never return here
@@ -30,12 +30,17 @@ int32_t file_sys_init(uint32_t file_start_addr)
  * buf - write data to this buffer
  * nbytes - bytes to be write
  * Outputs:	return read data result
- * Side Effects: none
+ * Side Effects: file_position of the FD advances by the bytes read
  */
 int32_t file_read (int32_t fd, void* buf, int32_t nbytes)
 {
-    uint32_t inode_index = (uint32_t) ((uint8_t *) buf)[0];
-    return read_data(inode_index, fd, (uint8_t *) buf, nbytes);
+    file_desc_t* file = &((pcb->file_descriptor)[fd]);
+    int32_t bytes_read;
+
+    if (nbytes == 0) { return 0; }
+    bytes_read = read_data(file->inode, file->file_position, (uint8_t *) buf, nbytes);
+    if (bytes_read > 0) { file->file_position += bytes_read; }
+    return bytes_read;
 }
 
 /* Function: file_write
@@ -79,6 +84,19 @@ int32_t file_close (int32_t fd)
     return 0;
 }
 
+/* Function: file_poll
+ * Description: poll entry of files and directories, which never wait
+ * Inputs: 
+ * fd - int32_t representing index to file desc array
+ * wait - ignored, there is nothing to wait for
+ * Outputs: return POLLIN | POLLOUT
+ * Side Effects: none
+ */
+int32_t file_poll (int32_t fd, uint8_t wait)
+{
+    return POLLIN | POLLOUT;
+}
+
 /* Function: dir_open
  * Description: open the dirctory and populate file name to open file dentry
  * Inputs: 
@@ -125,31 +143,32 @@ int dir_write(int32_t fd, const void* buf, int32_t nbytes)
 
 /* Function: dir_read (index)
  * Description: read an individiual file name in a directory
-                given a specific dentry index.
-                Prints file information to the screen
+                at the dentry index kept in file_position of the FD.
  * Inputs: 
- * index - specific dentry index in bootblock
- * Outputs:	return 0 if index is found. return -1 if no matching index dentry found
- * Side Effects: none
+ * fd - int32_t representing index to file desc array
+ * Outputs:	return nbytes if index is found. return 0 if all entries are read
+ * Side Effects: file_position of the FD advances to the next dentry
  */
 int dir_read(int32_t fd, void* buf, int32_t nbytes)
 {
     dentry_t currFile;
+    file_desc_t* dir = &((pcb->file_descriptor)[fd]);
 
-    // Check if FD is completely invalid (negative)
-    if (fd < 0)
+    // Check if position is completely invalid (negative)
+    if (dir->file_position < 0)
     {
-        printf("dir_read: Incorrect position %d specified to dir_read.\n", fd);
+        printf("dir_read: Incorrect position %d specified to dir_read.\n", dir->file_position);
         return -1;
     }
 
-    // If FD is not found by index, read is completed, return 0
-    if (read_dentry_by_index((uint32_t)fd, &currFile) == -1) 
+    // If position is not found by index, read is completed, return 0
+    if (read_dentry_by_index((uint32_t) dir->file_position, &currFile) == -1) 
     {
         return 0;
     }
 
     memcpy(buf, currFile.file_name, nbytes);
+    dir->file_position++;
 
     return nbytes;
 }
@@ -190,12 +209,13 @@ int dir_read2(int32_t fd, void* buf, int32_t nbytes) // use open_file_dentry
  * fname - filename
  * dentry - directory entry pointer
  * Outputs:	return 0 if name matching found. return -1 if no matching found
- * Side Effects: none
+ * Side Effects: takes fs_lock
  */
 int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry)                /* uint8_t ptr to an array of characters */
 {
     int i;
     uint32_t currAddr;
+    int32_t ret = -1;
 
     if (strlen((int8_t*)fname) > 32)
     { 
@@ -204,6 +224,7 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry)
     }
 
     /* loop over directory entries in boot block to find name matching object */
+    spin_lock(&fs_lock);
     for(i = file_sys_start_addr + BOOT_BLOCK_OFFSET; i < file_sys_start_addr + TOTAL_BLOCK_SIZE; i += 64)
     {
         currAddr = i;
@@ -218,10 +239,12 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry)
             currAddr += 4;                                                          /* increment current address by 4 bytes to get to start of inode_number address */
     
             dentry -> inode_number = *((uint32_t *) currAddr);                      /* copy inode number to struct */
-            return 0;
+            ret = 0;
+            break;
         }
     }
-    return -1;
+    spin_unlock(&fs_lock);
+    return ret;
 }
 
 /* Function: read_dentry_by_index
@@ -230,14 +253,16 @@ int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry)
  * index - directory index in boot block
  * dentry - directory entry pointer
  * Outputs:	return 0 if copy suceess. return -1 if unsuccess
- * Side Effects: none
+ * Side Effects: takes fs_lock
  */
 int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry)
 {
     // Check if the index exists
+    spin_lock(&fs_lock);
     unsigned int entries_count = *((unsigned int*) file_sys_start_addr);
     if (index >= entries_count)
     {
+        spin_unlock(&fs_lock);
         return -1;
     }
 
@@ -248,6 +273,7 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry)
     boot_block_start_addr += 32;
     dentry -> file_type = *((uint32_t *) boot_block_start_addr);
     dentry -> inode_number = *((uint32_t *) inode_num);
+    spin_unlock(&fs_lock);
     return 0;
 }
 
@@ -260,7 +286,8 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry)
  * buf - write data to this buffer
  * length - THIS IS THE SIZE OF BUFFER IN BYTES.
  * Outputs - return 0 if valid inode number, return -1 if invalid inode number
- * Side Effects: none
+ * Side Effects: holds fs_lock for each data block, may switch to another
+ *               process between them unless preemption is disabled
  */
 int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length)
 {   
@@ -273,9 +300,11 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
 
     // Get the count of inode
     uint32_t inode_num;
+    spin_lock(&fs_lock);
     inode_num = *((uint32_t *)(file_sys_start_addr + 4));
     if (!(inode_num > inode))
     {
+        spin_unlock(&fs_lock);
         printf("read_data: Invalid buffer pointer.\n");
         return -1;
     }
@@ -315,7 +344,16 @@ int32_t read_data (uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t lengt
         length--;
         file_size_remaining--;
         bytes_read++;
+
+        // Safe point between data blocks, so a large read can be preempted
+        if (((datablock_internal_offset + bytes_read) % TOTAL_BLOCK_SIZE) == 0)
+        {
+            spin_unlock(&fs_lock);
+            cond_resched();
+            spin_lock(&fs_lock);
+        }
     }
+    spin_unlock(&fs_lock);
     
     return bytes_read;
 }
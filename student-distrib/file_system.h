@@ -37,6 +37,9 @@ int32_t file_open (const uint8_t* filename);
 /* close file */
 int32_t file_close (int32_t fd);
 
+/* poll file or directory, always ready */
+int32_t file_poll (int32_t fd, uint8_t wait);
+
 /* directory open */
 int dir_open(const uint8_t* filename);
 
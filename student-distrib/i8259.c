@@ -3,6 +3,7 @@
  */
 
 #include "i8259.h"
+#include "apic.h"
 #include "lib.h"
 
 /* Interrupt masks to determine which interrupts are enabled and disabled */
@@ -52,7 +53,8 @@ void i8259_init(void)
  *   INPUTS: irq_num - IRQ # to enable
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: PIC will unmask the requested IRQ #.
+ *   SIDE EFFECTS: PIC will unmask the requested IRQ #, or
+ *                 the APIC if it is in use.
  *   REFERENCE: https://wiki.osdev.org/8259_PIC
  */
 void enable_irq(uint32_t irq_num)
@@ -60,6 +62,12 @@ void enable_irq(uint32_t irq_num)
     uint16_t port_num;
     uint8_t value;
 
+    if (apic_enable)
+    {
+        apic_enable_irq(irq_num);
+        return;
+    }
+
     // Check if the IRQ # is on primary or slave
     if (irq_num < PIC_SIZE)
     {
@@ -85,7 +93,8 @@ void enable_irq(uint32_t irq_num)
  *   INPUTS: irq_num - IRQ # to disable
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: PIC will mask the requested IRQ #.
+ *   SIDE EFFECTS: PIC will mask the requested IRQ #, or
+ *                 the APIC if it is in use.
  *   REFERENCE: https://wiki.osdev.org/8259_PIC
  */
 void disable_irq(uint32_t irq_num)
@@ -93,6 +102,12 @@ void disable_irq(uint32_t irq_num)
     uint16_t port_num;
     uint8_t value;
 
+    if (apic_enable)
+    {
+        apic_disable_irq(irq_num);
+        return;
+    }
+
     // Check if the IRQ # is on primary or slave
     if (irq_num < PIC_SIZE){
         port_num = Master_data;
@@ -116,11 +131,19 @@ void disable_irq(uint32_t irq_num)
  *   INPUTS: irq_num - IRQ # to send EOI
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Send EOI signal to PIC for the requested IRQ #.
+ *   SIDE EFFECTS: Send EOI signal to PIC for the requested IRQ #,
+ *                 or to the LAPIC if it is in use.
  *   REFERENCE: https://wiki.osdev.org/8259_PIC
  */
 void send_eoi(uint32_t irq_num)
 {
+    if (apic_enable)
+    {
+        apic_send_eoi();
+        irq_eoi_account();
+        return;
+    }
+
     // Master PIC has interrupt number 0-7
     if (irq_num < PIC_SIZE)
     {
@@ -135,4 +158,5 @@ void send_eoi(uint32_t irq_num)
         outb(EOI | SLAVE_IRQ, Master_command);
         outb(EOI | irq_num, Slave_command);
     }
+    irq_eoi_account();
 }
@@ -89,6 +89,8 @@ void enable_irq(uint32_t irq_num);
 void disable_irq(uint32_t irq_num);
 /* Send end-of-interrupt signal for the specified IRQ */
 void send_eoi(uint32_t irq_num);
+/* Account the time from interrupt entry to EOI, in interrupts.c */
+void irq_eoi_account(void);
 
 
 
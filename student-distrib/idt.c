@@ -11,6 +11,7 @@
 static void exception_entry_init(const int index);
 static void interrupt_entry_init(const int index);
 static void syscall_entry_init(const int index);
+static void sysenter_entry_init();
 
 /* 
  * unified_interrupt_handler
@@ -23,6 +24,8 @@ static void syscall_entry_init(const int index);
  */
 void idt_init()
 {
+    int irq;
+
     // Load Exception Handlers
     exception_entry_init(DIV_BY_ZERO_CODE);
     exception_entry_init(RESERVED_CODE);
@@ -63,16 +66,20 @@ void idt_init()
     SET_IDT_ENTRY(idt[MACHINE_CHECK_CODE], &handle_exception_machine_check);
     SET_IDT_ENTRY(idt[SIMD_FLOATING_POINT_CODE], &handle_exception_SIMD_floating_point);
 
-    // Load Interrupt Handlers
-    interrupt_entry_init(PIT_IRQ + IRQ_OFFSET);
-    interrupt_entry_init(KEYBOARD_IRQ + IRQ_OFFSET);
-    interrupt_entry_init(RTC_IRQ + IRQ_OFFSET);
+    // Load Interrupt Handlers, drivers take their IRQ by request_irq()
+    for (irq = 0; irq < IRQ_COUNT; irq++)
+    {
+        interrupt_entry_init(irq + IRQ_OFFSET);
+        SET_IDT_ENTRY(idt[irq + IRQ_OFFSET], handle_irq_table[irq]);
+    }
+    interrupt_entry_init(APIC_SPURIOUS_VECTOR);
+    SET_IDT_ENTRY(idt[APIC_SPURIOUS_VECTOR], &handle_apic_spurious);
     syscall_entry_init(SYSCALL_INDEX);
-    SET_IDT_ENTRY(idt[PIT_IRQ + IRQ_OFFSET], &handle_interrupt_PIT);
-    SET_IDT_ENTRY(idt[KEYBOARD_IRQ + IRQ_OFFSET], &handle_interrupt_keyboard);
-    SET_IDT_ENTRY(idt[RTC_IRQ + IRQ_OFFSET], &handle_interrupt_RTC);
     SET_IDT_ENTRY(idt[SYSCALL_INDEX], &handle_syscall);
 
+    // Load SYSENTER entry, INT 0x80 is kept as the fallback
+    sysenter_entry_init();
+
     // Load Syscall Vector
     // NONE in CP1
 }
@@ -135,3 +142,29 @@ static void syscall_entry_init(const int index)
     idt[index].seg_selector = KERNEL_CS;
 }
 
+/* 
+ * sysenter_entry_init
+ *   DESCRIPTION: Initialize SYSENTER/SYSEXIT fast system call entry
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: SYSENTER MSRs will point to handle_sysenter if the
+ *                 processor supports it. The ESP MSR is a placeholder,
+ *                 the linkage switches to tss.esp0 itself.
+ */
+static void sysenter_entry_init()
+{
+    uint32_t eax, ebx, ecx, edx;
+
+    sysenter_enable = 0;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & (1 << CPUID_SEP_BIT)))
+    {
+        return;
+    }
+
+    wrmsr(MSR_SYSENTER_CS, KERNEL_CS, 0);
+    wrmsr(MSR_SYSENTER_ESP, KERNEL_STACK_ADDR - 4, 0);
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t) &handle_sysenter, 0);
+    sysenter_enable = 1;
+}
@@ -16,6 +16,9 @@
 
 #ifndef ASM
 
+// Set if SYSENTER fast system calls are configured
+uint8_t sysenter_enable;
+
 // Initialize the IDT
 extern void idt_init();
 
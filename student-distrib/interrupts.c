@@ -7,6 +7,26 @@
 
 #include "interrupts.h"
 
+// Handler and statistics of an IRQ line
+typedef struct irq_desc_t
+{
+    irq_handler_t handler;              // NULL if the line is free
+    void* ctx;                          // Argument of handler
+    uint32_t count;                     // Interrupts taken
+    uint32_t samples;                   // Handler runs summed in cycles
+    uint32_t cycles;                    // TSC cycles spent in handler
+} irq_desc_t;
+
+// File-scope data structures
+static irq_desc_t irq_desc[IRQ_COUNT];
+
+// TSC at the entry of the current interrupt, 0 once EOI is sent
+static uint32_t irq_entry = 0;
+
+// Cycles from entry to EOI, summed over eoi_samples interrupts
+static uint32_t eoi_cycles = 0;
+static uint32_t eoi_samples = 0;
+
 /* 
  * unified_interrupt_handler
  *   DESCRIPTION: An unified handler entry point to dispatch to
@@ -14,24 +34,164 @@
  *   INPUTS: irq - IRQ # given by linkage.
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: interrupt will be dispatched to appropriate
- *                 handler accordingly.
+ *   SIDE EFFECTS: interrupt will be dispatched to the handler
+ *                 given to request_irq(). Handlers only do the
+ *                 urgent part and queue tasklets, which run
+ *                 afterwards with interrupts enabled. A switch
+ *                 asked for by either happens on the way out.
  */
 void unified_interrupt_handler(const int irq)
 {
-    switch (irq)
-    {
-        case PIT_IRQ:
-            pit_handle();
-            break;
-        case KEYBOARD_IRQ:
-            keyboard_handle();
-            break;
-        case RTC_IRQ:
-            rtc_handle();
-            break;
-        default:
-            break;
+    irq_desc_t* desc = &irq_desc[irq];
+    uint32_t cycles;
+
+    irqoff_trace_start();
+    irq_entry = rdtsc_low();
+    desc->count++;
+    if (desc->handler == NULL)
+    {
+        // Only spurious IRQ 7 and 15 get here, the others are masked.
+        // A spurious slave IRQ still took the cascade on the master.
+        if (irq >= PIC_SIZE)
+        {
+            send_eoi(SLAVE_IRQ);
+        }
+        irqoff_trace_stop(irq);
+        return;
+    }
+    desc->handler(desc->ctx);
+    cycles = irqoff_trace_stop(irq);
+
+    // Halve both sums before they overflow, the average stays the same
+    if (desc->cycles + cycles < desc->cycles)
+    {
+        desc->cycles >>= 1;
+        desc->samples >>= 1;
     }
+    desc->cycles += cycles;
+    desc->samples++;
+
+    do_softirq();
+
+    // Interrupt exit is a safe point for a switch asked for
+    preempt_schedule();
     return;
 }
+
+/* 
+ * request_irq
+ *   DESCRIPTION: Install the handler of an IRQ line and enable it
+ *                on the PIC. Each line has one handler.
+ *   INPUTS: irq - IRQ #
+ *           handler - called with interrupts off on every interrupt
+ *           ctx - given to handler
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 - success, -1 - failed
+ *   SIDE EFFECTS: statistics of the line are reset
+ */
+int32_t request_irq(uint32_t irq, irq_handler_t handler, void* ctx)
+{
+    if ((irq >= IRQ_COUNT) || (irq == SLAVE_IRQ) || (handler == NULL))
+    {
+        printf("request_irq: IRQ %u is not valid.\n", irq);
+        return -1;
+    }
+    if (irq_desc[irq].handler != NULL)
+    {
+        printf("request_irq: IRQ %u is already taken.\n", irq);
+        return -1;
+    }
+
+    irq_desc[irq].ctx = ctx;
+    irq_desc[irq].count = 0;
+    irq_desc[irq].samples = 0;
+    irq_desc[irq].cycles = 0;
+    irq_desc[irq].handler = handler;
+    enable_irq(irq);
+    return 0;
+}
+
+/* 
+ * free_irq
+ *   DESCRIPTION: Remove the handler of an IRQ line and disable it
+ *                on the PIC.
+ *   INPUTS: irq - IRQ #
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void free_irq(uint32_t irq)
+{
+    if ((irq >= IRQ_COUNT) || (irq == SLAVE_IRQ))
+    {
+        return;
+    }
+    disable_irq(irq);
+    irq_desc[irq].handler = NULL;
+}
+
+/* 
+ * irq_stats
+ *   DESCRIPTION: Interrupts taken on an IRQ line, and the average
+ *                TSC cycles from entry until the handler returns.
+ *   INPUTS: irq - IRQ #
+ *   OUTPUTS: count - interrupts taken, cycles - average cycles
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void irq_stats(uint32_t irq, uint32_t* count, uint32_t* cycles)
+{
+    *count = 0;
+    *cycles = 0;
+    if (irq >= IRQ_COUNT)
+    {
+        return;
+    }
+    *count = irq_desc[irq].count;
+    if (irq_desc[irq].samples != 0)
+    {
+        *cycles = irq_desc[irq].cycles / irq_desc[irq].samples;
+    }
+}
+
+/* 
+ * irq_eoi_account
+ *   DESCRIPTION: Called by send_eoi(), account the cycles from
+ *                entry of the current interrupt until its EOI.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: only the first EOI of an interrupt counts
+ */
+void irq_eoi_account(void)
+{
+    uint32_t cycles;
+
+    if (irq_entry == 0)
+    {
+        return;
+    }
+    cycles = rdtsc_low() - irq_entry;
+    irq_entry = 0;
+
+    if (eoi_cycles + cycles < eoi_cycles)
+    {
+        eoi_cycles >>= 1;
+        eoi_samples >>= 1;
+    }
+    eoi_cycles += cycles;
+    eoi_samples++;
+}
+
+/* 
+ * irq_eoi_stats
+ *   DESCRIPTION: Average cycles from interrupt entry to EOI
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: average cycles, 0 if none yet
+ *   SIDE EFFECTS: none
+ */
+uint32_t irq_eoi_stats(void)
+{
+    return (eoi_samples != 0) ? (eoi_cycles / eoi_samples) : 0;
+}
@@ -9,6 +9,7 @@
 #define _INTERRUPTS_H
 
 #include "i8259.h"
+#include "apic.h"
 #include "rtc.h"
 #include "keyboard.h"
 #include "pit.h"
@@ -17,8 +18,23 @@
 
 #include "lib.h"
 
+// Handler of an IRQ line, ctx is given to request_irq()
+typedef void (*irq_handler_t)(void* ctx);
+
 // An unified handler entry point to dispatch the interrupt
 extern void unified_interrupt_handler(const int irq);
 
+// Install the handler of an IRQ line and enable it
+extern int32_t request_irq(uint32_t irq, irq_handler_t handler, void* ctx);
+
+// Remove the handler of an IRQ line and disable it
+extern void free_irq(uint32_t irq);
+
+// Interrupts taken on an IRQ line and average handler cycles
+extern void irq_stats(uint32_t irq, uint32_t* count, uint32_t* cycles);
+
+// Average cycles from interrupt entry to EOI
+extern uint32_t irq_eoi_stats(void);
+
 #endif /* ASM */
 #endif /* _INTERRUPTS_H */
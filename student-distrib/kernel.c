@@ -14,6 +14,9 @@
 #include "syscalls.h"
 #include "scheduler.h"
 #include "color.h"
+#include "idt.h"
+#include "palloc.h"
+#include "serial.h"
 
 // #define RUN_TESTS
 
@@ -21,15 +24,25 @@
 /* Check if the bit BIT in FLAGS is set. */
 #define CHECK_FLAG(flags, bit)   ((flags) & (1 << (bit)))
 
+/* The kernel is loaded at 4MB and ends at _end, from the linker. */
+#define KERNEL_IMAGE_ADDR 0x400000
+extern uint8_t _end[];
+
 /* Check if MAGIC is valid and print the Multiboot information structure
    pointed by ADDR. */
 void entry(unsigned long magic, unsigned long addr) {
 
     multiboot_info_t *mbi;
 
+    /* TSC at entry, for the boot time reported below. */
+    uint32_t boot_start = rdtsc_low();
+
     /* Clear the screen. */
     clear();
 
+    /* COM1 first, it mirrors the boot messages */
+    serial_init();
+
     /* Am I booted by a Multiboot-compliant boot loader? */
     if (magic != MULTIBOOT_BOOTLOADER_MAGIC) {
         printf("Invalid magic number: 0x%#x\n", (unsigned)magic);
@@ -149,10 +162,24 @@ void entry(unsigned long magic, unsigned long addr) {
     /* Boot message */
     printf("Starting up 391OS-36...\n");
 
+    /* Report system call entry */
+    if (sysenter_enable)
+    {
+        printf("Fast System Call (SYSENTER) Enabled...\n");
+    }
+    else
+    {
+        printf("Fast System Call Unavailable, Using INT 0x80...\n");
+    }
+
     /* Init and Enable Paging */
     printf("Initializing and Enabling Paging...\n");
     paging_init();
 
+    /* Pages for terminals are taken on demand */
+    printf("Initializing Page Allocator...\n");
+    page_init();
+
     /* Initialize Environment for Multiterminal */
     printf("Initializing Scheduler...\n");
     switchEnvironmentInit();
@@ -161,6 +188,10 @@ void entry(unsigned long magic, unsigned long addr) {
     printf("Initializing PIC...\n");
     i8259_init();
 
+    /* Prefer the APIC, the 8259 stays if there is none */
+    printf("Initializing APIC...\n");
+    apic_init();
+
     /* Initialize devices, memory, filesystem, enable device interrupts on the
      * PIC, any other initialization stuff... */
     // Initialize Devices and Enable IRQs
@@ -168,12 +199,12 @@ void entry(unsigned long magic, unsigned long addr) {
     rtc_open(NULL);
     terminal_open(NULL);
     keyboard_init(0);
-    keyboard_init(1);
-    keyboard_init(2);
     enable_cursor(CURSOR_START, CURSOR_END);
-    enable_irq(PIT_IRQ);
-    enable_irq(KEYBOARD_IRQ);
-    enable_irq(RTC_IRQ);
+    irqoff_hook = irqoff_record;
+    request_irq(PIT_IRQ, pit_handle, NULL);
+    request_irq(KEYBOARD_IRQ, keyboard_handle, NULL);
+    request_irq(RTC_IRQ, rtc_handle, NULL);
+    serial_start();
 
     /* Enable interrupts */
     /* Do not enable the following until after you have set up your
@@ -191,6 +222,11 @@ void entry(unsigned long magic, unsigned long addr) {
     printf("Starting Testcases...\n");
     launch_tests();
 #endif
+    /* Boot time and memory, other terminals take more once shown */
+    printf("Booted in %u cycles, kernel %u KB, %u KB allocated for %u of %u terminals\n",
+           rdtsc_low() - boot_start, ((uint32_t) _end - KERNEL_IMAGE_ADDR) / 1024,
+           page_used() * (PAGE_SIZE / 1024), 1, TERMINAL_COUNT);
+
     /* Startup complete */
     set_color(INV_LIGHT_CYAN);
     printf("\nWelcome to 391OS-36. Press CTRL+H for Help.\n\n");
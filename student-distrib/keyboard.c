@@ -6,6 +6,10 @@
  */
 
 #include "keyboard.h"
+#include "interrupts.h"
+#include "scrollback.h"
+#include "palloc.h"
+#include "serial.h"
 
 // Initialize Globale Variable
 uint8_t terminal_active = 0;
@@ -32,18 +36,38 @@ static unsigned char upper_scancode_map[58] =
   'Z', 'X', 'C', 'V', 'B', 'N', 'M', '<', '>', '?',    0,   0,   0, ' '       /* Third Row, R SHIFT, PrtSc, ALT, SPACE */
 };
 
-// Keyboard buffer variables
-static unsigned char buf_local[3][KEYBOARD_BUFFER_SIZE];
-static unsigned int buf_size[3];
+// Scan codes of F1 to F12, ALT with the nth key shows terminal n
+#define FKEY_COUNT 12
+static unsigned char fkey_scancode[FKEY_COUNT] =
+{
+    0x3B, 0x3C, 0x3D, 0x3E, 0x3F, 0x40, 0x41, 0x42, 0x43, 0x44, 0x57, 0x58
+};
 
 // Caps lock, shift, and enter
 static uint8_t caps_lock = 0;
 static uint8_t shift = 0;
 static uint8_t ctrl = 0;
 static uint8_t alt = 0;
+static uint8_t extended = 0;
 
 // Keyboard wait
-static unsigned int keyboard_wait_flag = 0;
+static volatile unsigned int keyboard_wait_flag = 0;
+
+// Scancodes taken by the top half, head and tail run freely
+static unsigned char scan_ring[SCAN_RING_SIZE];
+static volatile uint32_t scan_head = 0;
+static volatile uint32_t scan_tail = 0;
+static uint32_t scan_lost = 0;
+
+// Bottom half of the keyboard interrupt
+static void keyboard_tasklet_handle(uint32_t data);
+static tasklet_t keyboard_tasklet = { NULL, keyboard_tasklet_handle, 0, 0 };
+
+// Handle a scancode, echo and combinational keys
+static void keyboard_process(unsigned char scan_code);
+
+// Track ctrl, shift and alt
+static void keyboard_modifier(unsigned char scan_code);
 
 // Help message print handler
 static void print_help_msg_handler();
@@ -51,33 +75,34 @@ static void print_help_msg_handler();
 // Process manager handler
 static void pman_handler();
 
+// Apply shift and caps lock to a main key
+static unsigned char keyboard_case(unsigned char scan_code);
+
 /* 
  * keyboard_init
- *   DESCRIPTION: Initialize the keyboard buffer
+ *   DESCRIPTION: Initialize the line being typed
  *   INPUTS: curr_terminal - current terminal ID
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Keyboard buffer will be filled with
- *                 zeros, and buf_size will be reset.
+ *   SIDE EFFECTS: The line being typed on the terminal is
+ *                 dropped, finished lines stay in its input ring.
  */
 void keyboard_init(int curr_terminal)
 {
-    memset(&(buf_local[curr_terminal][0]), '\0', KEYBOARD_BUFFER_SIZE);
-    buf_size[curr_terminal] = 0;
+    terminal_drop_line(curr_terminal);
 }
 
 /* 
  * keyboard_handle
  *   DESCRIPTION: Handler to handle keyboard interrupts
- *   INPUTS: none
+ *   INPUTS: ctx - ignored
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: keyboard interrupt will be received and EOI
- *                 will be send. Will set the trigger flag or
- *                 clear the screen if triggered. Will echo the
- *                 supported key.
+ *                 will be send. The scancode is queued for the
+ *                 tasklet, except while keyboard_wait() spins.
  */
-void keyboard_handle()
+void keyboard_handle(void* ctx)
 {
     // Receive the keystrike
     unsigned char scan_code = inb(0x60);
@@ -85,19 +110,69 @@ void keyboard_handle()
     // Send EOI
     send_eoi(KEYBOARD_IRQ);
 
-    // Restore wait flag
-    if (keyboard_wait_flag && scan_code == 0x1C)
+    // keyboard_wait() spins until ENTER, so answer it from here
+    if (keyboard_wait_flag)
     {
-        keyboard_wait_flag = 0;
+        keyboard_modifier(scan_code);
+        if (scan_code == 0x1C)
+        {
+            keyboard_wait_flag = 0;
+        }
         return;
     }
 
+    if ((scan_tail - scan_head) == SCAN_RING_SIZE)
+    {
+        scan_lost++;
+        return;
+    }
+    scan_ring[scan_tail & SCAN_RING_MASK] = scan_code;
+    scan_tail++;
+    tasklet_schedule(&keyboard_tasklet);
+}
+
+/* 
+ * keyboard_tasklet_handle
+ *   DESCRIPTION: Bottom half of the keyboard interrupt, runs with
+ *                interrupts enabled.
+ *   INPUTS: data - ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Handle every queued scancode in order.
+ */
+static void keyboard_tasklet_handle(uint32_t data)
+{
+    unsigned char scan_code;
+
+    while (scan_head != scan_tail)
+    {
+        scan_code = scan_ring[scan_head & SCAN_RING_MASK];
+        scan_head++;
+        keyboard_process(scan_code);
+    }
+}
+
+/* 
+ * keyboard_modifier
+ *   DESCRIPTION: Track ctrl, shift and alt
+ *   INPUTS: scan_code - scancode received
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: modifier flags are updated
+ */
+static void keyboard_modifier(unsigned char scan_code)
+{
+    // Gray keys are sent after 0xE0, with shift faked up and down around
+    // them while shift is held. Only the shift keys themselves count.
+    uint8_t prefixed = extended;
+    extended = (scan_code == EXTENDED);
+
     // Set the shift flag upon press & release of both shift
-    if (scan_code == LSHIFT_PRESS || scan_code == RSHIFT_PRESS)
+    if ((!prefixed) && (scan_code == LSHIFT_PRESS || scan_code == RSHIFT_PRESS))
     {
         shift = 1;
     }
-    if (scan_code == LSHIFT_REL || scan_code == RSHIFT_REL)
+    if ((!prefixed) && (scan_code == LSHIFT_REL || scan_code == RSHIFT_REL))
     {
         shift = 0;
     }
@@ -123,6 +198,22 @@ void keyboard_handle()
     {
         alt = 0;
     }
+}
+
+/* 
+ * keyboard_process
+ *   DESCRIPTION: Handle a scancode, called by the tasklet
+ *   INPUTS: scan_code - scancode received
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Will set the trigger flag or clear the screen
+ *                 if triggered. Will echo the supported key.
+ */
+static void keyboard_process(unsigned char scan_code)
+{
+    unsigned int fkey;
+
+    keyboard_modifier(scan_code);
 
     // Caps lock (scancode 0x3A)
     if (scan_code == CAPS_LOCK && caps_lock == 0)
@@ -134,79 +225,37 @@ void keyboard_handle()
         caps_lock = 0;
     }
 
-    // Check supported main keystrokes (index < 58 and not NULL character)
-    if ((scan_code < 58) && (ctrl != 1) && (alt != 1) && (terminals[terminal_active].echo) && (!keyboard_wait_flag))
+    // Shift+PgUp and Shift+PgDn page through the history of the active terminal
+    if (shift && (scan_code == PAGE_UP || scan_code == PAGE_DOWN) && (!keyboard_wait_flag))
     {
-        unsigned char character = lower_scancode_map[scan_code];
-
-        // Handle new line
-        if (character == '\n')
-        {
-            // Call terminal driver to handle the buffer
-            copy_buffer(&(buf_local[terminal_active][0]), buf_size[terminal_active], terminal_active);
-
-            // Reset the buffer and print character
-            keyboard_init(terminal_active);
-            char character_string[2] = {character, '\0'};
-            keyboard_put_active(character_string);
-        }
+        scrollback_scroll(terminal_active, (scan_code == PAGE_UP) ? SCROLLBACK_STEP : -SCROLLBACK_STEP);
+        return;
+    }
 
-        // Handle backspace
-        else if (character == '\b')
-        {
-            // Backspace is valid only if buf_size > 0
-            if (buf_size[terminal_active] > 0)
-            {
-                // Update the buffer and print character
-                buf_size[terminal_active]--;
-                if (buf_local[terminal_active][buf_size[terminal_active]] == '\t')
-                {
-                    // Check if the previous char is a tab
-                    char character_string[2] = {character, '\0'};
-                    keyboard_put_active(character_string);
-                    keyboard_put_active(character_string);
-                    keyboard_put_active(character_string);
-                }
-                buf_local[terminal_active][buf_size[terminal_active]] = '\0';
-                char character_string[2] = {character, '\0'};
-                keyboard_put_active(character_string);
-            }
-        }
+    // Any other key shows the live screen again
+    if ((scan_code < 58) && (scan_code != LSHIFT_PRESS) && (scan_code != RSHIFT_PRESS))
+    {
+        scrollback_exit();
+    }
 
-        // Handle all other printable keystrokes if there are still space in buf
-        else if ((character != 0) && (buf_size[terminal_active] < KEYBOARD_BUFFER_SIZE))
+    // Check supported main keystrokes (index < 58 and not NULL character)
+    // Keys are always taken, typed ahead keys wait in the input ring
+    if ((scan_code < 58) && (ctrl != 1) && (alt != 1) && (!keyboard_wait_flag))
+    {
+        if (lower_scancode_map[scan_code] != 0)
         {
-            // Determine if the input is an alphabet
-            unsigned char is_alpha = (scan_code >= 0x10 && scan_code <= 0x19) || (scan_code >= 0x1E && scan_code <= 0x26) || (scan_code >= 0x2C && scan_code <= 0x32);
-
-            // Determine the correct case character
-            if (is_alpha && ((caps_lock == 1 && shift == 0) || (caps_lock == 0 && shift == 1)))
-            {
-                // If it is alpha, print uppercase if CAPS && !SHIFT, or !CAPS && SHIFT
-                character = upper_scancode_map[scan_code];
-            }
-            else if (!is_alpha && shift == 1)
-            {
-                // If it is not an alpha, print uppercase if SHIFT
-                character = upper_scancode_map[scan_code];
-            }
-
-            // Update the buffer and print character
-            buf_local[terminal_active][buf_size[terminal_active]] = character;
-            buf_size[terminal_active]++;
-            char character_string[2] = {character, '\0'};
-            keyboard_put_active(character_string);
+            keyboard_type(keyboard_case(scan_code));
         }
 
         // Take the shortcut to handle the new key if not currently in the specified terminal
         if (pcb->terminal_id != terminal_active)
         {
-            switchContext(terminal_active);
+            resched_terminal(terminal_active);
         }
     }
 
     // Combinational key support
-    if ((!keyboard_wait_flag) && (!progress))
+    if (!keyboard_wait_flag)
     {
         /*
          *  ------  Warning!  ------
@@ -217,17 +266,9 @@ void keyboard_handle()
         // Press CTRL+L to clear screen
         if ((scan_code == 0x26) && ctrl)
         {
-            // Rise progress flag
-            progress = 1;
-
             // Clear the active terminal VRAM and clear buffer
-            // Save current video mem pointer
-            char* vram_ptr_backup = video_mem;
-            video_mem = (char *) VIDEO_MEM_ADDR;
-
-            // Save coordinates
-            int x_backup = screen_x;
-            int y_backup = screen_y;
+            screen_save_t save;
+            terminal_borrow(&save, NULL);
 
             // Clear VRAM
             clear();
@@ -235,24 +276,8 @@ void keyboard_handle()
             // Clear buffer
             keyboard_init(terminal_active);
 
-            // Restore coordinates accordingly
-            if (pcb->terminal_id != terminal_active)
-            {
-                terminals[terminal_active].screen_x = screen_x;
-                terminals[terminal_active].screen_y = screen_y;
-                screen_x = x_backup;
-                screen_y = y_backup;
-            }
-
             // Restore video mem pointer and reset cursor
-            video_mem = vram_ptr_backup;
-            if (video_mem == ((char *) VIDEO_MEM_ADDR))
-            {
-                set_cursor_loc(screen_x, screen_y);
-            }
-
-            // Clear progress flag
-            progress = 0;
+            terminal_return(&save);
         }
 
         // Press CTRL+C to send interrupt signal
@@ -260,46 +285,12 @@ void keyboard_handle()
         {
             char prompt[] = "\n<!> Interrupt.\n";
             keyboard_put_active(prompt);
-            
-            // Rise progress flag
-            progress = 1;
-
-            // Save current video mem pointer
-            char* vram_ptr_backup = video_mem;
-            video_mem = (char *) VIDEO_MEM_ADDR;
-
-            // Save coordinates
-            int x_backup = screen_x;
-            int y_backup = screen_y;
-
-            // Set coordinates accordingly
-            if (pcb->terminal_id != terminal_active)
-            {
-                screen_x = terminals[terminal_active].screen_x;
-                screen_y = terminals[terminal_active].screen_y;
-            }
 
-            // Deliver signal
+            // Deliver signal, on the active terminal
+            screen_save_t save;
+            terminal_borrow(&save, NULL);
             sig_set(terminals[terminal_active].pcb, INTERRUPT);
-
-            // Restore coordinates accordingly
-            if (pcb->terminal_id != terminal_active)
-            {
-                terminals[terminal_active].screen_x = screen_x;
-                terminals[terminal_active].screen_y = screen_y;
-                screen_x = x_backup;
-                screen_y = y_backup;
-            }
-
-            // Restore video mem pointer and reset cursor
-            video_mem = vram_ptr_backup;
-            if (video_mem == ((char *) VIDEO_MEM_ADDR))
-            {
-                set_cursor_loc(screen_x, screen_y);
-            }
-
-            // Clear progress flag
-            progress = 0;
+            terminal_return(&save);
         }
 
         // Press CTRL+S to enable scheduler
@@ -337,7 +328,7 @@ void keyboard_handle()
         }
 
         // Press CTRL+P to use process manager
-        // Called blocking function, send EOI and return inside
+        // Called blocking function, return inside
         if ((scan_code == 0x19) && ctrl)
         {
             // Process manager
@@ -356,7 +347,7 @@ void keyboard_handle()
         }
 
         // Press CTRL+H to display help message
-        // Called blocking function, send EOI and return inside
+        // Called blocking function, return inside
         if ((scan_code == 0x23) && ctrl)
         {
             // Display message
@@ -368,36 +359,24 @@ void keyboard_handle()
         }
 
         // Press ALT combinations to switch terminal
-        // Called blocking function, send EOI and return inside
-        if ((scan_code == 0x3B) && alt)
-        {
-            // Switch to Terminal 1
-            switchVidMem(0);
-
-            // Always switch immediately to handle the video
-            switchContext(0);
-
-            return;
-        }
-        else if ((scan_code == 0x3C) && alt)
+        // The switch happens on the interrupt exit
+        if (alt)
         {
-            // Switch to Terminal 2
-            switchVidMem(1);
-
-            // Always switch immediately to handle the video
-            switchContext(1);
-
-            return;
-        }
-        else if ((scan_code == 0x3D) && alt)
-        {
-            // Switch to Terminal 3
-            switchVidMem(2);
-
-            // Always switch immediately to handle the video
-            switchContext(2);
+            for (fkey = 0; (fkey < FKEY_COUNT) && (fkey < TERMINAL_COUNT); fkey++)
+            {
+                if (scan_code != fkey_scancode[fkey])
+                {
+                    continue;
+                }
 
-            return;
+                // The terminal is created on its first switch, which may fail
+                if (switchVidMem(fkey) == 0)
+                {
+                    // Always switch immediately to handle the video
+                    resched_terminal(fkey);
+                }
+                return;
+            }
         }
     }
 
@@ -422,6 +401,100 @@ void keyboard_handle()
     return;
 }
 
+/* 
+ * keyboard_type
+ *   DESCRIPTION: Take a character typed on the active terminal,
+ *                from the keyboard or the serial console.
+ *   INPUTS: character - character in its case, 0 is ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Line editing and echo by the mode of the terminal.
+ */
+void keyboard_type(unsigned char character)
+{
+    uint8_t mode = terminals[terminal_active].mode;
+
+    // Hand every key to the reader as typed, no line editing
+    if (mode != TERM_COOKED)
+    {
+        if (character != 0)
+        {
+            if ((terminal_put_key(character, terminal_active) == 0) && (mode == TERM_CBREAK))
+            {
+                char character_string[2] = {character, '\0'};
+                keyboard_put_active(character_string);
+            }
+        }
+    }
+
+    // Handle new line, the line becomes readable
+    else if (character == '\n')
+    {
+        if (terminal_put_key(character, terminal_active) == 0)
+        {
+            char character_string[2] = {character, '\0'};
+            keyboard_put_active(character_string);
+        }
+    }
+
+    // Handle backspace
+    else if (character == '\b')
+    {
+        // Backspace is valid only if the line is not empty
+        unsigned char erased = terminal_erase_key(terminal_active);
+        if (erased != 0)
+        {
+            if (erased == '\t')
+            {
+                // Check if the previous char is a tab
+                char character_string[2] = {character, '\0'};
+                keyboard_put_active(character_string);
+                keyboard_put_active(character_string);
+                keyboard_put_active(character_string);
+            }
+            char character_string[2] = {character, '\0'};
+            keyboard_put_active(character_string);
+        }
+    }
+
+    // Handle all other printable keystrokes if there are still space in the line
+    else if (character != 0)
+    {
+        // Update the buffer and print character
+        if (terminal_put_key(character, terminal_active) == 0)
+        {
+            char character_string[2] = {character, '\0'};
+            keyboard_put_active(character_string);
+        }
+    }
+}
+
+/* 
+ * keyboard_case
+ *   DESCRIPTION: Apply shift and caps lock to a main key.
+ *   INPUTS: scan_code - main key scancode, less than 58
+ *   OUTPUTS: none
+ *   RETURN VALUE: character of the key in the current case
+ *   SIDE EFFECTS: none
+ */
+static unsigned char keyboard_case(unsigned char scan_code)
+{
+    // Determine if the input is an alphabet
+    unsigned char is_alpha = (scan_code >= 0x10 && scan_code <= 0x19) || (scan_code >= 0x1E && scan_code <= 0x26) || (scan_code >= 0x2C && scan_code <= 0x32);
+
+    if (is_alpha && ((caps_lock == 1 && shift == 0) || (caps_lock == 0 && shift == 1)))
+    {
+        // If it is alpha, print uppercase if CAPS && !SHIFT, or !CAPS && SHIFT
+        return upper_scancode_map[scan_code];
+    }
+    else if (!is_alpha && shift == 1)
+    {
+        // If it is not an alpha, print uppercase if SHIFT
+        return upper_scancode_map[scan_code];
+    }
+    return lower_scancode_map[scan_code];
+}
+
 /* 
  * keyboard_wait
  *   DESCRIPTION: Keyboard wait to wait for user confirmation
@@ -456,53 +529,16 @@ void keyboard_put_active(char* prompt)
      *  This kernel debug tool will override whatever current PCB,
      *  and put stuff on the active terminal. --PL
      */
-    // Rise progress flag
-    progress = 1;
-
-    // Check if can print directly
-    if (terminal_active == (pcb->terminal_id))
-    {
-        printf(prompt);
-        progress = 0;
-        return;
-    }
+    screen_save_t save;
 
-    // Save current video mem pointer
-    char* vram_ptr_backup = video_mem;
-    video_mem = (char *) VIDEO_MEM_ADDR;
+    // Point kernel output at the active terminal, printf locks on its own
+    terminal_borrow(&save, NULL);
 
-    // Save VRAM information
-    int x_backup = screen_x;
-    int y_backup = screen_y;
-    
-    // Set coordinates accordingly
-    if (pcb->terminal_id != terminal_active)
-    {
-        screen_x = terminals[terminal_active].screen_x;
-        screen_y = terminals[terminal_active].screen_y;
-    }
-    
     // Print the prompt
     printf(prompt);
 
-    // Restore coordinates accordingly
-    if (pcb->terminal_id != terminal_active)
-    {
-        terminals[terminal_active].screen_x = screen_x;
-        terminals[terminal_active].screen_y = screen_y;
-        screen_x = x_backup;
-        screen_y = y_backup;
-    }
-
     // Restore video mem pointer and reset cursor
-    video_mem = vram_ptr_backup;
-    if (video_mem == ((char *) VIDEO_MEM_ADDR))
-    {
-        set_cursor_loc(screen_x, screen_y);
-    }
-
-    // Clear Progress Flag
-    progress = 0;
+    terminal_return(&save);
 }
 
 /* 
@@ -524,17 +560,10 @@ void keyboard_clear_and_wait(void (*handler)(), char* prompt, unsigned int lines
      *  This kernel debug tool will override whatever current PCB,
      *  and put stuff on the active terminal. --PL
      */
-    progress = 1;
-    // Save current video mem pointer
-    char* vram_ptr_backup = video_mem;
-    video_mem = (char *) VIDEO_MEM_ADDR;
+    screen_save_t save;
 
-    // Save VRAM information
-    memcpy((void *) VIDEO_BACKUP_ADDR_EXTRA, (void *) VIDEO_MEM_ADDR, VIDEO_MEM_BYTES);
-    int x_backup = screen_x;
-    int y_backup = screen_y;
-
-    // Clear VRAM
+    // Show and clear the extra page, the terminal pages stay untouched
+    terminal_borrow(&save, (char *) VIDEO_BACKUP_ADDR_EXTRA);
     clear();
 
     // Execute handler
@@ -549,19 +578,8 @@ void keyboard_clear_and_wait(void (*handler)(), char* prompt, unsigned int lines
     // Print the prompt and wait
     keyboard_wait(prompt);
 
-    // Restore VRAM
-    memcpy((void *) VIDEO_MEM_ADDR, (void *) VIDEO_BACKUP_ADDR_EXTRA, VIDEO_MEM_BYTES);
-    screen_x = x_backup;
-    screen_y = y_backup;
-
-    // Restore video mem pointer and reset cursor
-    video_mem = vram_ptr_backup;
-    if (video_mem == ((char *) VIDEO_MEM_ADDR))
-    {
-        set_cursor_loc(screen_x, screen_y);
-    }
-
-    progress = 0;
+    // Show the terminal again and reset cursor
+    terminal_return(&save);
 }
 
 /* 
@@ -578,81 +596,61 @@ void pman_handler()
     printf("                            391OS-36 Process Manager                            \n");
     unset_color();
 
-    printf("Terminal Info:\n");
-    if (terminals[0].initialized)
-    {
-        printf("TI0 0x%#x, PID %u, ECHO %u, VMAP %u, COOR (%u, %u), %s\n", &terminals[0], terminals[0].pcb->process_id, terminals[0].echo, terminals[0].vidmap, terminals[0].screen_x, terminals[0].screen_y, terminals[0].pcb->command);
-    }
-    else
-    {
-        printf("TI0 0x%#x Uninitialized\n", &terminals[0]);
-    }
-    if (terminals[1].initialized)
+    // Only terminals switched to so far have a shell
+    uint32_t tid, created = 0;
+    printf("Terminal Info: TI%u shown, last switch %u cycles\n", terminal_active, vidswitch_cycles);
+    for (tid = 0; tid < TERMINAL_COUNT; tid++)
     {
-        printf("TI1 0x%#x, PID %u, ECHO %u, VMAP %u, COOR (%u, %u), %s\n", &terminals[1], terminals[1].pcb->process_id, terminals[1].echo, terminals[1].vidmap, terminals[1].screen_x, terminals[1].screen_y, terminals[1].pcb->command);
-    }
-    else
-    {
-        printf("TI1 0x%#x Uninitialized\n", &terminals[0]);
+        created += terminals[tid].created;
+        if (terminals[tid].initialized)
+        {
+            printf("TI%u 0x%#x, PID %u, ECHO %u, VMAP %u, COOR (%u, %u), VRAM %s, %s\n", tid, &terminals[tid], terminals[tid].pcb->process_id, terminals[tid].echo, terminals[tid].vidmap, terminals[tid].screen_x, terminals[tid].screen_y, (pageTableLow[terminals[tid].video_page].physicalAddress < VIDEO_MEM_PAGE + VIDEO_SLOT_COUNT) ? "yes" : "no", terminals[tid].pcb->command);
+        }
     }
-    if (terminals[2].initialized)
+    printf("%u of %u terminals created, %u KB allocated\n", created, TERMINAL_COUNT, page_used() * (PAGE_SIZE / 1024));
+
+    // Keys typed ahead and dropped by the input rings
+    uint32_t keys, lost;
+    printf("\nKeyboard Input:");
+    for (tid = 0; tid < TERMINAL_COUNT; tid++)
     {
-        printf("TI2 0x%#x, PID %u, ECHO %u, VMAP %u, COOR (%u, %u), %s\n", &terminals[2], terminals[2].pcb->process_id, terminals[2].echo, terminals[2].vidmap, terminals[2].screen_x, terminals[2].screen_y, terminals[2].pcb->command);
+        if (terminals[tid].created)
+        {
+            terminal_input_stats(tid, &keys, &lost);
+            printf(" TI%u %u keys, %u lost;", tid, keys, lost);
+        }
     }
-    else
+    printf(" %u scancodes lost\n", scan_lost);
+    printf("Serial: COM1 %s, log %u, mirror 0x%x, %u sent, %u received, %u lost, %d queued\n", (serial_pending() == -1) ? "absent" : "115200", serial_log, serial_terminals, serial_sent, serial_received, serial_lost, serial_pending());
+
+    // Every IRQ line taken so far, with its average handler time
+    uint32_t irq, count, cycles;
+    printf("IRQ:");
+    for (irq = 0; irq < IRQ_COUNT; irq++)
     {
-        printf("TI2 0x%#x Uninitialized\n", &terminals[0]);
+        irq_stats(irq, &count, &cycles);
+        if (count != 0)
+        {
+            printf(" %u: %u, avg %u;", irq, count, cycles);
+        }
     }
+    printf(" cycles\n");
+    printf("IRQ off max PIT %u, KBD %u, RTC %u; EOI by %s, avg %u\n", irqoff_max[PIT_IRQ], irqoff_max[KEYBOARD_IRQ], irqoff_max[RTC_IRQ], apic_enable ? "LAPIC" : "8259", irq_eoi_stats());
+    printf("Preempt: %u ticks deferred, %u/s; RTC wakeup max %u, avg %u cycles\n", pit_deferred, pit_defer_rate, rtc_latency_max, rtc_latency_avg());
 
+    // Vacant PIDs are only counted, there are more than a screen holds
+    uint32_t pid, vacant = 0;
     printf("\nPCB Pool:\n");
-    if (pcb_pool[0] != NULL)
+    for (pid = 0; pid < MAX_PID_COUNT; pid++)
     {
-        printf("PCB0 0x%#x, PID %u, TID %u, PPID %u, KSP 0x%#x, FD 0x%#x, %s\n", pcb_pool[0], pcb_pool[0]->process_id, pcb_pool[0]->terminal_id, pcb_pool[0]->previous_id, pcb_pool[0]->tss_esp, &(pcb_pool[0]->file_descriptor), pcb_pool[0]->command);
-    }
-    else
-    {
-        printf("PCB0 Vacant\n");
-    }
-    if (pcb_pool[1] != NULL)
-    {
-        printf("PCB1 0x%#x, PID %u, TID %u, PPID %u, KSP 0x%#x, FD 0x%#x, %s\n", pcb_pool[1], pcb_pool[1]->process_id, pcb_pool[1]->terminal_id, pcb_pool[1]->previous_id, pcb_pool[1]->tss_esp, &(pcb_pool[1]->file_descriptor), pcb_pool[1]->command);
-    }
-    else
-    {
-        printf("PCB1 Vacant\n");
-    }
-    if (pcb_pool[2] != NULL)
-    {
-        printf("PCB2 0x%#x, PID %u, TID %u, PPID %u, KSP 0x%#x, FD 0x%#x, %s\n", pcb_pool[2], pcb_pool[2]->process_id, pcb_pool[2]->terminal_id, pcb_pool[2]->previous_id, pcb_pool[2]->tss_esp, &(pcb_pool[2]->file_descriptor), pcb_pool[2]->command);
-    }
-    else
-    {
-        printf("PCB2 Vacant\n");
-    }
-    if (pcb_pool[3] != NULL)
-    {
-        printf("PCB3 0x%#x, PID %u, TID %u, PPID %u, KSP 0x%#x, FD 0x%#x, %s\n", pcb_pool[3], pcb_pool[3]->process_id, pcb_pool[3]->terminal_id, pcb_pool[3]->previous_id, pcb_pool[3]->tss_esp, &(pcb_pool[3]->file_descriptor), pcb_pool[3]->command);
-    }
-    else
-    {
-        printf("PCB3 Vacant\n");
-    }
-    if (pcb_pool[4] != NULL)
-    {
-        printf("PCB4 0x%#x, PID %u, TID %u, PPID %u, KSP 0x%#x, FD 0x%#x, %s\n", pcb_pool[4], pcb_pool[4]->process_id, pcb_pool[4]->terminal_id, pcb_pool[4]->previous_id, pcb_pool[4]->tss_esp, &(pcb_pool[4]->file_descriptor), pcb_pool[4]->command);
-    }
-    else
-    {
-        printf("PCB4 Vacant\n");
-    }
-    if (pcb_pool[5] != NULL)
-    {
-        printf("PCB5 0x%#x, PID %u, TID %u, PPID %u, KSP 0x%#x, FD 0x%#x, %s\n", pcb_pool[5], pcb_pool[5]->process_id, pcb_pool[5]->terminal_id, pcb_pool[5]->previous_id, pcb_pool[5]->tss_esp, &(pcb_pool[5]->file_descriptor), pcb_pool[5]->command);
-    }
-    else
-    {
-        printf("PCB5 Vacant\n");
+        if (pcb_pool[pid] == NULL)
+        {
+            vacant++;
+            continue;
+        }
+        printf("PCB%u 0x%#x, PID %u, TID %u, PPID %u, KSP 0x%#x, FD 0x%#x, %s\n", pid, pcb_pool[pid], pcb_pool[pid]->process_id, pcb_pool[pid]->terminal_id, pcb_pool[pid]->previous_id, pcb_pool[pid]->tss_esp, &(pcb_pool[pid]->file_descriptor), pcb_pool[pid]->command);
     }
+    printf("%u of %u PCBs vacant\n", vacant, MAX_PID_COUNT);
 
     // Scheduler Section
     printf("\nScheduler:\n");
@@ -692,9 +690,7 @@ void print_help_msg_handler()
     unset_color();
 
     printf("Combinational Keys:\n");
-    printf("ALT+F1   Switch to Terminal 1\n");
-    printf("ALT+F2   Switch to Terminal 2\n");
-    printf("ALT+F3   Switch to Terminal 3\n");
+    printf("ALT+Fn   Switch to Terminal n, F1 to F%u\n", (TERMINAL_COUNT < FKEY_COUNT) ? TERMINAL_COUNT : FKEY_COUNT);
     printf("CTRL+C   Interrupt\n");
     printf("CTRL+L   Clear Screen\n");
     printf("CTRL+S   Enable/Disable Scheduler\n");
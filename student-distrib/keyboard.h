@@ -21,8 +21,15 @@
 #define CTRL_REL     0x9D
 #define ALT          0x38
 #define ALT_REL      0xB8
+#define EXTENDED     0xE0
+#define PAGE_UP      0x49
+#define PAGE_DOWN    0x51
 #define UPPER_LOWER_DIFF 32 /* the difference in ascii values of a lowercase character and its uppercase variant */
 
+// Scancodes waiting for the keyboard tasklet, power of 2
+#define SCAN_RING_SIZE 64
+#define SCAN_RING_MASK (SCAN_RING_SIZE - 1)
+
 #include "terminal.h"
 #include "i8259.h"
 #include "syscalls.h"
@@ -41,11 +48,11 @@ uint8_t terminal_active;
 // Enable Verbose Mode
 uint8_t verbose_mode;
 
-// Initialize the keyboard buffer
+// Drop the line being typed on a terminal
 extern void keyboard_init(int curr_terminal);
 
 // Handler to handle keyboard interrupts
-extern void keyboard_handle();
+extern void keyboard_handle(void* ctx);
 
 // Keyboard wait to wait for user confirmation
 extern void keyboard_wait(char* prompt);
@@ -53,6 +60,9 @@ extern void keyboard_wait(char* prompt);
 // Put string to active terminal
 extern void keyboard_put_active(char* prompt);
 
+// Take a character typed on the active terminal
+extern void keyboard_type(unsigned char character);
+
 // Clear screen, execute a handler and wait for user confirmation
 extern void keyboard_clear_and_wait(void (*handler)(), char* prompt, unsigned int lines);
 
@@ -2,9 +2,18 @@
  * vim:ts=4 noexpandtab */
 
 #include "lib.h"
+#include "scrollback.h"
+#include "palloc.h"
+#include "serial.h"
+#include "spinlock.h"
 
 static uint8_t sys_msg_err, sys_msg_info;
 
+// Line rings of the view pages, those of terminals are allocated when
+// the terminal is created, the scrollback and extra views keep theirs
+static screen_ring_t* screen_rings[TERMINAL_COUNT];
+static screen_ring_t view_rings[SCREEN_RING_COUNT - TERMINAL_COUNT];
+
 // Default Msg Colors
 static uint8_t err_color = INV_LIGHT_RED;
 static uint8_t info_color = INV_LIGHT_GREEN;
@@ -25,10 +34,25 @@ int min(const int num_a, const int num_b)
     }
 }
 
+/* static uint32_t vram_cell(char* page)
+ * Inputs: page: view page shown, or the text mode memory before paging
+ * Return Value: character cells from 0xB8000 to its VRAM page
+ * Function: find the VRAM page a view maps */
+static uint32_t vram_cell(char* page)
+{
+    uint32_t addr = (uint32_t) page;
+
+    if (addr >= VIDEO_VIEW_ADDR)
+    {
+        addr = pageTableLow[addr >> 12].physicalAddress << 12;
+    }
+    return (addr - VIDEO_MEM_ADDR) >> 1;
+}
+
 /* set_cursor_loc
  * Inputs: x, y: screen coordination
  * Return Value: void
- * Function: set cursor location */
+ * Function: set cursor location on the page shown */
 void set_cursor_loc(int x, int y)
 {
     if (x >= NUM_COLS || y >= NUM_ROWS)
@@ -37,7 +61,7 @@ void set_cursor_loc(int x, int y)
     }
 
     int cursor_loc;
-    cursor_loc = y * NUM_COLS + x;
+    cursor_loc = vram_cell(vram_active) + y * NUM_COLS + x;
 
     // Set Cursor Location Low Register (Index: 0x0F)
     outb(0x0F, 0x3D4);
@@ -49,6 +73,27 @@ void set_cursor_loc(int x, int y)
 
 }
 
+/* set_display_page
+ * Inputs: page: view page to show, it has to map VRAM
+ * Return Value: void
+ * Function: point the CRTC start address at the page */
+void set_display_page(char* page)
+{
+    // Start address counts character cells from 0xB8000
+    int start_loc;
+    start_loc = vram_cell(page);
+
+    // Set Start Address High Register (Index: 0x0C)
+    outb(0x0C, 0x3D4);
+    outb((0xFF00 & start_loc) >> 8, 0x3D5);
+
+    // Set Start Address Low Register (Index: 0x0D)
+    outb(0x0D, 0x3D4);
+    outb(0xFF & start_loc, 0x3D5);
+
+    vram_active = page;
+}
+
 /* set_color(uint8_t text_mode_color)
  *  Functionality: Sets the text's color.
  *  Arguments: text_mode_color - one of the macros defined in color.h
@@ -84,9 +129,13 @@ void set_msg_color(uint8_t err_msg_color, uint8_t info_msg_color)
 /* void clear(void);
  * Inputs: void
  * Return Value: none
- * Function: Clears video memory */
+ * Function: Clears video memory, takes terminal_lock */
 void clear(void) {
+    uint32_t flags;
     int32_t i;
+
+    spin_lock_irqsave(&terminal_lock, flags);
+    screen_discard(video_mem);
     for (i = 0; i < NUM_ROWS * NUM_COLS; i++) {
         *(uint8_t *)(video_mem + (i << 1)) = ' ';
         *(uint8_t *)(video_mem + (i << 1) + 1) = ATTRIB;
@@ -99,10 +148,11 @@ void clear(void) {
     ATTRIB_save = DEFAULT_COLOR;
 
     // Set cursor iff video_mem is the VRAM
-    if (video_mem == ((char *) VIDEO_MEM_ADDR))
+    if (video_mem == vram_active)
     {
         set_cursor_loc(0,0);
     }
+    spin_unlock_irqrestore(&terminal_lock, flags);
 }
 
 /* Standard printf().
@@ -270,12 +320,7 @@ format_char_switch:
  *   Return Value: Number of bytes written
  *    Function: Output a string to the console */
 int32_t puts(int8_t* s) {
-    register int32_t index = 0;
-    while (s[index] != '\0') {
-        putc(s[index]);
-        index++;
-    }
-    return index;
+    return putbuf((uint8_t*) s, strlen(s));
 }
 
 /* void putc(uint8_t c);
@@ -283,89 +328,597 @@ int32_t puts(int8_t* s) {
  * Return Value: void
  *  Function: Output a character to the console */
 void putc(uint8_t c) {
-    uint8_t spidx;  // space counter for handling tab entry
+    (void) putbuf(&c, 1);
+}
 
-    if (sys_msg_err == 1)
+/* static int32_t view_of(char* view);
+ * Inputs: view = video page the kernel writes to
+ * Return Value: index of the view page, the terminal ID for terminals,
+ *               -1 for any other page
+ * Function: find which view a page is */
+static int32_t view_of(char* view) {
+    uint32_t idx = ((uint32_t) view - VIDEO_VIEW_ADDR) / VIDEO_MEM_BYTES;
+
+    if ((uint32_t) view < VIDEO_VIEW_ADDR || idx >= SCREEN_RING_COUNT)
     {
-        ATTRIB = err_color;
+        return -1;
     }
-    else if (sys_msg_info == 1)
+    return idx;
+}
+
+/* static screen_ring_t* ring_of(char* view);
+ * Inputs: view = video page the kernel writes to
+ * Return Value: line ring of that page, NULL if it has none
+ * Function: find the ring of a view page */
+static screen_ring_t* ring_of(char* view) {
+    int32_t idx = view_of(view);
+
+    if (idx < 0)
     {
-        ATTRIB = info_color;
+        return NULL;
+    }
+    if (idx >= TERMINAL_COUNT)
+    {
+        return &view_rings[idx - TERMINAL_COUNT];
+    }
+    return screen_rings[idx];
+}
+
+/* int32_t screen_ring_alloc(uint32_t terminal_id);
+ * Inputs: terminal_id = terminal ID
+ * Return Value: 0 on success, -1 if there is no memory
+ * Function: allocate the line ring of a terminal, nothing if it has one */
+int32_t screen_ring_alloc(uint32_t terminal_id) {
+    uint32_t flags;
+    int32_t ret;
+
+    spin_lock_irqsave(&terminal_lock, flags);
+    if (screen_rings[terminal_id] == NULL)
+    {
+        screen_rings[terminal_id] = page_alloc((sizeof(screen_ring_t) + PAGE_SIZE - 1) / PAGE_SIZE);
+    }
+    ret = (screen_rings[terminal_id] == NULL) ? -1 : 0;
+    spin_unlock_irqrestore(&terminal_lock, flags);
+    return ret;
+}
+
+/* static uint16_t* screen_line(screen_ring_t* ring, int32_t y);
+ * Inputs: ring = line ring of video_mem, may be NULL
+ *         y = screen row
+ * Return Value: cells of row y
+ * Function: rows live in the ring while it is ahead of the page, and in
+ *           the page itself otherwise */
+static uint16_t* screen_line(screen_ring_t* ring, int32_t y) {
+    if (ring != NULL && ring->dirty)
+    {
+        return ring->rows[(ring->top + y) % NUM_ROWS];
+    }
+    return (uint16_t*) video_mem + NUM_COLS * y;
+}
+
+/* static void screen_scroll(screen_ring_t* ring, uint16_t blank);
+ * Inputs: ring = line ring of video_mem, may be NULL
+ *         blank = cell to fill the new last row with
+ * Return Value: none
+ * Function: move the screen up a row. With a ring this only moves its
+ *           top, the first scroll since the last refresh loads the page
+ *           into the ring. Without one the page is copied up. The row
+ *           leaving a terminal page goes to its scrollback. */
+static void screen_scroll(screen_ring_t* ring, uint16_t blank) {
+    if (ring == NULL)
+    {
+        memcpy(video_mem, video_mem + (NUM_COLS << 1), NUM_COLS * (NUM_ROWS - 1) * 2);
+        memset_word(video_mem + ((NUM_COLS * (NUM_ROWS - 1)) << 1), blank, NUM_COLS);
+        return;
+    }
+
+    if (!ring->dirty)
+    {
+        memcpy(ring->rows, video_mem, sizeof(ring->rows));
+        ring->top = 0;
+        ring->dirty = 1;
+    }
+    scrollback_append(view_of(video_mem), ring->rows[ring->top]);
+    memset_word(ring->rows[ring->top], blank, NUM_COLS);
+    ring->top = (ring->top + 1) % NUM_ROWS;
+}
+
+/* void screen_flush(char* view);
+ * Inputs: view = video page
+ * Return Value: none
+ * Function: copy the rows of the ring back to the page if it scrolled
+ *           since the last refresh, takes terminal_lock */
+void screen_flush(char* view) {
+    uint32_t flags;
+
+    spin_lock_irqsave(&terminal_lock, flags);
+    screen_flush_locked(view);
+    spin_unlock_irqrestore(&terminal_lock, flags);
+}
+
+/* void screen_flush_locked(char* view);
+ * Inputs: view = video page
+ * Return Value: none
+ * Function: screen_flush with terminal_lock held by the caller, in at
+ *           most two copies */
+void screen_flush_locked(char* view) {
+    screen_ring_t* ring = ring_of(view);
+    int32_t upper;
+
+    if (ring != NULL && ring->dirty)
+    {
+        upper = NUM_ROWS - ring->top;
+        memcpy(view, ring->rows[ring->top], NUM_COLS * upper * 2);
+        memcpy(view + ((NUM_COLS * upper) << 1), ring->rows[0], NUM_COLS * ring->top * 2);
+        ring->dirty = 0;
+    }
+}
+
+/* void screen_flush_all(void);
+ * Inputs: none
+ * Return Value: none
+ * Function: refresh every view page behind its ring, called on PIT ticks */
+void screen_flush_all(void) {
+    uint32_t idx;
+
+    for (idx = 0; idx < SCREEN_RING_COUNT; idx++)
+    {
+        screen_flush((char *) VIDEO_PAGE_ADDR(idx));
+    }
+}
+
+/* void screen_discard(char* view);
+ * Inputs: view = video page
+ * Return Value: none
+ * Function: forget scrolls not yet copied to the page, when the page is
+ *           about to be overwritten anyway */
+void screen_discard(char* view) {
+    screen_ring_t* ring = ring_of(view);
+
+    if (ring != NULL)
+    {
+        ring->dirty = 0;
+    }
+}
+
+/* static uint16_t screen_attr(const ansi_t* ansi);
+ * Inputs: ansi = escape state of the terminal written, may be NULL
+ * Return Value: attribute of new cells, in the high byte
+ * Function: colors set by SGR win over the kernel color, reverse
+ *           video swaps text and background of either */
+static uint16_t screen_attr(const ansi_t* ansi) {
+    uint8_t attr = ATTRIB;
+
+    if (ansi == NULL)
+    {
+        return attr << 8;
+    }
+    if (ansi->attr != 0)
+    {
+        attr = ansi->attr;
+    }
+    if (ansi->reverse)
+    {
+        attr = (attr << 4) | (attr >> 4);
+    }
+    return attr << 8;
+}
+
+/* static void screen_erase(screen_ring_t* ring, int32_t from, int32_t to, uint16_t blank);
+ * Inputs: ring = line ring of video_mem, may be NULL
+ *         from, to = first and last cell, counted from the top left
+ *         blank = cell to fill with
+ * Return Value: none
+ * Function: blank cells row by row, for erase in line and display */
+static void screen_erase(screen_ring_t* ring, int32_t from, int32_t to, uint16_t blank) {
+    int32_t y, x0, x1;
+
+    for (y = from / NUM_COLS; y <= to / NUM_COLS; y++)
+    {
+        x0 = (y == from / NUM_COLS) ? from % NUM_COLS : 0;
+        x1 = (y == to / NUM_COLS) ? to % NUM_COLS : NUM_COLS - 1;
+        memset_word(screen_line(ring, y) + x0, blank, x1 - x0 + 1);
+    }
+}
+
+/* static void screen_region_scroll(screen_ring_t* ring, int32_t top, int32_t bottom, int32_t rows, uint16_t blank);
+ * Inputs: ring = line ring of video_mem, may be NULL
+ *         top, bottom = first and last row of the region
+ *         rows = rows to move up, down if negative
+ *         blank = cell to fill the new rows with
+ * Return Value: none
+ * Function: scroll part of the screen. The whole screen moved up goes
+ *           through screen_scroll so its rows reach the scrollback,
+ *           rows leaving a smaller region are dropped. */
+static void screen_region_scroll(screen_ring_t* ring, int32_t top, int32_t bottom, int32_t rows, uint16_t blank) {
+    int32_t y, height = bottom - top + 1;
+
+    if (rows > height || -rows > height)
+    {
+        rows = (rows > 0) ? height : -height;
+    }
+    if (top == 0 && bottom == NUM_ROWS - 1 && rows > 0)
+    {
+        for (y = 0; y < rows; y++)
+        {
+            screen_scroll(ring, blank);
+        }
+        return;
     }
 
-    if(c == '\n' || c == '\r') {
-        screen_y = (screen_y + 1);
-        screen_x = 0;
-        if (sys_msg_err == 1 || sys_msg_info == 1)
+    if (rows > 0)
+    {
+        for (y = top; y <= bottom - rows; y++)
         {
-            sys_msg_err = 0;
-            sys_msg_info = 0;
-            ATTRIB = ATTRIB_save;
+            memcpy(screen_line(ring, y), screen_line(ring, y + rows), NUM_COLS * 2);
         }
-    } else if (c == '\b') {
-        // Edge case 1: top left corner
-        // Edge case 2: leftmost of any row
-        // Normal Case
-        if (screen_x == 0 && screen_y == 0) {
-            return;
-
-        } else if (screen_x == 0 && screen_y > 0) {
-            *(uint8_t *)(video_mem + ((NUM_COLS * (screen_y - 1) + NUM_COLS - 1) << 1)) = ' ';
-            *(uint8_t *)(video_mem + ((NUM_COLS * (screen_y - 1) + NUM_COLS - 1) << 1) + 1) = ATTRIB;
-            screen_x = NUM_COLS - 1;
-            screen_y -= 1;
-
-        } else {
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x - 1) << 1)) = ' ';
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x - 1) << 1) + 1) = ATTRIB;
-            screen_x -= 1;            
+        screen_erase(ring, (bottom - rows + 1) * NUM_COLS, bottom * NUM_COLS + NUM_COLS - 1, blank);
+    }
+    else if (rows < 0)
+    {
+        rows = -rows;
+        for (y = bottom; y >= top + rows; y--)
+        {
+            memcpy(screen_line(ring, y), screen_line(ring, y - rows), NUM_COLS * 2);
         }
-    } else if (c == '\t') {
-        // Normal case
-        for (spidx = 0; spidx < 4; spidx++)
+        screen_erase(ring, top * NUM_COLS, (top + rows) * NUM_COLS - 1, blank);
+    }
+}
+
+/* static int32_t screen_wrap(screen_ring_t* ring, const ansi_t* ansi, int32_t y, uint16_t blank);
+ * Inputs: ring = line ring of video_mem, may be NULL
+ *         ansi = escape state with the scroll region, may be NULL
+ *         y = row the cursor just moved down to
+ *         blank = cell to fill the new row with
+ * Return Value: row to write on next
+ * Function: scroll the region or the whole screen if y left its bottom,
+ *           so no row below the screen is ever written */
+static int32_t screen_wrap(screen_ring_t* ring, const ansi_t* ansi, int32_t y, uint16_t blank) {
+    if (ansi != NULL && y == ansi->bottom + 1 &&
+        (ansi->top != 0 || ansi->bottom != NUM_ROWS - 1))
+    {
+        screen_region_scroll(ring, ansi->top, ansi->bottom, 1, blank);
+        return ansi->bottom;
+    }
+    if (y == NUM_ROWS)
+    {
+        screen_scroll(ring, blank);
+        return NUM_ROWS - 1;
+    }
+    return y;
+}
+
+/* static void screen_ansi(screen_ring_t* ring, ansi_t* ansi, int32_t act, int32_t* x, int32_t* y);
+ * Inputs: ring = line ring of video_mem, may be NULL
+ *         ansi = escape state with a complete sequence
+ *         act = ANSI_ACT_CSI or ANSI_ACT_ESC
+ *         x, y = cursor, moved by the sequence
+ * Return Value: none
+ * Function: carry out a sequence. Supported are cursor moves (CSI A B C
+ *           D E F G H d f s u, ESC 7 8), erase (CSI J K), scrolling
+ *           (CSI L M S T r, ESC D M E), colors (CSI m) and reset
+ *           (ESC c). Other sequences are ignored. */
+static void screen_ansi(screen_ring_t* ring, ansi_t* ansi, int32_t act, int32_t* x, int32_t* y) {
+    uint16_t blank = screen_attr(ansi) | ' ';
+    int32_t n = ansi_param(ansi, 0, 1);
+    int32_t lo = 0, hi = NUM_ROWS - 1;
+    int32_t cell = *y * NUM_COLS + *x;
+
+    // Vertical moves stop at the scroll region while inside it
+    if (*y >= ansi->top && *y <= ansi->bottom)
+    {
+        lo = ansi->top;
+        hi = ansi->bottom;
+    }
+
+    if (act == ANSI_ACT_ESC)
+    {
+        switch (ansi->final)
         {
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = ' ';
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-            screen_x++;
-            screen_y = (screen_y + (screen_x / NUM_COLS));
-            screen_x %= NUM_COLS;
+            case '7':
+                ansi->saved_x = *x;
+                ansi->saved_y = *y;
+                break;
+            case '8':
+                *x = ansi->saved_x;
+                *y = ansi->saved_y;
+                break;
+            case 'E':
+                *x = 0;
+                /* fall through */
+            case 'D':
+                if (*y == ansi->bottom)
+                {
+                    screen_region_scroll(ring, ansi->top, ansi->bottom, 1, blank);
+                }
+                else if (*y < NUM_ROWS - 1)
+                {
+                    (*y)++;
+                }
+                break;
+            case 'M':
+                if (*y == ansi->top)
+                {
+                    screen_region_scroll(ring, ansi->top, ansi->bottom, -1, blank);
+                }
+                else if (*y > 0)
+                {
+                    (*y)--;
+                }
+                break;
+            case 'c':
+                ansi_reset(ansi);
+                blank = screen_attr(ansi) | ' ';
+                screen_erase(ring, 0, NUM_ROWS * NUM_COLS - 1, blank);
+                *x = 0;
+                *y = 0;
+                break;
+            default:
+                break;
         }
+        return;
+    }
+
+    // Private sequences such as CSI ? 25 l are not supported
+    if (ansi->priv != 0)
+    {
+        return;
+    }
+
+    switch (ansi->final)
+    {
+        case 'A':
+            *y = (*y - n < lo) ? lo : *y - n;
+            break;
+        case 'B':
+            *y = (*y + n > hi) ? hi : *y + n;
+            break;
+        case 'C':
+            *x = (*x + n > NUM_COLS - 1) ? NUM_COLS - 1 : *x + n;
+            break;
+        case 'D':
+            *x = (*x - n < 0) ? 0 : *x - n;
+            break;
+        case 'E':
+            *y = (*y + n > hi) ? hi : *y + n;
+            *x = 0;
+            break;
+        case 'F':
+            *y = (*y - n < lo) ? lo : *y - n;
+            *x = 0;
+            break;
+        case 'G':
+        case '`':
+            *x = (n > NUM_COLS) ? NUM_COLS - 1 : n - 1;
+            break;
+        case 'd':
+            *y = (n > NUM_ROWS) ? NUM_ROWS - 1 : n - 1;
+            break;
+        case 'H':
+        case 'f':
+            *y = (n > NUM_ROWS) ? NUM_ROWS - 1 : n - 1;
+            n = ansi_param(ansi, 1, 1);
+            *x = (n > NUM_COLS) ? NUM_COLS - 1 : n - 1;
+            break;
+        case 'J':
+            switch (ansi_param(ansi, 0, 0))
+            {
+                case 0:
+                    screen_erase(ring, cell, NUM_ROWS * NUM_COLS - 1, blank);
+                    break;
+                case 1:
+                    screen_erase(ring, 0, cell, blank);
+                    break;
+                default:
+                    screen_erase(ring, 0, NUM_ROWS * NUM_COLS - 1, blank);
+                    break;
+            }
+            break;
+        case 'K':
+            switch (ansi_param(ansi, 0, 0))
+            {
+                case 0:
+                    screen_erase(ring, cell, *y * NUM_COLS + NUM_COLS - 1, blank);
+                    break;
+                case 1:
+                    screen_erase(ring, *y * NUM_COLS, cell, blank);
+                    break;
+                default:
+                    screen_erase(ring, *y * NUM_COLS, *y * NUM_COLS + NUM_COLS - 1, blank);
+                    break;
+            }
+            break;
+        case 'L':
+            if (*y >= ansi->top && *y <= ansi->bottom)
+            {
+                screen_region_scroll(ring, *y, ansi->bottom, -n, blank);
+            }
+            break;
+        case 'M':
+            if (*y >= ansi->top && *y <= ansi->bottom)
+            {
+                screen_region_scroll(ring, *y, ansi->bottom, n, blank);
+            }
+            break;
+        case 'S':
+            screen_region_scroll(ring, ansi->top, ansi->bottom, n, blank);
+            break;
+        case 'T':
+            screen_region_scroll(ring, ansi->top, ansi->bottom, -n, blank);
+            break;
+        case 'm':
+            ansi->attr = ansi_sgr(ansi, (ansi->attr != 0) ? ansi->attr : ATTRIB);
+            break;
+        case 'r':
+            // The region has at least two rows, the cursor goes home
+            n = ansi_param(ansi, 1, NUM_ROWS);
+            if (ansi_param(ansi, 0, 1) < n && n <= NUM_ROWS)
+            {
+                ansi->top = ansi_param(ansi, 0, 1) - 1;
+                ansi->bottom = n - 1;
+                *x = 0;
+                *y = 0;
+            }
+            break;
+        case 's':
+            ansi->saved_x = *x;
+            ansi->saved_y = *y;
+            break;
+        case 'u':
+            *x = ansi->saved_x;
+            *y = ansi->saved_y;
+            break;
+        default:
+            break;
+    }
+}
+
+/* int32_t putbuf(const uint8_t* buf, int32_t n);
+ * Inputs: buf = characters to print
+ *         n = number of characters
+ * Return Value: n
+ * Function: Output n characters to the console, escape sequences are
+ *           printed as they are. */
+int32_t putbuf(const uint8_t* buf, int32_t n) {
+    return putbuf_ansi(buf, n, NULL);
+}
+
+/* int32_t putbuf_ansi(const uint8_t* buf, int32_t n, ansi_t* ansi);
+ * Inputs: buf = characters to print
+ *         n = number of characters
+ *         ansi = escape state of the terminal, NULL for none
+ * Return Value: n
+ * Function: Output n characters to the console. Each cell is one 16-bit
+ *           store and the cursor is set once at the end. A scroll only
+ *           moves the line ring of the page, screen_flush shows it.
+ *           With ansi, bytes from ESC on go through its parser, plain
+ *           text never does. A new line leaving the bottom of a scroll
+ *           region scrolls only the region. Kernel messages and the
+ *           terminal mirrored to COM1 are queued for it as written.
+ *           Takes terminal_lock. */
+int32_t putbuf_ansi(const uint8_t* buf, int32_t n, ansi_t* ansi) {
+    screen_ring_t* ring;
+    uint16_t* line;
+    uint16_t attr;
+    uint32_t flags;
+    int32_t i, x, y, old_y, act;
+    uint8_t spidx;  // space counter for handling tab entry
+
+    // The PIT may refresh the page, keep it out until the ring is settled
+    spin_lock_irqsave(&terminal_lock, flags);
+    ring = ring_of(video_mem);
+    x = screen_x;
+    y = screen_y;
 
-    } else {
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = c;
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-        screen_x++;
-        screen_y = (screen_y + (screen_x / NUM_COLS));
-        screen_x %= NUM_COLS;
+    if ((ansi == NULL && serial_log) || (view_of(video_mem) >= 0 && (serial_terminals & (1 << view_of(video_mem)))))
+    {
+        serial_write(buf, n);
     }
 
-    if (screen_y == NUM_ROWS)
+    if (sys_msg_err == 1)
+    {
+        ATTRIB = err_color;
+    }
+    else if (sys_msg_info == 1)
     {
-        // Set screen_y (the current row) to 24 (NUM_ROWS-1)
-        screen_y = NUM_ROWS - 1;
+        ATTRIB = info_color;
+    }
+    attr = screen_attr(ansi);
+    line = screen_line(ring, y);
 
-        memcpy((uint8_t *)video_mem, (uint8_t *)(video_mem + (NUM_COLS << 1)), (NUM_COLS * screen_y * 2));
+    for (i = 0; i < n; i++) {
+        old_y = y;
+        if (ansi != NULL && (ansi->state != ANSI_GROUND || buf[i] == ANSI_ESC))
+        {
+            act = ansi_feed(ansi, buf[i]);
+            if (act == ANSI_ACT_CSI || act == ANSI_ACT_ESC)
+            {
+                screen_ansi(ring, ansi, act, &x, &y);
+                attr = screen_attr(ansi);
+                line = screen_line(ring, y);
+                continue;
+            }
+            if (act != ANSI_ACT_EXECUTE)
+            {
+                continue;
+            }
+        }
+
+        switch (buf[i]) {
+            case '\n':
+            case '\r':
+                y++;
+                x = 0;
+                if (sys_msg_err == 1 || sys_msg_info == 1)
+                {
+                    sys_msg_err = 0;
+                    sys_msg_info = 0;
+                    ATTRIB = ATTRIB_save;
+                    attr = screen_attr(ansi);
+                }
+                break;
 
-        // Set the last row
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = ' ';
-        *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-        screen_x++;
+            case '\b':
+                // Edge case 1: top left corner
+                // Edge case 2: leftmost of any row
+                // Normal Case
+                if (x == 0 && y == 0) {
+                    break;
+                } else if (x == 0) {
+                    x = NUM_COLS - 1;
+                    y--;
+                    line = screen_line(ring, y);
+                } else {
+                    x--;
+                }
+                line[x] = attr | ' ';
+                break;
 
-        while (screen_x != 0)
+            case '\t':
+                for (spidx = 0; spidx < 4; spidx++)
+                {
+                    line[x] = attr | ' ';
+                    if (++x == NUM_COLS)
+                    {
+                        // Scroll before the next space is written
+                        x = 0;
+                        y = screen_wrap(ring, ansi, y + 1, attr | ' ');
+                        line = screen_line(ring, y);
+                    }
+                }
+                break;
+
+            default:
+                line[x] = attr | buf[i];
+                if (++x == NUM_COLS)
+                {
+                    x = 0;
+                    y++;
+                }
+                break;
+        }
+
+        if (y > old_y)
         {
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1)) = ' ';
-            *(uint8_t *)(video_mem + ((NUM_COLS * screen_y + screen_x) << 1) + 1) = ATTRIB;
-            screen_x++;
-            screen_x %= NUM_COLS;
+            y = screen_wrap(ring, ansi, y, attr | ' ');
+            line = screen_line(ring, y);
+        }
+        else if (x == 0)
+        {
+            line = screen_line(ring, y);
         }
     }
 
+    screen_x = x;
+    screen_y = y;
+
     // Set cursor iff video_mem is the VRAM
-    if (video_mem == ((char *) VIDEO_MEM_ADDR))
+    if (video_mem == vram_active)
     {
         set_cursor_loc(screen_x, screen_y);
     }
+    spin_unlock_irqrestore(&terminal_lock, flags);
+    return n;
 }
 
 /* int8_t* itoa(uint32_t value, int8_t* buf, int32_t radix);
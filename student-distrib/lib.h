@@ -7,16 +7,35 @@
 
 #include "types.h"
 #include "color.h"
+#include "ansi.h"
 #include "scheduler.h"
 
 #define NUM_COLS    80
 #define NUM_ROWS    25
 
+// Every view page has a ring, see VIDEO_VIEW_ADDR
+#define SCREEN_RING_COUNT   VIDEO_VIEW_COUNT
+
+// Rows of a video page, kept here while scrolls are not yet shown
+typedef struct screen_ring_t
+{
+    uint16_t rows[NUM_ROWS][NUM_COLS];
+    uint8_t top;        // ring row at the top of the screen
+    uint8_t dirty;      // scrolled since the page was refreshed
+} screen_ring_t;
+
 uint8_t ATTRIB;
 uint8_t ATTRIB_save;
 
 int32_t printf(int8_t *format, ...);
 void putc(uint8_t c);
+int32_t putbuf(const uint8_t* buf, int32_t n);
+int32_t putbuf_ansi(const uint8_t* buf, int32_t n, ansi_t* ansi);
+void screen_flush(char* view);
+void screen_flush_locked(char* view);
+void screen_flush_all(void);
+void screen_discard(char* view);
+int32_t screen_ring_alloc(uint32_t terminal_id);
 int32_t puts(int8_t *s);
 int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
@@ -38,6 +57,7 @@ int32_t bad_userspace_addr(const void* addr, int32_t len);
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 
 void set_cursor_loc(int x, int y);
+void set_display_page(char* page);
 void set_color(uint8_t text_mode_color);
 void set_msg_color(uint8_t err_msg_color, uint8_t info_msg_color);
 void unset_color();
@@ -110,13 +130,47 @@ do {                                    \
 /* Writes four bytes to four consecutive ports */
 #define outl(data, port)                \
 do {                                    \
-    asm volatile ("outl %l1, (%w0)"     \
+    asm volatile ("outl %k1, (%w0)"     \
             :                           \
             : "d"(port), "a"(data)      \
             : "memory", "cc"            \
     );                                  \
 } while (0)
 
+/* Writes a 64-bit value (high:low) to a model-specific register */
+#define wrmsr(msr, low, high)           \
+do {                                    \
+    asm volatile ("wrmsr"               \
+            :                           \
+            : "c"(msr), "a"(low), "d"(high) \
+            : "memory"                  \
+    );                                  \
+} while (0)
+
+/* Reads a model specific register into low and high */
+#define rdmsr(msr, low, high)           \
+do {                                    \
+    asm volatile ("rdmsr"               \
+            : "=a"(low), "=d"(high)     \
+            : "c"(msr)                  \
+    );                                  \
+} while (0)
+
+/* Executes CPUID for the given leaf, storing EAX, EBX, ECX and EDX */
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    asm volatile ("cpuid"
+            : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+            : "a"(leaf), "c"(0)
+    );
+}
+
+/* Read the time stamp counter, the low word is enough for short intervals */
+static inline uint32_t rdtsc_low(void) {
+    uint32_t low, high;
+    asm volatile ("rdtsc" : "=a"(low), "=d"(high));
+    return low;
+}
+
 /* Clear interrupt flag - disables interrupts on this processor */
 #define cli()                           \
 do {                                    \
@@ -71,17 +71,17 @@ extern void handle_exception_machine_check();
 // ASM linkage to exception handling of SIMD floating point
 extern void handle_exception_SIMD_floating_point();
 
-// ASM linkage to interrupt handling of PIT
-extern void handle_interrupt_PIT();
+// ASM linkage to interrupt handling of every IRQ, in IRQ # order
+extern uint32_t handle_irq_table[IRQ_COUNT];
 
-// ASM linkage to interrupt handling of keyboard
-extern void handle_interrupt_keyboard();
-
-// ASM linkage to interrupt handling of RTC
-extern void handle_interrupt_RTC();
+// ASM linkage to spurious LAPIC interrupts
+extern void handle_apic_spurious();
 
 // ASM linkage to interrupt handling of system calls
 extern void handle_syscall();
 
+// ASM linkage to SYSENTER fast system calls
+extern void handle_sysenter();
+
 #endif /* ASM */
 #endif /* _LINKAGE_H */
@@ -25,6 +25,8 @@
  */
 void paging_init()  // enables paging, sets cr3 register
 {
+    int i;
+
     // Initialize PD
     set_page_directory();
 
@@ -53,24 +55,28 @@ void paging_init()  // enables paging, sets cr3 register
     pageDir[33].US = 1;
     pageDir[33].pd_address = (((uint32_t)pageTableHigh) >> 12);
 
-    // Set entries in PT for vid mem
-    // Direct Map to VRAM
-    pageTableLow[0xB8].P = 1;
-    pageTableLow[0xB8].physicalAddress = VIDEO_MEM_PAGE;
+    // Initialize PT for the framebuffer
+    set_page_table(pageTableFB);
 
-    // Backup spaces for multiterminal
-    pageTableLow[0xB9].P = 1;
-    pageTableLow[0xB9].physicalAddress = VIDEO_BACKUP_PAGE0;
+    // Set an entry in PD for PT for the framebuffer, mapped on demand
+    pageDir[FB_PAGE_DIR_ENTRY].US = 1;
+    pageDir[FB_PAGE_DIR_ENTRY].pd_address = (((uint32_t)pageTableFB) >> 12);
 
-    pageTableLow[0xBA].P = 1;
-    pageTableLow[0xBA].physicalAddress = VIDEO_BACKUP_PAGE1;
+    // Set entries in PT for vid mem
+    // Direct Map text mode memory, written directly until the views are set up
+    for (i = 0; i < VIDEO_VRAM_PAGES; i++)
+    {
+        pageTableLow[VIDEO_MEM_PAGE + i].P = 1;
+        pageTableLow[VIDEO_MEM_PAGE + i].physicalAddress = VIDEO_MEM_PAGE + i;
+    }
 
-    pageTableLow[0xBB].P = 1;
-    pageTableLow[0xBB].physicalAddress = VIDEO_BACKUP_PAGE2;
+    // View for scrollback, terminal views are mapped when created
+    pageTableLow[VIDEO_SCROLLBACK_ADDR >> 12].P = 1;
+    pageTableLow[VIDEO_SCROLLBACK_ADDR >> 12].physicalAddress = VIDEO_SCROLLBACK_PAGE;
 
-    // Extra backup space for kernel
-    pageTableLow[0xBC].P = 1;
-    pageTableLow[0xBC].physicalAddress = VIDEO_BACKUP_PAGE_EXTRA;
+    // Extra view for kernel
+    pageTableLow[VIDEO_BACKUP_ADDR_EXTRA >> 12].P = 1;
+    pageTableLow[VIDEO_BACKUP_ADDR_EXTRA >> 12].physicalAddress = VIDEO_BACKUP_PAGE_EXTRA;
 
     // Set an entry in PT for vidmap
     pageTableHigh[0].US = 1;
@@ -150,6 +156,42 @@ void reMap4MBPage(int8_t pid)
     flushTLB();
 }
 
+/* void mapKernelPage()
+ * Inputs: uint32_t address - physical address of RAM
+ * Return Value: none
+ * Function: helper function to identity map the 4MB page holding
+ * address for the kernel, e.g. the page pool
+ */
+void mapKernelPage(uint32_t address)
+{
+    uint32_t index = address >> 22;
+
+    pageDir[index].P = 1;
+    pageDir[index].US = 0;
+    pageDir[index].PS = 1;
+    pageDir[index].pd_address = (index << 22) >> 12;
+    flushTLB();
+}
+
+/* void mapMMIOPage()
+ * Inputs: uint32_t address - physical address of device registers
+ * Return Value: none
+ * Function: helper function to identity map the 4MB page holding
+ * address for the kernel, with caching disabled
+ */
+void mapMMIOPage(uint32_t address)
+{
+    uint32_t index = address >> 22;
+
+    pageDir[index].P = 1;
+    pageDir[index].US = 0;
+    pageDir[index].PS = 1;
+    pageDir[index].PWT = 1;
+    pageDir[index].PCD = 1;
+    pageDir[index].pd_address = (index << 22) >> 12;
+    flushTLB();
+}
+
 /* void map4KBVidMemPage()
  * Inputs: none
  * Return Value: none
@@ -172,6 +214,51 @@ void unMap4KBVidMemPage()
     flushTLB();
 }
 
+/* void setFBPages()
+ * Inputs: uint32_t address - physical address of the framebuffer
+ *         uint32_t count - 4kb pages of the framebuffer
+ * Return Value: none
+ * Function: helper function to point the user framebuffer pages at the
+ * framebuffer. PWT picks PAT entry 1, write combining once vbe.c set it
+ */
+void setFBPages(uint32_t address, uint32_t count)
+{
+    uint32_t i;
+
+    for (i = 0; i < PAGE_TABLE_SIZE; i++)
+    {
+        pageTableFB[i].P = (i < count);
+        pageTableFB[i].US = 1;
+        pageTableFB[i].PWT = 1;
+        pageTableFB[i].PCD = 0;
+        pageTableFB[i].PAT = 0;
+        pageTableFB[i].physicalAddress = (address >> 12) + i;
+    }
+    flushTLB();
+}
+
+/* void mapFBPage()
+ * Inputs: none
+ * Return Value: none
+ * Function: helper function to map the user framebuffer pages
+ */
+void mapFBPage()
+{
+    pageDir[FB_PAGE_DIR_ENTRY].P = 1;
+    flushTLB();
+}
+
+/* void unMapFBPage()
+ * Inputs: none
+ * Return Value: none
+ * Function: helper function to unmap the user framebuffer pages
+ */
+void unMapFBPage()
+{
+    pageDir[FB_PAGE_DIR_ENTRY].P = 0;
+    flushTLB();
+}
+
 /* void set_page_table()
  * Inputs: None
  * Return Value: void
@@ -7,11 +7,16 @@
 #define PAGE_DIR_SIZE 1024
 #define PAGE_TABLE_SIZE 1024
 
+// Text mode memory, and the view pages which map it, see scheduler.h
 #define VIDEO_MEM_PAGE 0xB8
-#define VIDEO_BACKUP_PAGE0 0xB9
-#define VIDEO_BACKUP_PAGE1 0xBA
-#define VIDEO_BACKUP_PAGE2 0xBB
-#define VIDEO_BACKUP_PAGE_EXTRA 0xBC
+#define VIDEO_VRAM_PAGES 8
+#define VIDEO_VIEW_PAGE 0xC0
+#define VIDEO_PAGE(tid) (VIDEO_VIEW_PAGE + (tid))
+#define VIDEO_SCROLLBACK_PAGE 0xBE
+#define VIDEO_BACKUP_PAGE_EXTRA 0xBF
+
+// PDE of the framebuffer mapped for user programs, at 0x08800000
+#define FB_PAGE_DIR_ENTRY 34
 
 #ifndef ASM
 
@@ -53,6 +58,7 @@ struct pageDir_t pageDir[PAGE_DIR_SIZE]__attribute__((aligned(4096)));
 /* array of page table entries, aligned to 4kb */  
 struct pageTable_t pageTableLow[PAGE_TABLE_SIZE]__attribute__((aligned(4096)));
 struct pageTable_t pageTableHigh[PAGE_TABLE_SIZE]__attribute__((aligned(4096)));
+struct pageTable_t pageTableFB[PAGE_TABLE_SIZE]__attribute__((aligned(4096)));
 
 /* main hub function that calls all other paging helpers */
 extern void paging_init();             
@@ -72,6 +78,21 @@ extern void map4KBVidMemPage();
 /* helper function to unmap the new 4kb page for program video mem in user level*/
 extern void unMap4KBVidMemPage();
 
+/* helper function to point the user framebuffer pages at physical memory */
+extern void setFBPages(uint32_t address, uint32_t count);
+
+/* helper function to map the user framebuffer pages */
+extern void mapFBPage();
+
+/* helper function to unmap the user framebuffer pages */
+extern void unMapFBPage();
+
+/* helper function to identity map a 4MB page of RAM for the kernel */
+extern void mapKernelPage(uint32_t address);
+
+/* helper function to map a 4MB page of device registers for the kernel */
+extern void mapMMIOPage(uint32_t address);
+
 /* helper function to flushTLB on a context switch */
 extern void flushTLB();
 
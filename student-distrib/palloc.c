@@ -0,0 +1,156 @@
+/**
+ *  palloc.c - Kernel page allocator
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: 
+ */
+
+#include "palloc.h"
+
+// File-scope variables
+// One bit per page of the pool, set while allocated, and pages allocated
+static uint32_t page_map[PAGE_POOL_COUNT / 32];
+static uint32_t page_count = 0;
+
+// File-scope helper functions
+// Helper function to test the bit of a page
+static uint32_t page_taken(uint32_t idx);
+
+// Helper function to set or clear the bits of a run of pages
+static void page_mark(uint32_t idx, uint32_t count, uint8_t taken);
+
+/* 
+ * page_init
+ *   DESCRIPTION: Map the page pool for the kernel.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Call after paging_init.
+ */
+void page_init(void)
+{
+    uint32_t addr;
+
+    for (addr = PAGE_POOL_ADDR; addr < PAGE_POOL_ADDR + PAGE_POOL_BYTES; addr += 0x400000)
+    {
+        mapKernelPage(addr);
+    }
+}
+
+/* 
+ * page_alloc
+ *   DESCRIPTION: Allocate contiguous pages, first fit.
+ *   INPUTS: count - number of 4KB pages
+ *   OUTPUTS: none
+ *   RETURN VALUE: address of the first page, NULL if no run is free
+ *   SIDE EFFECTS: The pages are zeroed.
+ */
+void* page_alloc(uint32_t count)
+{
+    uint32_t idx, run = 0, flags;
+    void* addr;
+
+    if (count == 0)
+    {
+        return NULL;
+    }
+
+    cli_and_save(flags);
+    for (idx = 0; idx < PAGE_POOL_COUNT; idx++)
+    {
+        run = page_taken(idx) ? 0 : run + 1;
+        if (run == count)
+        {
+            break;
+        }
+    }
+    if (run != count)
+    {
+        restore_flags(flags);
+        return NULL;
+    }
+    idx = idx + 1 - count;
+    page_mark(idx, count, 1);
+    page_count += count;
+    restore_flags(flags);
+
+    addr = (void*) (PAGE_POOL_ADDR + idx * PAGE_SIZE);
+    memset(addr, 0, count * PAGE_SIZE);
+    return addr;
+}
+
+/* 
+ * page_free
+ *   DESCRIPTION: Give pages back to the pool.
+ *   INPUTS: addr - address from page_alloc
+ *           count - number of pages allocated there
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void page_free(void* addr, uint32_t count)
+{
+    uint32_t idx = ((uint32_t) addr - PAGE_POOL_ADDR) / PAGE_SIZE;
+    uint32_t flags;
+
+    if (addr == NULL || (uint32_t) addr < PAGE_POOL_ADDR || idx + count > PAGE_POOL_COUNT)
+    {
+        return;
+    }
+
+    cli_and_save(flags);
+    page_mark(idx, count, 0);
+    page_count -= count;
+    restore_flags(flags);
+}
+
+/* 
+ * page_used
+ *   DESCRIPTION: Pages allocated now.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: number of pages
+ *   SIDE EFFECTS: none
+ */
+uint32_t page_used(void)
+{
+    return page_count;
+}
+
+/* 
+ * page_taken
+ *   DESCRIPTION: Tell if a page of the pool is allocated.
+ *   INPUTS: idx - index of the page in the pool
+ *   OUTPUTS: none
+ *   RETURN VALUE: nonzero if allocated, 0 if free
+ *   SIDE EFFECTS: none
+ */
+static uint32_t page_taken(uint32_t idx)
+{
+    return page_map[idx >> 5] & (1 << (idx & 0x1F));
+}
+
+/* 
+ * page_mark
+ *   DESCRIPTION: Mark a run of pages allocated or free.
+ *   INPUTS: idx - index of the first page in the pool
+ *           count - number of pages
+ *           taken - 1 for allocated, 0 for free
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Call with interrupts off.
+ */
+static void page_mark(uint32_t idx, uint32_t count, uint8_t taken)
+{
+    for (; count > 0; count--, idx++)
+    {
+        if (taken)
+        {
+            page_map[idx >> 5] |= (1 << (idx & 0x1F));
+        }
+        else
+        {
+            page_map[idx >> 5] &= ~(1 << (idx & 0x1F));
+        }
+    }
+}
@@ -0,0 +1,39 @@
+/**
+ *  palloc.h - Kernel page allocator
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: 
+ */
+
+#ifndef _PALLOC_H
+#define _PALLOC_H
+
+#include "types.h"
+#include "signals.h"
+
+// Pool of 4KB pages right above the program pages of every PID,
+// identity mapped for the kernel
+#define PAGE_POOL_ADDR (0x800000 + MAX_PID_COUNT * 0x400000)
+#define PAGE_POOL_BYTES 0x800000
+#define PAGE_SIZE 4096
+#define PAGE_POOL_COUNT (PAGE_POOL_BYTES / PAGE_SIZE)
+
+#ifndef ASM
+
+#include "lib.h"
+
+// Map the pool, every page starts free
+extern void page_init(void);
+
+// Allocate count contiguous zeroed pages, NULL if there is no room
+extern void* page_alloc(uint32_t count);
+
+// Free pages from page_alloc
+extern void page_free(void* addr, uint32_t count);
+
+// Pages allocated now
+extern uint32_t page_used(void);
+
+#endif /* ASM */
+
+#endif /* _PALLOC_H */
@@ -0,0 +1,311 @@
+/**
+ *  pipe.c - pipes between processes of a terminal
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources:
+ */
+
+#include "pipe.h"
+#include "syscalls.h"
+
+// Ring buffer with one wait queue for each end.
+// head and tail run freely, the bytes buffered are tail - head.
+// Whether an end is open is found from the FDs, see pipe_end_open().
+typedef struct pipe_t
+{
+    uint32_t head;                      // Next byte to read
+    uint32_t tail;                      // Next byte to write
+    wait_queue_t readers;               // Waiting for data
+    wait_queue_t writers;               // Waiting for space
+    uint8_t buf[PIPE_SIZE];
+} pipe_t;
+
+// File-scope helper functions
+// Helper function to tell if any FD refers to a pipe end
+static int32_t pipe_end_open(uint32_t pipe_i, const file_op_ptr_t* end, uint8_t waiting);
+
+// File-scope data structures
+static pipe_t pipes[PIPE_COUNT];
+
+struct file_op_ptr_t pipe_read_sys_calls =
+{
+    pipe_open,
+    pipe_close,
+    pipe_read,
+    pipe_write_invalid,
+    pipe_poll
+};
+
+struct file_op_ptr_t pipe_write_sys_calls =
+{
+    pipe_open,
+    pipe_close,
+    pipe_read_invalid,
+    pipe_write,
+    pipe_poll
+};
+
+/* Function: sys_pipe
+ * Description: Create a pipe and open both of its ends in the current
+ *              process. dup2 moves an end onto stdin or stdout, which
+ *              execute and spawn pass on to the new program.
+ * Inputs: fds - array of two FDs in the program page
+ * Outputs: 0 - success, -1 - failed
+ * Side Effects: fds[0] is the read end, fds[1] is the write end
+ */
+int32_t sys_pipe(int32_t* fds)
+{
+    int32_t pipe_i, fd_i, rfd = -1, wfd = -1;
+    file_desc_t* fde = pcb->file_descriptor;
+
+    for (pipe_i = 0; pipe_i < PIPE_COUNT; pipe_i++)
+    {
+        if (!pipe_end_open(pipe_i, &pipe_read_sys_calls, 1) && !pipe_end_open(pipe_i, &pipe_write_sys_calls, 1)) { break; }
+    }
+    if (pipe_i == PIPE_COUNT)
+    {
+        printf("<!> Maximum pipe limit exceed.\n");
+        error_sound();
+        return -1;
+    }
+
+    for (fd_i = 2; fd_i < FD_COUNT; fd_i++)
+    {
+        if (fde[fd_i].flags != FD_FLAG_EMPTY) { continue; }
+        if (rfd == -1) { rfd = fd_i; }
+        else { wfd = fd_i; break; }
+    }
+    if (wfd == -1)
+    {
+        printf("<!> File descriptor array is full.\n");
+        error_sound();
+        return -1;
+    }
+
+    pipes[pipe_i].head = 0;
+    pipes[pipe_i].tail = 0;
+    pipes[pipe_i].readers.pid_mask = 0;
+    pipes[pipe_i].writers.pid_mask = 0;
+
+    // inode is the pipe #, the op table tells the ends apart
+    fde[rfd].file_op_table_ptr = &pipe_read_sys_calls;
+    fde[rfd].inode = pipe_i;
+    fde[rfd].file_position = 0;
+    fde[rfd].flags = FD_FLAG_PIPE;
+    fde[rfd].status = 0;
+    fde[wfd].file_op_table_ptr = &pipe_write_sys_calls;
+    fde[wfd].inode = pipe_i;
+    fde[wfd].file_position = 0;
+    fde[wfd].flags = FD_FLAG_PIPE;
+    fde[wfd].status = 0;
+
+    fds[0] = rfd;
+    fds[1] = wfd;
+    return 0;
+}
+
+/* Function: pipe_open
+ * Description: Pipes have no name in the file system
+ * Inputs: ignored
+ * Outputs: -1
+ * Side Effects: none
+ */
+int32_t pipe_open(const uint8_t* filename)
+{
+    return -1;
+}
+
+/* Function: pipe_close
+ * Description: Wake both ends, so sleepers check again whether the
+ *              other end is still open once this FD is gone
+ * Inputs: fd - FD of the current process being closed
+ * Outputs: 0
+ * Side Effects: none
+ */
+int32_t pipe_close(int32_t fd)
+{
+    pipe_t* p = &pipes[(pcb->file_descriptor)[fd].inode];
+
+    wake_up(&p->readers);
+    wake_up(&p->writers);
+    return 0;
+}
+
+/* Function: pipe_read
+ * Description: Read what is buffered, up to nbytes. Sleeps while the
+ *              pipe is empty and the write end is still open, unless
+ *              the FD has O_NONBLOCK.
+ * Inputs: fd - read end, buf - destination, nbytes - maximum bytes
+ * Outputs: bytes read, 0 at end of file, -1 if empty with O_NONBLOCK
+ * Side Effects: writers waiting for space are woken
+ */
+int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes)
+{
+    uint32_t pipe_i = (pcb->file_descriptor)[fd].inode;
+    pipe_t* p = &pipes[pipe_i];
+    uint32_t count, first;
+
+    if (nbytes == 0) { return 0; }
+
+    cli();
+    while ((p->head == p->tail) && pipe_end_open(pipe_i, &pipe_write_sys_calls, 0))
+    {
+        // 0 would mean end of file, so tell the caller to try again
+        if ((pcb->file_descriptor)[fd].status & O_NONBLOCK)
+        {
+            sti();
+            return -1;
+        }
+        sleep_on(&p->readers);
+    }
+
+    // Copy in at most two pieces around the end of the buffer
+    count = min(nbytes, p->tail - p->head);
+    first = min(count, PIPE_SIZE - (p->head & PIPE_MASK));
+    memcpy(buf, &(p->buf[p->head & PIPE_MASK]), first);
+    memcpy((uint8_t*) buf + first, p->buf, count - first);
+    p->head += count;
+
+    wake_up(&p->writers);
+    sti();
+    return count;
+}
+
+/* Function: pipe_write
+ * Description: Write all nbytes, sleeping whenever the pipe is full.
+ *              Stops early if the read end is closed, or once the pipe
+ *              is full if the FD has O_NONBLOCK.
+ * Inputs: fd - write end, buf - source, nbytes - bytes to write
+ * Outputs: bytes written, -1 if the read end was closed before any,
+ *          or the pipe was full with O_NONBLOCK
+ * Side Effects: readers waiting for data are woken
+ */
+int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes)
+{
+    uint32_t pipe_i = (pcb->file_descriptor)[fd].inode;
+    pipe_t* p = &pipes[pipe_i];
+    uint32_t count, first, written = 0;
+    uint8_t nonblock = (pcb->file_descriptor)[fd].status & O_NONBLOCK;
+
+    cli();
+    while ((written < nbytes) && pipe_end_open(pipe_i, &pipe_read_sys_calls, 0))
+    {
+        if ((p->tail - p->head) == PIPE_SIZE)
+        {
+            if (nonblock)
+            {
+                break;
+            }
+            // Full, let the reader drain it first
+            wake_up(&p->readers);
+            sleep_on(&p->writers);
+            continue;
+        }
+
+        count = min(nbytes - written, PIPE_SIZE - (p->tail - p->head));
+        first = min(count, PIPE_SIZE - (p->tail & PIPE_MASK));
+        memcpy(&(p->buf[p->tail & PIPE_MASK]), (uint8_t*) buf + written, first);
+        memcpy(p->buf, (uint8_t*) buf + written + first, count - first);
+        p->tail += count;
+        written += count;
+    }
+
+    wake_up(&p->readers);
+    sti();
+
+    if ((written == 0) && (nbytes != 0))
+    {
+        if (!nonblock || !pipe_end_open(pipe_i, &pipe_read_sys_calls, 0))
+        {
+            printf("<!> Pipe has no reader.\n");
+        }
+        return -1;
+    }
+    return written;
+}
+
+/* Function: pipe_poll
+ * Description: Poll entry of both ends. The read end is readable with
+ *              data buffered, the write end is writable with space
+ *              left. Either one hangs up once the other end is closed.
+ * Inputs: fd - pipe end, wait - join the wait queue of this end
+ * Outputs: POLLIN, POLLOUT and POLLHUP as they apply
+ * Side Effects: none
+ */
+int32_t pipe_poll(int32_t fd, uint8_t wait)
+{
+    file_desc_t* fde = &((pcb->file_descriptor)[fd]);
+    pipe_t* p = &pipes[fde->inode];
+    int32_t revents = 0;
+
+    if (fde->file_op_table_ptr == &pipe_read_sys_calls)
+    {
+        if (p->head != p->tail) { revents |= POLLIN; }
+        if (!pipe_end_open(fde->inode, &pipe_write_sys_calls, 0)) { revents |= POLLHUP; }
+        if (!revents && wait) { poll_wait(&p->readers); }
+    }
+    else
+    {
+        if ((p->tail - p->head) < PIPE_SIZE) { revents |= POLLOUT; }
+        if (!pipe_end_open(fde->inode, &pipe_read_sys_calls, 0)) { revents |= POLLHUP; }
+        if (!revents && wait) { poll_wait(&p->writers); }
+    }
+    return revents;
+}
+
+/* Function: pipe_read_invalid
+ * Description: Write end of a pipe is not readable
+ * Inputs: ignored
+ * Outputs: -1
+ * Side Effects: none
+ */
+int32_t pipe_read_invalid(int32_t fd, void* buf, int32_t nbytes)
+{
+    printf("pipe_read: Cannot read from the write end.\n");
+    return -1;
+}
+
+/* Function: pipe_write_invalid
+ * Description: Read end of a pipe is not writable
+ * Inputs: ignored
+ * Outputs: -1
+ * Side Effects: none
+ */
+int32_t pipe_write_invalid(int32_t fd, const void* buf, int32_t nbytes)
+{
+    printf("pipe_write: Cannot write to the read end.\n");
+    return -1;
+}
+
+/* Function: pipe_end_open
+ * Description: Search every process for a FD on a pipe end. FDs are
+ *              copied by dup2, execute and spawn, so searching here
+ *              saves a reference count in every copy path. A process
+ *              waiting in execute cannot use its FDs, so it does not
+ *              keep an end open for the programs it waits for, e.g. a
+ *              shell keeps the read end on stdin while running "a | b".
+ * Inputs: pipe_i - pipe #
+ *         end - op table of the end, read or write
+ *         waiting - 1 to count processes waiting in execute too
+ * Outputs: 1 - open, 0 - closed
+ * Side Effects: none
+ */
+static int32_t pipe_end_open(uint32_t pipe_i, const file_op_ptr_t* end, uint8_t waiting)
+{
+    file_desc_t* fde;
+    int pid_i, fd_i;
+
+    for (pid_i = 0; pid_i < MAX_PID_COUNT; pid_i++)
+    {
+        if ((pcb_pool[pid_i] == NULL) || (!waiting && (pcb_pool[pid_i]->state == PROC_WAITING))) { continue; }
+        for (fd_i = 0; fd_i < FD_COUNT; fd_i++)
+        {
+            fde = &((pcb_pool[pid_i]->file_descriptor)[fd_i]);
+            if ((fde->flags == FD_FLAG_PIPE) && (fde->file_op_table_ptr == end) && (fde->inode == pipe_i))
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+/**
+ *  pipe.h - pipes between processes of a terminal
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources:
+ */
+
+#ifndef _PIPE_H
+#define _PIPE_H
+
+// Pipes open at the same time
+#define PIPE_COUNT 4
+
+// Bytes buffered in each pipe, must be power of 2
+#define PIPE_SIZE 4096
+#define PIPE_MASK (PIPE_SIZE - 1)
+
+#include "types.h"
+
+#ifndef ASM
+
+#include "lib.h"
+
+// Create a pipe, fds[0] is the read end and fds[1] is the write end
+extern int32_t sys_pipe(int32_t* fds);
+
+// Pipe FD operations, pipes are only opened by sys_pipe
+extern int32_t pipe_open(const uint8_t* filename);
+extern int32_t pipe_close(int32_t fd);
+extern int32_t pipe_read(int32_t fd, void* buf, int32_t nbytes);
+extern int32_t pipe_write(int32_t fd, const void* buf, int32_t nbytes);
+extern int32_t pipe_poll(int32_t fd, uint8_t wait);
+extern int32_t pipe_read_invalid(int32_t fd, void* buf, int32_t nbytes);
+extern int32_t pipe_write_invalid(int32_t fd, const void* buf, int32_t nbytes);
+
+#endif /* ASM */
+#endif /* _PIPE_H */
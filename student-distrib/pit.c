@@ -7,33 +7,45 @@
 
 #include "pit.h"
 
-void pit_handle()
+/* void pit_handle(void* ctx)
+ * Inputs: ctx - ignored
+ * Return Value: none
+ * Function: ask for a switch to the next terminal, which happens on the
+ *           interrupt exit, or at the next safe point if preemption is
+ *           disabled now
+ */
+void pit_handle(void* ctx)
 {
+    // Count deferred ticks over a window of one second
+    if ((vrtc_ticks - pit_window) >= VRTC_TICKS_PER_SEC)
+    {
+        pit_defer_rate = pit_defer_window;
+        pit_defer_window = 0;
+        pit_window = vrtc_ticks;
+    }
+
     // Send EOI
     send_eoi(PIT_IRQ);
 
+    // Let the ring of the running process drain on its way out
+    ring_tick(pcb);
+
+    // Show the rows scrolled since the last tick
+    screen_flush_all();
+
     // Determine work environment
-    if (progress || ((!scheduler_enable) && (pcb->terminal_id == terminal_active)))
+    if ((!scheduler_enable) && (pcb->terminal_id == terminal_active))
     {
         return;
     }
 
-    // Switch the process
-    switch (pcb->terminal_id)
+    // Tasklets running and held locks delay the switch
+    if (preempt_count || in_softirq())
     {
-        case 0:
-            switchContext(1);
-            break;
-
-        case 1:
-            switchContext(2);
-            break;
-
-        case 2:
-            switchContext(0);
-            break;
-
-        default:
-            break;
+        pit_deferred++;
+        pit_defer_window++;
     }
+
+    // Switch the process, terminals without a shell wait for ALT+Fn
+    resched_terminal(terminal_next(pcb->terminal_id));
 }
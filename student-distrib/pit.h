@@ -18,12 +18,21 @@
 #include "i8259.h"
 #include "scheduler.h"
 #include "keyboard.h"
+#include "ring.h"
 
 #ifndef ASM
 
 // We are not using syscall interface on PIT, exclusively for OS
 // Handle PIT Interrupts
-extern void pit_handle();
+extern void pit_handle(void* ctx);
+
+// Ticks whose switch waited for locks or tasklets
+uint32_t pit_deferred;
+
+// Ticks deferred in the last whole second, and the current window
+uint32_t pit_defer_rate;
+uint32_t pit_defer_window;
+uint32_t pit_window;
 
 #endif /* ASM */
 #endif /* _PIT_H */
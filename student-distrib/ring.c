@@ -0,0 +1,183 @@
+/**
+ *  ring.c - batched syscall submission ring
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: io_uring design notes
+ */
+
+#include "ring.h"
+#include "syscalls.h"
+
+// File-scope helper functions
+// Helper function to run queued entries
+static int32_t ring_drain(ring_t* ring, uint32_t to_submit, uint8_t nonblock);
+
+// Helper function to tell if an entry could wait on a device
+static int32_t ring_may_block(const ring_sqe_t* sqe);
+
+/* Function: sys_ring_setup
+ * Description: Register a submission/completion ring for the current
+ *              process. The ring stays in the program page, so the
+ *              program fills it without a trap. NULL unregisters it.
+ * Inputs: ring - ring in the program page, flags - RING_F_* flags
+ * Outputs: 0 - success, -1 - failed
+ * Side Effects: queue indexes of the ring are reset
+ */
+int32_t sys_ring_setup(ring_t* ring, uint32_t flags)
+{
+    if (ring == NULL)
+    {
+        pcb->ring = NULL;
+        pcb->work_pending &= ~WORK_RING;
+        return 0;
+    }
+
+    // Whole ring must be inside the program page
+    if (((uint32_t) ring < PROGRAM_PAGE_ADDR) || ((uint32_t) (ring + 1) > PROGRAM_STACK_ADDR))
+    {
+        printf("<!> Ring address 0x%#x is not valid.\n", (uint32_t) ring);
+        error_sound();
+        return -1;
+    }
+
+    ring->sq_head = 0;
+    ring->sq_tail = 0;
+    ring->cq_head = 0;
+    ring->cq_tail = 0;
+    pcb->ring = ring;
+    pcb->ring_flags = flags;
+    return 0;
+}
+
+/* Function: sys_ring_enter
+ * Description: Run submitted entries of the current process in order,
+ *              a whole batch costs this one trap.
+ * Inputs: to_submit - maximum entries to run, 0 for all of them
+ * Outputs: number of entries run, -1 if no ring is registered
+ * Side Effects: completions are posted to the completion queue
+ */
+int32_t sys_ring_enter(uint32_t to_submit)
+{
+    if (pcb->ring == NULL)
+    {
+        printf("<!> No ring is registered for this program.\n");
+        error_sound();
+        return -1;
+    }
+
+    // Entries may wait for devices
+    sti();
+    pcb->work_pending &= ~WORK_RING;
+    return ring_drain(pcb->ring, to_submit, 0);
+}
+
+/* Function: ring_tick
+ * Description: Called on the scheduler tick. If the process asked for
+ *              RING_F_TICK and has queued entries, mark ring work so it
+ *              is drained on its next return to user space.
+ * Inputs: pcb - process to check
+ * Outputs: none
+ * Side Effects: may set WORK_RING in work_pending
+ */
+void ring_tick(struct pcb_t* pcb)
+{
+    if ((pcb == NULL) || (pcb->ring == NULL) || !(pcb->ring_flags & RING_F_TICK))
+    {
+        return;
+    }
+    if (pcb->ring->sq_head != pcb->ring->sq_tail)
+    {
+        pcb->work_pending |= WORK_RING;
+    }
+}
+
+/* Function: ring_exit_work
+ * Description: Called by the linkage slow path on the way back to user
+ *              space. Interrupts are off here, so only entries that will
+ *              not wait on a device are run, the rest wait for enter.
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: clear WORK_RING, completions may be posted
+ */
+void ring_exit_work(void)
+{
+    if (!(pcb->work_pending & WORK_RING))
+    {
+        return;
+    }
+    pcb->work_pending &= ~WORK_RING;
+    if (pcb->ring != NULL)
+    {
+        ring_drain(pcb->ring, 0, 1);
+    }
+}
+
+/* Function: ring_drain
+ * Description: Run queued entries until the submission queue is empty,
+ *              the completion queue is full, or to_submit entries ran.
+ * Inputs: ring - ring of the current process
+ *         to_submit - maximum entries to run, 0 for all of them
+ *         nonblock - stop at the first entry which may wait on a device
+ * Outputs: number of entries run
+ * Side Effects: completions are posted to the completion queue
+ */
+static int32_t ring_drain(ring_t* ring, uint32_t to_submit, uint8_t nonblock)
+{
+    int32_t done = 0;
+    ring_sqe_t sqe;
+    ring_cqe_t* cqe;
+
+    while ((ring->sq_head != ring->sq_tail) && ((ring->cq_tail - ring->cq_head) < RING_ENTRIES))
+    {
+        // Copy the entry first, the program may reuse the slot at any time
+        sqe = ring->sqes[ring->sq_head & RING_MASK];
+        if (nonblock && ring_may_block(&sqe))
+        {
+            break;
+        }
+        ring->sq_head++;
+
+        cqe = &(ring->cqes[ring->cq_tail & RING_MASK]);
+        cqe->user_data = sqe.user_data;
+        cqe->res = syscall_ring_dispatch(sqe.callnum, sqe.args[0], sqe.args[1], sqe.args[2]);
+        ring->cq_tail++;
+
+        if ((uint32_t) ++done == to_submit)
+        {
+            break;
+        }
+    }
+    return done;
+}
+
+/* Function: ring_may_block
+ * Description: Reads from the RTC and the terminal wait for interrupts,
+ *              reads and writes on a pipe wait for the other end.
+ *              Terminal and pipe FDs with O_NONBLOCK never wait.
+ * Inputs: sqe - entry to check
+ * Outputs: 1 - may wait, 0 - will not wait
+ * Side Effects: none
+ */
+static int32_t ring_may_block(const ring_sqe_t* sqe)
+{
+    uint32_t fd = sqe->args[0];
+    uint32_t flags, nonblock;
+
+    if (fd >= FD_COUNT)
+    {
+        return 0;
+    }
+    flags = (pcb->file_descriptor)[fd].flags;
+    nonblock = (pcb->file_descriptor)[fd].status & O_NONBLOCK;
+    switch (sqe->callnum)
+    {
+        case SYS_READ:
+        case SYS_READV:
+            return ((flags == FD_FLAG_RTC) || (!nonblock && ((flags == FD_FLAG_TERMINAL) || (flags == FD_FLAG_PIPE))));
+        case SYS_WRITE:
+        case SYS_WRITEV:
+            return (!nonblock && (flags == FD_FLAG_PIPE));
+        default:
+            return 0;
+    }
+}
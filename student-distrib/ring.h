@@ -0,0 +1,67 @@
+/**
+ *  ring.h - batched syscall submission ring
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources:
+ */
+
+#ifndef _RING_H
+#define _RING_H
+
+// Entries in each queue, must be power of 2
+#define RING_ENTRIES 32
+#define RING_MASK (RING_ENTRIES - 1)
+
+// Ring setup flags
+#define RING_F_TICK 0x1     // Also drain non-blocking entries on return to user
+
+#include "types.h"
+
+#ifndef ASM
+
+#include "lib.h"
+
+// Submission queue entry, args are passed as EBX, ECX, EDX of the syscall
+typedef struct ring_sqe_t
+{
+    uint32_t callnum;                   // Syscall #
+    uint32_t args[3];                   // Syscall Arguments
+    uint32_t user_data;                 // Copied to the completion
+} ring_sqe_t;
+
+// Completion queue entry
+typedef struct ring_cqe_t
+{
+    uint32_t user_data;                 // From the submission
+    int32_t res;                        // Syscall Return Value
+} ring_cqe_t;
+
+// Ring shared with the program, lives in the program page.
+// The program owns sq_tail and cq_head, the kernel owns sq_head and cq_tail.
+typedef struct ring_t
+{
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    ring_sqe_t sqes[RING_ENTRIES];
+    ring_cqe_t cqes[RING_ENTRIES];
+} ring_t;
+
+// PCB is defined in signals.h, which includes this file indirectly
+struct pcb_t;
+
+// Register a ring for the current process
+extern int32_t sys_ring_setup(ring_t* ring, uint32_t flags);
+
+// Run submitted entries of the current process
+extern int32_t sys_ring_enter(uint32_t to_submit);
+
+// Mark ring work for a process on the scheduler tick
+extern void ring_tick(struct pcb_t* pcb);
+
+// Drain non-blocking entries on the way back to user space
+extern void ring_exit_work(void);
+
+#endif /* ASM */
+#endif /* _RING_H */
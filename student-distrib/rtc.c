@@ -10,51 +10,103 @@
 /* File-scope variables */
 static int open = 0;
 
+// Woken when vrtc_ticks reaches rtc_next_due
+static wait_queue_t rtc_wq;
+static uint32_t rtc_next_due;
+
+// TSC of the last wake up, and the wake up latency summed over samples
+static uint32_t rtc_wake_tsc = 0;
+static uint32_t rtc_latency_sum = 0;
+static uint32_t rtc_latency_samples = 0;
+
+/* File-scope helper functions */
+// Helper function to start the period of a FD if it has none
+static uint32_t rtc_arm(file_desc_t* fde);
+
+// Bottom half of the RTC interrupt
+static void rtc_tasklet_handle(uint32_t data);
+static tasklet_t rtc_tasklet = { NULL, rtc_tasklet_handle, 0, 0 };
+
 /* 
  * rtc_handle
  *   DESCRIPTION: Handler to handle RTC interrupts.
- *   INPUTS: none
+ *   INPUTS: ctx - ignored
  *   OUTPUTS: none
  *   RETURN VALUE: none
  *   SIDE EFFECTS: RTC interrupt will be received and EOI
- *                 will be send. Decrease the VRTC counters.
+ *                 will be send. Advance the VRTC time, and
+ *                 queue the tasklet if a sleeper or an alarm
+ *                 is due.
  */
-void rtc_handle()
+void rtc_handle(void* ctx)
 {
+    int i;
+
     // Receive the data
     outb(0x0C, RTC_IO_0);
     inb(RTC_IO_1);
 
-    // Decrease the VRTC counters
-    if (vrtc_counter[0] > 0) { vrtc_counter[0] = vrtc_counter[0] - RTC_FACTOR; }
-    if (vrtc_counter[1] > 0) { vrtc_counter[1] = vrtc_counter[1] - RTC_FACTOR; }
-    if (vrtc_counter[2] > 0) { vrtc_counter[2] = vrtc_counter[2] - RTC_FACTOR; }
+    // Advance VRTC time
+    vrtc_ticks += VRTC_TICK_STEP;
 
-    // Increase all alarm counters and ensure multitaskibility
-    vrtc_alarm[0] += RTC_FACTOR;
-    vrtc_alarm[1] += RTC_FACTOR;
-    vrtc_alarm[2] += RTC_FACTOR;
+    // Send EOI
+    send_eoi(RTC_IRQ);
 
-    // Send alarm signal
-    if (vrtc_alarm[0] >= RTC_ALARM_THERSHOLD)
+    // Most ticks have nothing due, skip the tasklet then
+    if (rtc_wq.pid_mask && rtc_timer_due(rtc_next_due))
     {
-        vrtc_alarm[0] = 0;
-        sig_set(terminals[0].pcb, ALARM);
+        tasklet_schedule(&rtc_tasklet);
+        return;
     }
-    if (vrtc_alarm[1] >= RTC_ALARM_THERSHOLD)
+    for (i = 0; i < TERMINAL_COUNT; i++)
     {
-        vrtc_alarm[1] = 0;
-        sig_set(terminals[1].pcb, ALARM);
+        if ((vrtc_ticks - vrtc_alarm[i]) >= RTC_ALARM_TICKS)
+        {
+            tasklet_schedule(&rtc_tasklet);
+            break;
+        }
     }
-    if (vrtc_alarm[2] >= RTC_ALARM_THERSHOLD)
+    return;
+}
+
+/* 
+ * rtc_tasklet_handle
+ *   DESCRIPTION: Bottom half of the RTC interrupt.
+ *   INPUTS: data - ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Wake sleepers whose earliest deadline passed,
+ *                 and switch to them at the interrupt exit.
+ *                 Send alarm signals which are due.
+ */
+static void rtc_tasklet_handle(uint32_t data)
+{
+    int i;
+    uint32_t flags;
+
+    // Sleepers and signals are also changed by syscalls
+    cli_and_save(flags);
+    // RTC sleepers wait for a deadline, let them run before the next tick
+    if (rtc_wq.pid_mask && rtc_timer_due(rtc_next_due))
     {
-        vrtc_alarm[2] = 0;
-        sig_set(terminals[2].pcb, ALARM);
+        rtc_wake_tsc = rdtsc_low();
+        wake_up_preempt(&rtc_wq);
     }
 
-    // Send EOI
-    send_eoi(RTC_IRQ);
-    return;
+    // Send alarm signal, every terminal keeps its own period.
+    // Terminals without a shell only move their period along.
+    for (i = 0; i < TERMINAL_COUNT; i++)
+    {
+        if ((vrtc_ticks - vrtc_alarm[i]) >= RTC_ALARM_TICKS)
+        {
+            vrtc_alarm[i] = vrtc_ticks;
+            if (terminals[i].initialized)
+            {
+                sig_set(terminals[i].pcb, ALARM);
+            }
+        }
+    }
+    restore_flags(flags);
 }
 
 /* 
@@ -83,10 +135,8 @@ int32_t rtc_open(const uint8_t* filename)
     outb(prev | 0x40, RTC_IO_1);
     open = 1;
 
-    // Reset all VRTC counters as we adapt multiterminal
-    vrtc_counter[0] = 0;
-    vrtc_counter[1] = 0;
-    vrtc_counter[2] = 0;
+    // Reset VRTC time, every FD keeps its own deadline in it
+    vrtc_ticks = 0;
 
     // We will use the default frequency, 1024Hz. No further initialization necessary.
     char freq_rate = 6;
@@ -101,11 +151,15 @@ int32_t rtc_open(const uint8_t* filename)
 
 /* 
  * rtc_read
- *   DESCRIPTION: Spin until next RTC interrupt.
- *   INPUTS: fd - VRTC frequency, others - ignored
+ *   DESCRIPTION: Sleep until the current period of the FD ends.
+ *                Periods follow each other, so a program reading
+ *                in a loop runs at the VRTC frequency.
+ *   INPUTS: fd - FD index, its inode holds the VRTC frequency,
+ *                its file_position the end of the current period
+ *           others - ignored
  *   OUTPUTS: none
  *   RETURN VALUE: 0 - success, -1 - failed
- *   SIDE EFFECTS: Will spin and wait for next interrupt.
+ *   SIDE EFFECTS: Other processes run while sleeping.
  */
 int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes)
 {
@@ -116,13 +170,46 @@ int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes)
         return -1;
     }
 
-    // Set VRTC counter
-    vrtc_counter[pcb->terminal_id] = 1024 / fd;
+    file_desc_t* fde = &((pcb->file_descriptor)[fd]);
+    uint32_t period = VRTC_TICKS_PER_SEC / fde->inode;
+    uint32_t deadline, latency;
+    uint8_t slept = 0;
 
-    // Spin while waiting for interrupt
-    while (vrtc_counter[pcb->terminal_id] > 0);
+    cli();
+    deadline = rtc_arm(fde);
+    while (!rtc_timer_due(deadline))
+    {
+        rtc_timer_wait(deadline);
+        proc_block();
+        slept = 1;
+    }
+
+    // Time from the wake up until running again, summed like IRQ stats
+    if (slept)
+    {
+        latency = rdtsc_low() - rtc_wake_tsc;
+        if (latency > rtc_latency_max)
+        {
+            rtc_latency_max = latency;
+        }
+        if (rtc_latency_sum + latency < rtc_latency_sum)
+        {
+            rtc_latency_sum >>= 1;
+            rtc_latency_samples >>= 1;
+        }
+        rtc_latency_sum += latency;
+        rtc_latency_samples++;
+    }
+
+    // Next period starts here, or now if a whole period was missed
+    deadline += period;
+    if (rtc_timer_due(deadline))
+    {
+        deadline = vrtc_ticks + period;
+    }
+    fde->file_position = deadline;
+    sti();
 
-    // Return when VRTC counter is reset
     return 0;
 }
 
@@ -130,8 +217,9 @@ int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes)
  * rtc_write
  *   DESCRIPTION: As with the implementation of VRTC, this function
  *                no longer changes the RTC frequency. Instead,
- *                it will do a sanity check on the incoming new frequency.
- *   INPUTS: fd, nbytes - ignored
+ *                it will do a sanity check on the incoming new frequency
+ *                and keep it in the inode of the FD.
+ *   INPUTS: fd - FD index, nbytes - ignored
  *           buf - pointer to an int variable,
  *                 containing a new frequency.
  *                 Should be power of 2 and <= 1024 Hz.
@@ -173,9 +261,121 @@ int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes)
         return -1;
     }
 
+    // Keep the new frequency in the FD for rtc_read, restart the period
+    (pcb->file_descriptor)[fd].inode = new_freq;
+    (pcb->file_descriptor)[fd].file_position = 0;
     return 0;
 }
 
+/* 
+ * rtc_poll
+ *   DESCRIPTION: Poll entry of the RTC. Readable once the current
+ *                period of the FD ends, the same time rtc_read
+ *                would return.
+ *   INPUTS: fd - FD index
+ *           wait - join the RTC wait queue until the period ends
+ *   OUTPUTS: none
+ *   RETURN VALUE: POLLOUT, and POLLIN if the period has ended
+ *   SIDE EFFECTS: starts a period if the FD has none
+ */
+int32_t rtc_poll(int32_t fd, uint8_t wait)
+{
+    uint32_t deadline = rtc_arm(&((pcb->file_descriptor)[fd]));
+
+    if (rtc_timer_due(deadline))
+    {
+        return POLLIN | POLLOUT;
+    }
+    if (wait)
+    {
+        rtc_timer_wait(deadline);
+    }
+    return POLLOUT;
+}
+
+/* 
+ * rtc_latency_avg
+ *   DESCRIPTION: Average time from waking a sleeper in rtc_read()
+ *                until it runs again.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: TSC cycles, 0 if no sleeper was woken yet
+ *   SIDE EFFECTS: none
+ */
+uint32_t rtc_latency_avg(void)
+{
+    return rtc_latency_samples ? (rtc_latency_sum / rtc_latency_samples) : 0;
+}
+
+/* 
+ * rtc_timer_wait
+ *   DESCRIPTION: Join the RTC wait queue, which is woken once
+ *                vrtc_ticks reaches the earliest deadline of its
+ *                sleepers. Also used for poll timeouts.
+ *   INPUTS: deadline - VRTC time to wake at
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: call with interrupts off, then proc_block()
+ */
+void rtc_timer_wait(uint32_t deadline)
+{
+    if (!rtc_wq.pid_mask || ((int32_t) (deadline - rtc_next_due) < 0))
+    {
+        rtc_next_due = deadline;
+    }
+    poll_wait(&rtc_wq);
+}
+
+/* 
+ * rtc_timer_due
+ *   DESCRIPTION: Compare with VRTC time, safe across wrap around.
+ *   INPUTS: deadline - VRTC time
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 - reached, 0 - not yet
+ *   SIDE EFFECTS: none
+ */
+int32_t rtc_timer_due(uint32_t deadline)
+{
+    return ((int32_t) (vrtc_ticks - deadline) >= 0);
+}
+
+/* 
+ * rtc_deadline
+ *   DESCRIPTION: Turn a timeout into VRTC time, for poll and
+ *                terminal reads. Clamped to VRTC_TIMEOUT_MAX so
+ *                rtc_timer_due() stays correct.
+ *   INPUTS: ms - timeout in ms
+ *   OUTPUTS: none
+ *   RETURN VALUE: VRTC time ms from now
+ *   SIDE EFFECTS: none
+ */
+uint32_t rtc_deadline(uint32_t ms)
+{
+    if (ms > VRTC_TIMEOUT_MAX)
+    {
+        ms = VRTC_TIMEOUT_MAX;
+    }
+    return vrtc_ticks + ms * VRTC_TICKS_PER_SEC / 1000;
+}
+
+/* 
+ * rtc_arm
+ *   DESCRIPTION: Start a period of the FD from now if it has none,
+ *                file_position 0 means no period is running.
+ *   INPUTS: fde - RTC FD entry
+ *   OUTPUTS: none
+ *   RETURN VALUE: end of the current period
+ *   SIDE EFFECTS: none
+ */
+static uint32_t rtc_arm(file_desc_t* fde)
+{
+    if (fde->file_position == 0)
+    {
+        fde->file_position = vrtc_ticks + VRTC_TICKS_PER_SEC / fde->inode;
+    }
+    return (uint32_t) fde->file_position;
+}
+
 /* 
  * rtc_write
  *   DESCRIPTION: Do nothing.
@@ -17,6 +17,16 @@
 #define RTC_FACTOR 1.75
 #define RTC_ALARM_THERSHOLD 10240
 
+// VRTC ticks are counted in quarters, so RTC_FACTOR adds up exactly
+#define VRTC_TICK_SCALE 4
+#define VRTC_TICK_STEP ((uint32_t) (RTC_FACTOR * VRTC_TICK_SCALE))
+#define VRTC_TICKS_PER_SEC (1024 * VRTC_TICK_SCALE)
+
+// Alarm period in VRTC ticks, RTC_ALARM_THERSHOLD counted in RTC_FACTOR steps
+#define RTC_ALARM_TICKS (RTC_ALARM_THERSHOLD * VRTC_TICK_SCALE)
+
+// Longest timeout in ms, deadlines must stay within half the tick range
+#define VRTC_TIMEOUT_MAX 500000
 
 #include "types.h"
 #include "i8259.h"
@@ -27,21 +37,39 @@
 
 #include "lib.h"
 
-// VRTC Counter for each terminal
-float vrtc_counter[3];
+// VRTC ticks since boot, in 1/VRTC_TICK_SCALE of a 1024 Hz tick
+volatile uint32_t vrtc_ticks;
 
-// VRTC Counter for alarm signal
-float vrtc_alarm[3];
+// VRTC time each terminal last got an alarm signal
+uint32_t vrtc_alarm[TERMINAL_COUNT];
+
+// Longest time from waking a sleeper in rtc_read() until it runs, TSC cycles
+uint32_t rtc_latency_max;
 
 // Handler to handle RTC interrupts.
-extern void rtc_handle();
+extern void rtc_handle(void* ctx);
 
 // Initialize and enable RTC interrupts, set frequency to 2 Hz.
 extern int32_t rtc_open(const uint8_t* filename);
 
-// Spin until next RTC interrupt.
+// Sleep until the next period of the VRTC frequency of the FD.
 extern int32_t rtc_read(int32_t fd, void* buf, int32_t nbytes);
 
+// Readable when the period of the FD has passed.
+extern int32_t rtc_poll(int32_t fd, uint8_t wait);
+
+// Join the RTC wait queue until vrtc_ticks reaches deadline.
+extern void rtc_timer_wait(uint32_t deadline);
+
+// Tell if vrtc_ticks has reached deadline.
+extern int32_t rtc_timer_due(uint32_t deadline);
+
+// VRTC time ms from now, for timeouts.
+extern uint32_t rtc_deadline(uint32_t ms);
+
+// Average time from waking a sleeper in rtc_read() until it runs.
+extern uint32_t rtc_latency_avg(void);
+
 // Change RTC frequency.
 extern int32_t rtc_write(int32_t fd, const void* buf, int32_t nbytes);
 
@@ -6,41 +6,186 @@
  */
 
 #include "scheduler.h"
+#include "scrollback.h"
+#include "vidbuf.h"
+#include "vbe.h"
+#include "palloc.h"
+#include "terminal.h"
 
 // Initialize global variable
 char* video_mem = (char *) VIDEO_MEM_ADDR;
+char* vram_active = (char *) VIDEO_MEM_ADDR;
 uint8_t scheduler_enable = 0;
 
+// Switch asked for by resched_terminal() and resched_process()
+static unsigned int resched_target = 0;
+static int resched_pid = -1;
+
+// Terminal whose view maps each VRAM page for terminals, -1 if none,
+// and a count of switches to order terminals by when they were shown
+static int32_t slot_owner[VIDEO_SLOT_COUNT];
+static uint32_t shown_clock = 0;
+
+// Stands in for the parent of a base shell while it starts
+static pcb_t terminal_seed;
+
 /* void switchEnvironmentInit()
  * Inputs: none
  * Return Value: none
- * Function: initialize scheduler environment
+ * Function: initialize scheduler environment, only the first terminal
+ * is created
  */
 extern void switchEnvironmentInit()
 {
-    terminals[0].video_backup_addr = (void*) VIDEO_BACKUP_ADDR0;
-    terminals[0].video_backup_page = VIDEO_BACKUP_PAGE0;
-    terminals[0].initialized = 0;
-    terminals[0].screen_x = 0;
-    terminals[0].screen_y = 0;
-    terminals[0].echo = 0;
-    terminals[0].vidmap = 0;
-    
-    terminals[1].video_backup_addr = (void*) VIDEO_BACKUP_ADDR1;
-    terminals[1].video_backup_page = VIDEO_BACKUP_PAGE1;
-    terminals[1].initialized = 0;
-    terminals[1].screen_x = 0;
-    terminals[1].screen_y = 0;
-    terminals[1].echo = 0;
-    terminals[1].vidmap = 0;
-
-    terminals[2].video_backup_addr = (void*) VIDEO_BACKUP_ADDR2;
-    terminals[2].video_backup_page = VIDEO_BACKUP_PAGE2;
-    terminals[2].initialized = 0;
-    terminals[2].screen_x = 0;
-    terminals[2].screen_y = 0;
-    terminals[2].echo = 0;
-    terminals[2].vidmap = 0;
+    unsigned int tid;
+
+    for (tid = 0; tid < TERMINAL_COUNT; tid++)
+    {
+        terminals[tid].video_addr = (void*) VIDEO_PAGE_ADDR(tid);
+        terminals[tid].video_page = VIDEO_PAGE(tid);
+        terminals[tid].initialized = 0;
+        terminals[tid].created = 0;
+        terminals[tid].video_ram = NULL;
+        terminals[tid].shown_at = 0;
+        terminals[tid].screen_x = 0;
+        terminals[tid].screen_y = 0;
+        terminals[tid].echo = 0;
+        terminals[tid].mode = TERM_COOKED;
+        terminals[tid].vidmap = 0;
+        terminals[tid].vidbuf = 0;
+        terminals[tid].fbmap = 0;
+        ansi_reset(&terminals[tid].ansi);
+    }
+    for (tid = 0; tid < VIDEO_SLOT_COUNT; tid++)
+    {
+        slot_owner[tid] = -1;
+    }
+
+    // The first terminal takes over the boot messages in the first VRAM page
+    if (terminal_create(0) == -1)
+    {
+        printf("switchEnvironmentInit: No memory for terminal 0.\n");
+        return;
+    }
+    memcpy(terminals[0].video_addr, (void*) VIDEO_MEM_ADDR, VIDEO_MEM_BYTES);
+    terminals[0].screen_x = screen_x;
+    terminals[0].screen_y = screen_y;
+    (void) video_slot_get(0);
+    video_mem = (char*) terminals[0].video_addr;
+    set_display_page(video_mem);
+}
+
+/* int32_t terminal_create(unsigned int terminal_id)
+ * Inputs: terminal_id - terminal ID
+ * Return Value: 0 on success, -1 if there is no memory
+ * Function: allocate the view page, line ring, input ring and history
+ * of a terminal on its first switch, nothing if it has them already
+ */
+int32_t terminal_create(unsigned int terminal_id)
+{
+    terminal_t* term = &terminals[terminal_id];
+
+    if (term->created)
+    {
+        return 0;
+    }
+
+    // The view maps its RAM page until the terminal is shown
+    if (term->video_ram == NULL)
+    {
+        if ((term->video_ram = page_alloc(1)) == NULL)
+        {
+            return -1;
+        }
+        pageTableLow[term->video_page].P = 1;
+        pageTableLow[term->video_page].physicalAddress = ((uint32_t) term->video_ram) >> 12;
+        flushTLB();
+    }
+
+    // A later switch retries what is still missing
+    if (screen_ring_alloc(terminal_id) == -1 || terminal_input_alloc(terminal_id) == -1 ||
+        scrollback_alloc(terminal_id) == -1)
+    {
+        return -1;
+    }
+    term->created = 1;
+    return 0;
+}
+
+/* int32_t video_slot_get(unsigned int terminal_id)
+ * Inputs: terminal_id - terminal ID, created
+ * Return Value: 0
+ * Function: map the view of a terminal to a VRAM page so it can be
+ * shown. A free page is taken, or the one of the terminal shown least
+ * recently, whose view maps its RAM page again.
+ */
+int32_t video_slot_get(unsigned int terminal_id)
+{
+    terminal_t* term = &terminals[terminal_id];
+    terminal_t* victim;
+    uint32_t page = pageTableLow[term->video_page].physicalAddress;
+    int32_t slot, i;
+
+    term->shown_at = ++shown_clock;
+    if (page >= VIDEO_MEM_PAGE && page < VIDEO_MEM_PAGE + VIDEO_SLOT_COUNT)
+    {
+        return 0;
+    }
+
+    slot = 0;
+    for (i = 0; i < VIDEO_SLOT_COUNT; i++)
+    {
+        if (slot_owner[i] == -1)
+        {
+            slot = i;
+            break;
+        }
+        if (terminals[slot_owner[i]].shown_at < terminals[slot_owner[slot]].shown_at)
+        {
+            slot = i;
+        }
+    }
+
+    // VRAM is not decoded while a framebuffer is shown
+    vbe_show(0);
+
+    if (slot_owner[slot] != -1)
+    {
+        victim = &terminals[slot_owner[slot]];
+        memcpy(victim->video_ram, victim->video_addr, VIDEO_MEM_BYTES);
+        pageTableLow[victim->video_page].physicalAddress = ((uint32_t) victim->video_ram) >> 12;
+    }
+    memcpy((void*) (VIDEO_MEM_ADDR + slot * VIDEO_MEM_BYTES), term->video_ram, VIDEO_MEM_BYTES);
+    pageTableLow[term->video_page].physicalAddress = VIDEO_MEM_PAGE + slot;
+    slot_owner[slot] = terminal_id;
+
+    // The vidmap of the running process may map either page
+    if (pcb != NULL)
+    {
+        pageTableHigh[0].physicalAddress = vidbuf_page(pcb->terminal_id);
+    }
+    flushTLB();
+    return 0;
+}
+
+/* unsigned int terminal_next(unsigned int terminal_id)
+ * Inputs: terminal_id - terminal ID
+ * Return Value: next terminal with a shell in round robin order, the
+ * same terminal if there is no other
+ * Function: pick the terminal the PIT and sys_yield switch to
+ */
+unsigned int terminal_next(unsigned int terminal_id)
+{
+    unsigned int tid;
+
+    for (tid = (terminal_id + 1) % TERMINAL_COUNT; tid != terminal_id; tid = (tid + 1) % TERMINAL_COUNT)
+    {
+        if (terminals[tid].initialized)
+        {
+            return tid;
+        }
+    }
+    return terminal_id;
 }
 
 /* void switchTerminalInit(unsigned int terminal_id)
@@ -56,53 +201,151 @@ void switchTerminalInit(unsigned int terminal_id)
         return;
     }
 
-    progress = 1;
+    uint32_t flags;
+    spin_lock_irqsave(&pcb_lock, flags);
 
-    pcb = (pcb_t*) (KERNEL_STACK_ADDR - (terminal_id + 1) * KERNEL_STACK_OFFSET);
+    // The shell takes any free PID, the seed is not in the PCB pool
+    pcb = &terminal_seed;
+    pcb->work_pending = 0;
+    pcb->process_id = 0;
     pcb->terminal_id = terminal_id;
-    pcb->previous_id = terminal_id;
+    pcb->previous_id = 0;
 
     terminals[terminal_id].initialized = 1;
     terminals[terminal_id].pcb = pcb;
 
-    progress = 0;
+    spin_unlock_irqrestore(&pcb_lock, flags);
 
     sys_execute((uint8_t*)("shell"));
 }
 
-/* void switchVidMem(unsigned int terminal_id)
+/* int32_t switchVidMem(unsigned int terminal_id)
  * Inputs: terminal_id - terminal ID
- * Return Value: none
- * Function: switch visible video memory page
+ * Return Value: 0 on success, -1 if the terminal could not be created
+ * Function: show the view of a terminal, a CRTC start address write
+ * while it has a VRAM page, a page swap otherwise
  */
-void switchVidMem(unsigned int terminal_id)
+int32_t switchVidMem(unsigned int terminal_id)
 {
+    uint32_t start = rdtsc_low();
+    uint32_t flags;
+
     if (terminal_id >= TERMINAL_COUNT)
     {
         printf("switchVidMem: Illegal terminal # specified: %d. Returning.", terminal_id);
-        return;
+        return -1;
     }
 
-    progress = 1;
+    // Called by the keyboard tasklet
+    if (terminal_create(terminal_id) == -1)
+    {
+        printf("<!> No memory for terminal %u.\n", terminal_id);
+        return -1;
+    }
 
-    // Backup the current VRAM
-    memcpy(terminals[terminal_active].video_backup_addr, (void*) VIDEO_MEM_ADDR, VIDEO_MEM_BYTES);
+    // Show the page with the rows still in its ring
+    scrollback_exit();
+    spin_lock_irqsave(&terminal_lock, flags);
+    (void) video_slot_get(terminal_id);
+    screen_flush_locked((char*) terminals[terminal_id].video_addr);
+    set_display_page((char*) terminals[terminal_id].video_addr);
+    switchCursor(terminal_id);
 
-    // Restore the backup
-    memcpy((void*) VIDEO_MEM_ADDR, terminals[terminal_id].video_backup_addr, VIDEO_MEM_BYTES);
+    // Change active terminal ID, a framebuffer is shown with its terminal
+    terminal_active = terminal_id;
+    vbe_follow(terminal_id);
+    spin_unlock_irqrestore(&terminal_lock, flags);
 
-    // Reset video memory and coordinates to VRAM if now writing to its backup space
-    if (video_mem == ((char *) (terminals[terminal_id].video_backup_addr)))
+    vidswitch_cycles = rdtsc_low() - start;
+    return 0;
+}
+
+/* void switchCursor(unsigned int terminal_id)
+ * Inputs: terminal_id - terminal ID, the one shown
+ * Return Value: none
+ * Function: put the cursor where the terminal writes next
+ */
+void switchCursor(unsigned int terminal_id)
+{
+    // The running process keeps the coordinates of its terminal
+    if (pcb != NULL && pcb->terminal_id == terminal_id)
     {
-        video_mem = (char *) VIDEO_MEM_ADDR;
-        pageTableHigh[0].physicalAddress = VIDEO_MEM_PAGE;
-        flushTLB();
+        set_cursor_loc(screen_x, screen_y);
     }
+    else
+    {
+        set_cursor_loc(terminals[terminal_id].screen_x, terminals[terminal_id].screen_y);
+    }
+}
 
-    // Change active terminal ID
-    terminal_active = terminal_id;
+/* void terminal_borrow(screen_save_t* save, char* page)
+ * Inputs: save - filled with the state to put back
+ *         page - view page to write and show instead, NULL for the
+ *                page of the active terminal
+ * Return Value: none
+ * Function: let a tasklet or exception handler printf on the active
+ * terminal whatever process runs. The lock is only held for the swap,
+ * printf takes it itself. The caller keeps preemption disabled until
+ * terminal_return().
+ */
+void terminal_borrow(screen_save_t* save, char* page)
+{
+    uint32_t flags;
 
-    progress = 0;
+    spin_lock_irqsave(&terminal_lock, flags);
+    save->video_mem = video_mem;
+    save->shown = vram_active;
+    save->screen_x = screen_x;
+    save->screen_y = screen_y;
+    if (page != NULL)
+    {
+        // The page keeps the coordinates, the caller clears it
+        save->terminal_id = -1;
+        video_mem = page;
+        vbe_show(0);
+        set_display_page(page);
+    }
+    else
+    {
+        save->terminal_id = terminal_active;
+        video_mem = (char *) terminals[terminal_active].video_addr;
+        if (pcb->terminal_id != terminal_active)
+        {
+            screen_x = terminals[terminal_active].screen_x;
+            screen_y = terminals[terminal_active].screen_y;
+        }
+    }
+    spin_unlock_irqrestore(&terminal_lock, flags);
+}
+
+/* void terminal_return(screen_save_t* save)
+ * Inputs: save - filled by terminal_borrow()
+ * Return Value: none
+ * Function: keep where the borrowed terminal was written to, point
+ * kernel output back and put the cursor of the terminal shown back
+ */
+void terminal_return(screen_save_t* save)
+{
+    uint32_t flags;
+
+    spin_lock_irqsave(&terminal_lock, flags);
+    if (save->terminal_id == -1)
+    {
+        set_display_page(save->shown);
+        vbe_follow(terminal_active);
+        screen_x = save->screen_x;
+        screen_y = save->screen_y;
+    }
+    else if (pcb->terminal_id != save->terminal_id)
+    {
+        terminals[save->terminal_id].screen_x = screen_x;
+        terminals[save->terminal_id].screen_y = screen_y;
+        screen_x = save->screen_x;
+        screen_y = save->screen_y;
+    }
+    video_mem = save->video_mem;
+    switchCursor(terminal_active);
+    spin_unlock_irqrestore(&terminal_lock, flags);
 }
 
 /* void switchContext(unsigned int terminal_id)
@@ -118,25 +361,22 @@ void switchContext(unsigned int terminal_id)
         return;
     }
 
+    // Terminals are created when first shown, this is only for safety
+    if (terminal_create(terminal_id) == -1)
+    {
+        return;
+    }
+
     // Save VRAM information
     int current_terminal = pcb->terminal_id;
+    uint32_t flags;
+    spin_lock_irqsave(&terminal_lock, flags);
     terminals[current_terminal].screen_x = screen_x;
     terminals[current_terminal].screen_y = screen_y;
 
     // Save current PCB
     terminals[current_terminal].pcb = pcb;
 
-    // Save current process context
-    uint32_t ebp, esp;
-    asm volatile (
-        "movl %%ebp, %0  \n"
-        "movl %%esp, %1  \n"
-        : "=r"(ebp), "=r"(esp)
-    );
-    terminals[current_terminal].ebp = ebp;
-    terminals[current_terminal].esp = esp;
-    terminals[current_terminal].tss_esp = tss.esp0;
-
     // Reset screen coordinates
     screen_x = terminals[terminal_id].screen_x;
     screen_y = terminals[terminal_id].screen_y;
@@ -151,45 +391,38 @@ void switchContext(unsigned int terminal_id)
         unMap4KBVidMemPage();
     }
 
-    // Switch current video ram
-    /*
-     *  We map the video_mem to actual VRAM if and only if the
-     *  target terminal ID matches the terminal ID of next process.
-     * 
-     *  Without scheduler, if the target terminal is not initialized,
-     *  we change the mapping anyway. Pending changes here. --PL
-     */
-    if ((scheduler_enable && terminals[terminal_id].initialized && (terminal_active == ((terminals[terminal_id].pcb)->terminal_id)))
-          || ((!scheduler_enable) && ((!terminals[terminal_id].initialized) || (terminal_active == ((terminals[terminal_id].pcb)->terminal_id)))))
+    // Same for the framebuffer
+    if (terminals[terminal_id].fbmap)
     {
-        // Next terminal is the active terminal, switch video memory to VRAM
-        video_mem = (char *) VIDEO_MEM_ADDR;
-        pageTableHigh[0].physicalAddress = VIDEO_MEM_PAGE;
-        set_cursor_loc(screen_x, screen_y);
+        mapFBPage();
     }
     else
     {
-        // Switch video memory to backup space.
-        video_mem = (char *) (terminals[terminal_id].video_backup_addr);
-        pageTableHigh[0].physicalAddress = terminals[terminal_id].video_backup_page;
+        unMapFBPage();
     }
+
+    // Switch current video ram to the page of the terminal, shown or not,
+    // the vidmap of a double buffered program maps its RAM page instead
+    video_mem = (char *) (terminals[terminal_id].video_addr);
+    pageTableHigh[0].physicalAddress = vidbuf_page(terminal_id);
+    if (video_mem == vram_active)
+    {
+        set_cursor_loc(screen_x, screen_y);
+    }
+    spin_unlock_irqrestore(&terminal_lock, flags);
     
     // Check if the target terminal is initialized
+    pcb_t* prev = pcb;
     if (!(terminals[terminal_id].initialized))
     {
         // Not initialized, initialize VRAM
         clear();
 
-        // Initialize the new terminal
-        switchTerminalInit(terminal_id);
+        // Initialize the new terminal below the frame of this process
+        switch_to_call(prev, switchTerminalInit, terminal_id);
     }
     else
     {
-        // Initialized, then we do the same thing in halt()...
-        // Give up the current stack frame
-        ebp = terminals[terminal_id].ebp;
-        esp = terminals[terminal_id].esp;
-
         // Reset PCB pointer
         pcb = terminals[terminal_id].pcb;
 
@@ -198,15 +431,10 @@ void switchContext(unsigned int terminal_id)
         flushTLB();
 
         // Relocate kernel stack
-        tss.esp0 = terminals[terminal_id].tss_esp;
+        tss.esp0 = pcb->tss_esp;
 
         // Do context switch
-        asm volatile (
-            "movl %0, %%ebp  \n"
-            "movl %1, %%esp  \n"
-            :
-            : "r"(ebp), "r"(esp)
-        );
+        switch_to(prev, pcb);
     }
 
     /*
@@ -214,6 +442,383 @@ void switchContext(unsigned int terminal_id)
      *  Even without going to the office hour, I designed the terminal_t, pcb_pool structure, and managed to figure out everything.
      *  Honestly I am so proud of my achievement. -- PL
      */
-    // Should not return back to here anymore
+    // Returns here once switched back to this terminal
     return;
 }
+
+/* pcb_t* proc_find_runnable(unsigned int terminal_id)
+ * Inputs: terminal_id - terminal ID
+ * Return Value: next process of the terminal which may run, NULL if none
+ * Function: round robin over the PCB pool after the current process,
+ *           the current process itself is never returned
+ */
+pcb_t* proc_find_runnable(unsigned int terminal_id)
+{
+    pcb_t* next;
+    int pid_i;
+
+    for (pid_i = 1; pid_i < MAX_PID_COUNT; pid_i++)
+    {
+        next = pcb_pool[(pcb->process_id + pid_i) % MAX_PID_COUNT];
+        if ((next != NULL) && (next != pcb) && (next->terminal_id == terminal_id)
+            && ((next->state == PROC_RUNNABLE) || (next->state == PROC_NEW)))
+        {
+            return next;
+        }
+    }
+    return NULL;
+}
+
+/* void proc_start_frame(pcb_t* p)
+ * Inputs: p - spawned process which never ran
+ * Return Value: none
+ * Function: build the kernel stack of p as if switch_to saved it, so
+ *           the first switch_to returns into an IRET to its program
+ */
+static void proc_start_frame(pcb_t* p)
+{
+    uint32_t* sp = (uint32_t*) p->tss_esp;
+
+    // IRET frame into the program
+    *(--sp) = USER_DS;
+    *(--sp) = PROGRAM_STACK_ADDR - 4;
+    *(--sp) = EFLAGS_IF | EFLAGS_RESERVED;
+    *(--sp) = USER_CS;
+    *(--sp) = p->start_eip;
+
+    // Return address and EBP, EBX, ESI, EDI popped by switch_to
+    *(--sp) = (uint32_t) switch_start_user;
+    *(--sp) = 0;
+    *(--sp) = 0;
+    *(--sp) = 0;
+    *(--sp) = 0;
+    p->ksp = (uint32_t) sp;
+}
+
+/* void proc_switch(pcb_t* next)
+ * Inputs: next - process of the current terminal to switch to
+ * Return Value: none
+ * Function: switch between the processes of one terminal, used when the
+ *           current one blocks or halts. Screen and video memory stay the
+ *           same, so only the PCB, program page and stacks change. Returns
+ *           when another process switches back to this one. Call with
+ *           interrupts off and no lock held.
+ */
+void proc_switch(pcb_t* next)
+{
+    pcb_t* prev = pcb;
+
+    // Reset PCB pointer and TI
+    pcb = next;
+    terminals[pcb->terminal_id].pcb = pcb;
+
+    // Remap Program Page
+    reMap4MBPage(pcb->process_id);
+
+    // Relocate kernel stack
+    tss.esp0 = pcb->tss_esp;
+
+    if (pcb->state == PROC_NEW)
+    {
+        // Spawned process has no context yet, IRET into the program on its own stack
+        pcb->state = PROC_RUNNABLE;
+        proc_start_frame(pcb);
+    }
+
+    switch_to(prev, pcb);
+}
+
+/* void proc_yield()
+ * Inputs: none
+ * Return Value: none
+ * Function: let another process of the current terminal run while the
+ *           current one waits on a device, returns at once if none
+ */
+void proc_yield()
+{
+    pcb_t* next;
+
+    cli();
+    next = proc_find_runnable(pcb->terminal_id);
+    if (next != NULL)
+    {
+        proc_switch(next);
+    }
+    sti();
+}
+
+/* void proc_exit()
+ * Inputs: none
+ * Return Value: none, never returns
+ * Function: switch away from a halted process whose parent cannot be
+ *           resumed yet. The PCB pool entry is held until then, so the
+ *           PID and kernel stack are not reused while still in use.
+ */
+void proc_exit()
+{
+    pcb_t* next;
+
+    cli();
+    pcb->state = PROC_ZOMBIE;
+
+    // Other terminals keep running while nothing here can
+    while ((next = proc_find_runnable(pcb->terminal_id)) == NULL)
+    {
+        sti();
+        asm volatile ("hlt");
+        cli();
+    }
+
+    pcb_pool[pcb->process_id] = NULL;
+    proc_switch(next);
+}
+
+/* void proc_wait_children()
+ * Inputs: none
+ * Return Value: none
+ * Function: called by halt, wait until every spawned child of the
+ *           current process has halted, so none of them is left with
+ *           a freed or reused parent PID. The last child to halt makes
+ *           the process runnable again. Call with interrupts off.
+ */
+void proc_wait_children()
+{
+    pcb_t* next;
+
+    while (pcb->children > 0)
+    {
+        pcb->state = PROC_REAPING;
+        next = proc_find_runnable(pcb->terminal_id);
+        if (next != NULL)
+        {
+            proc_switch(next);
+        }
+        else if (need_resched && (preempt_count == 0))
+        {
+            preempt_schedule();
+        }
+        else
+        {
+            sti();
+            asm volatile ("hlt");
+            cli();
+        }
+    }
+    pcb->state = PROC_RUNNABLE;
+}
+
+/* void sleep_on(wait_queue_t* wq)
+ * Inputs: wq - wait queue to sleep on
+ * Return Value: none
+ * Function: block the current process until wake_up() on the queue.
+ *           Call with interrupts off after checking the condition, so
+ *           the wake up cannot be lost. Returns with interrupts off.
+ */
+void sleep_on(wait_queue_t* wq)
+{
+    poll_wait(wq);
+    proc_block();
+}
+
+/* void poll_wait(wait_queue_t* wq)
+ * Inputs: wq - wait queue to join
+ * Return Value: none
+ * Function: join a wait queue, proc_block() sleeps until any joined
+ *           queue is woken. Used by poll to wait on several at once.
+ */
+void poll_wait(wait_queue_t* wq)
+{
+    wq->pid_mask |= (1 << pcb->process_id);
+}
+
+/* void proc_block()
+ * Inputs: none
+ * Return Value: none
+ * Function: block the current process until one of the wait queues it
+ *           joined is woken. Call with interrupts off, returns with
+ *           interrupts off.
+ */
+void proc_block()
+{
+    pcb_t* next;
+
+    pcb->state = PROC_BLOCKED;
+
+    while (pcb->state == PROC_BLOCKED)
+    {
+        next = proc_find_runnable(pcb->terminal_id);
+        if (next != NULL)
+        {
+            proc_switch(next);
+        }
+        else if (need_resched && (preempt_count == 0))
+        {
+            // Blocking is a safe point, other terminals go first
+            preempt_schedule();
+        }
+        else
+        {
+            sti();
+            asm volatile ("hlt");
+            cli();
+        }
+    }
+}
+
+/* void wake_up(wait_queue_t* wq)
+ * Inputs: wq - wait queue to wake
+ * Return Value: none
+ * Function: make every process sleeping on the queue runnable again
+ */
+void wake_up(wait_queue_t* wq)
+{
+    pcb_t* sleeper;
+    int pid_i;
+
+    for (pid_i = 0; pid_i < MAX_PID_COUNT; pid_i++)
+    {
+        sleeper = pcb_pool[pid_i];
+        if ((wq->pid_mask & (1 << pid_i)) && (sleeper != NULL) && (sleeper->state == PROC_BLOCKED))
+        {
+            sleeper->state = PROC_RUNNABLE;
+        }
+    }
+    wq->pid_mask = 0;
+}
+
+/* void wake_up_preempt(wait_queue_t* wq)
+ * Inputs: wq - wait queue to wake
+ * Return Value: none
+ * Function: wake_up() for sleepers which should not wait for the next
+ *           PIT tick or for the current process to block. The first
+ *           one woken runs at the next safe point.
+ */
+void wake_up_preempt(wait_queue_t* wq)
+{
+    pcb_t* sleeper;
+    int pid_i;
+
+    for (pid_i = 0; pid_i < MAX_PID_COUNT; pid_i++)
+    {
+        sleeper = pcb_pool[pid_i];
+        if ((wq->pid_mask & (1 << pid_i)) && (sleeper != NULL) && (sleeper->state == PROC_BLOCKED) && (sleeper != pcb))
+        {
+            resched_process(sleeper);
+            break;
+        }
+    }
+    wake_up(wq);
+}
+
+/* void resched_terminal(unsigned int terminal_id)
+ * Inputs: terminal_id - terminal to switch to
+ * Return Value: none
+ * Function: ask for a switch to the current process of a terminal at
+ *           the next safe point, a later request replaces this one
+ */
+void resched_terminal(unsigned int terminal_id)
+{
+    resched_target = terminal_id;
+    need_resched = 1;
+}
+
+/* void resched_process(pcb_t* next)
+ * Inputs: next - process to run
+ * Return Value: none
+ * Function: ask for a switch to a process at the next safe point. If it
+ *           is on another terminal, that terminal is switched to first.
+ *           Goes before a terminal asked by resched_terminal().
+ */
+void resched_process(pcb_t* next)
+{
+    resched_pid = next->process_id;
+    need_resched = 1;
+}
+
+/* void preempt_schedule()
+ * Inputs: none
+ * Return Value: none
+ * Function: do the switch asked for, if preemption is enabled. Called
+ *           at safe points with interrupts off. A process switched away
+ *           from comes back here, and checks what was asked meanwhile.
+ */
+void preempt_schedule()
+{
+    pcb_t* next;
+    unsigned int target;
+
+    while (need_resched && (preempt_count == 0) && (pcb != NULL))
+    {
+        need_resched = 0;
+        target = resched_target;
+        next = (resched_pid >= 0) ? pcb_pool[resched_pid] : NULL;
+        if ((next != NULL) && (next->terminal_id == pcb->terminal_id))
+        {
+            // Preempted process stays runnable, it runs once next blocks
+            resched_pid = -1;
+            if ((next != pcb) && ((next->state == PROC_RUNNABLE) || (next->state == PROC_NEW)))
+            {
+                proc_switch(next);
+            }
+            continue;
+        }
+        if (next != NULL)
+        {
+            // Its terminal first, the process is switched to from there
+            target = next->terminal_id;
+            need_resched = 1;
+        }
+        else
+        {
+            resched_pid = -1;
+        }
+        if (target != pcb->terminal_id)
+        {
+            switchContext(target);
+        }
+    }
+}
+
+/* void preempt_check_resched()
+ * Inputs: none
+ * Return Value: none
+ * Function: called once preemption is enabled again. Switches only in
+ *           process context with interrupts on, an interrupt handler
+ *           leaves it to the interrupt exit.
+ */
+void preempt_check_resched()
+{
+    uint32_t flags;
+
+    if (!need_resched || preempt_count)
+    {
+        return;
+    }
+    cli_and_save(flags);
+    if (flags & EFLAGS_IF)
+    {
+        preempt_schedule();
+    }
+    restore_flags(flags);
+}
+
+/* void cond_resched()
+ * Inputs: none
+ * Return Value: none
+ * Function: safe point for long kernel work with interrupts off. Lets
+ *           pending interrupts in for one instruction, then switches if
+ *           asked for. Does nothing while preemption is disabled.
+ */
+void cond_resched()
+{
+    uint32_t flags;
+
+    if (preempt_count || (pcb == NULL))
+    {
+        return;
+    }
+    cli_and_save(flags);
+    asm volatile ("sti; nop; cli" : : : "memory", "cc");
+    preempt_schedule();
+    restore_flags(flags);
+}
@@ -8,19 +8,36 @@
 #ifndef _SCHEDULER_H
 #define _SCHEDULER_H
 
-#define TERMINAL_COUNT 3
-
+// Most terminals, ALT+F1 to ALT+F12. Each one is created on its first
+// switch, build with -DTERMINAL_COUNT=3 to compare
+#ifndef TERMINAL_COUNT
+#define TERMINAL_COUNT 12
+#endif
+
+// Text mode memory has 8 pages at 0xB8000, the CRTC start address picks
+// the page shown. The kernel writes through a view page per terminal,
+// which maps one of the VIDEO_SLOT_COUNT VRAM pages for terminals, or
+// its RAM page once the least recently shown terminal gave that up.
+// The last two views show the history of a terminal and pman, they
+// keep the last two VRAM pages.
 #define VIDEO_MEM_BYTES 4096
 #define VIDEO_MEM_ADDR 0xB8000
-#define VIDEO_BACKUP_ADDR0 0xB9000
-#define VIDEO_BACKUP_ADDR1 0xBA000
-#define VIDEO_BACKUP_ADDR2 0xBB000
-#define VIDEO_BACKUP_ADDR_EXTRA 0xBC000
+#define VIDEO_SLOT_COUNT 6
+#define VIDEO_VIEW_ADDR 0xC0000
+#define VIDEO_VIEW_COUNT (TERMINAL_COUNT + 2)
+#define VIDEO_PAGE_ADDR(tid) (VIDEO_VIEW_ADDR + (tid) * VIDEO_MEM_BYTES)
+#define VIDEO_SCROLLBACK_ADDR VIDEO_PAGE_ADDR(TERMINAL_COUNT)
+#define VIDEO_BACKUP_ADDR_EXTRA VIDEO_PAGE_ADDR(TERMINAL_COUNT + 1)
+
+// Interrupt flag in EFLAGS, and bit 1 which is always set
+#define EFLAGS_IF 0x200
+#define EFLAGS_RESERVED 0x2
 
 #ifndef ASM
 
 #include "paging.h"
 #include "syscalls.h"
+#include "ansi.h"
 #include "lib.h"
 
 // Global Variables
@@ -29,44 +46,143 @@ char* video_mem;
 int screen_x;
 int screen_y;
 
+// Page the CRTC shows
+char* vram_active;
+
+// Cycles the last terminal switch took
+uint32_t vidswitch_cycles;
+
 // File structure for Terminal information
 typedef struct terminal_t
 {
     // Initialized once
-    void* video_backup_addr;
-    uint32_t video_backup_page;
+    void* video_addr;
+    uint32_t video_page;
     uint8_t initialized;
 
+    // Allocated on the first switch
+    uint8_t created;
+    void* video_ram;
+    uint32_t shown_at;
+
     // Saved on context switching
-    uint32_t ebp;
-    uint32_t esp;
-    uint32_t tss_esp;
     int screen_x;
     int screen_y;
 
     // Saved when necessary
     struct pcb_t* pcb;
     uint8_t echo;
+    uint8_t mode;
     uint8_t vidmap;
+    uint8_t vidbuf;
+    uint8_t fbmap;
+
+    // Escape sequence state of writes to the terminal
+    ansi_t ansi;
 } terminal_t;
 
 // Terminal table
-terminal_t terminals[3];
+terminal_t terminals[TERMINAL_COUNT];
 
 // Scheduler enable
 uint8_t scheduler_enable;
 
+// Where kernel output went before terminal_borrow(), and what was shown
+typedef struct screen_save_t
+{
+    char* video_mem;
+    char* shown;
+    int screen_x;
+    int screen_y;
+    int terminal_id;                    // Terminal borrowed, -1 for a page
+} screen_save_t;
+
+// Processes sleeping on an event, one bit per PID
+typedef struct wait_queue_t
+{
+    uint32_t pid_mask;
+} wait_queue_t;
+
 /* initialize environment */
 extern void switchEnvironmentInit();
 
 /* initialize the specified terminal */
 extern void switchTerminalInit(unsigned int terminal_id);
 
+/* allocate what a terminal needs on its first switch */
+extern int32_t terminal_create(unsigned int terminal_id);
+
+/* map the view of a terminal to a VRAM page */
+extern int32_t video_slot_get(unsigned int terminal_id);
+
+/* next terminal with a shell, for the PIT and yield */
+extern unsigned int terminal_next(unsigned int terminal_id);
+
 /* switch visible video memory page */
-extern void switchVidMem(unsigned int terminal_id);
+extern int32_t switchVidMem(unsigned int terminal_id);
+
+/* put the cursor where the terminal writes next */
+extern void switchCursor(unsigned int terminal_id);
+
+/* point kernel output at the active terminal or another page */
+extern void terminal_borrow(screen_save_t* save, char* page);
+
+/* point kernel output back where it was before terminal_borrow */
+extern void terminal_return(screen_save_t* save);
 
 /* handle context switch */
 extern void switchContext(unsigned int terminal_id);
 
+/* save prev on its kernel stack and continue next, see switch.S */
+extern void switch_to(struct pcb_t* prev, struct pcb_t* next);
+
+/* save prev like switch_to and call func(arg), which does not return */
+extern void switch_to_call(struct pcb_t* prev, void (*func)(uint32_t), uint32_t arg);
+
+/* first return address of a spawned process, IRET into its program */
+extern void switch_start_user();
+
+/* find another process of the terminal which may run */
+extern struct pcb_t* proc_find_runnable(unsigned int terminal_id);
+
+/* switch to another process of the current terminal */
+extern void proc_switch(struct pcb_t* next);
+
+/* let another process of the current terminal run, if any */
+extern void proc_yield();
+
+/* leave a halted process for good */
+extern void proc_exit();
+
+/* wait in halt until the spawned children have halted, call with interrupts off */
+extern void proc_wait_children();
+
+/* block until a wait queue joined before is woken, call with interrupts off */
+extern void proc_block();
+
+/* join a wait queue without blocking yet */
+extern void poll_wait(wait_queue_t* wq);
+
+/* sleep until the wait queue is woken, call with interrupts off */
+extern void sleep_on(wait_queue_t* wq);
+
+/* wake all processes sleeping on the wait queue */
+extern void wake_up(wait_queue_t* wq);
+
+/* wake the wait queue, the first sleeper runs at the next safe point */
+extern void wake_up_preempt(wait_queue_t* wq);
+
+/* switch to the process of a terminal at the next safe point */
+extern void resched_terminal(unsigned int terminal_id);
+
+/* switch to a process at the next safe point */
+extern void resched_process(struct pcb_t* next);
+
+/* do the switch asked for, call at a safe point with interrupts off */
+extern void preempt_schedule();
+
+/* safe point for long kernel work */
+extern void cond_resched();
+
 #endif /* ASM */
 #endif /* _SCHEDULER_H */
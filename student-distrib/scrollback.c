@@ -0,0 +1,188 @@
+/**
+ *  scrollback.c - Scrollback history of the terminals
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: 
+ */
+
+#include "scrollback.h"
+#include "palloc.h"
+#include "spinlock.h"
+
+// History of each terminal, allocated when the terminal is created
+static scrollback_t* scrollback_pool[TERMINAL_COUNT];
+
+// Terminal whose history is shown, and rows back from its live screen
+static uint32_t view_tid = 0;
+static uint32_t view_back = 0;
+
+// File-scope helper functions
+static void scrollback_draw(uint32_t terminal_id, uint32_t back);
+static void scrollback_hide(void);
+
+/* 
+ * scrollback_alloc
+ *   DESCRIPTION: Allocate the history of a terminal.
+ *   INPUTS: terminal_id - terminal ID
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 if there is no memory
+ *   SIDE EFFECTS: Does nothing if it has one already.
+ */
+int32_t scrollback_alloc(uint32_t terminal_id)
+{
+    uint32_t flags;
+    int32_t ret;
+
+    spin_lock_irqsave(&terminal_lock, flags);
+    if (scrollback_pool[terminal_id] == NULL)
+    {
+        scrollback_pool[terminal_id] = page_alloc((sizeof(scrollback_t) + PAGE_SIZE - 1) / PAGE_SIZE);
+    }
+    ret = (scrollback_pool[terminal_id] == NULL) ? -1 : 0;
+    spin_unlock_irqrestore(&terminal_lock, flags);
+    return ret;
+}
+
+/* 
+ * scrollback_append
+ *   DESCRIPTION: Keep a row scrolled off the screen of a terminal.
+ *   INPUTS: terminal_id - terminal ID
+ *           row - NUM_COLS cells of the row
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The oldest row is dropped once the history is full.
+ *                 A shown history is not redrawn. Called by putbuf
+ *                 with terminal_lock held.
+ */
+void scrollback_append(uint32_t terminal_id, const uint16_t* row)
+{
+    scrollback_t* sb;
+
+    if (terminal_id >= TERMINAL_COUNT || scrollback_pool[terminal_id] == NULL)
+    {
+        return;
+    }
+    sb = scrollback_pool[terminal_id];
+    memcpy(sb->lines[sb->head & SCROLLBACK_MASK], row, NUM_COLS * 2);
+    sb->head++;
+}
+
+/* 
+ * scrollback_draw
+ *   DESCRIPTION: Draw the history of a terminal on the scrollback page.
+ *   INPUTS: terminal_id - terminal ID
+ *           back - rows back from the live screen
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The live rows below the history come from the view
+ *                 page of the terminal. terminal_lock is held.
+ */
+static void scrollback_draw(uint32_t terminal_id, uint32_t back)
+{
+    scrollback_t* sb = scrollback_pool[terminal_id];
+    uint16_t* view = (uint16_t*) VIDEO_SCROLLBACK_ADDR;
+    uint16_t* live = (uint16_t*) terminals[terminal_id].video_addr;
+    uint32_t row;
+
+    screen_flush_locked((char*) live);
+    for (row = 0; row < NUM_ROWS; row++)
+    {
+        if (row < back)
+        {
+            memcpy(view + row * NUM_COLS, sb->lines[(sb->head - back + row) & SCROLLBACK_MASK], NUM_COLS * 2);
+        }
+        else
+        {
+            memcpy(view + row * NUM_COLS, live + (row - back) * NUM_COLS, NUM_COLS * 2);
+        }
+    }
+}
+
+/* 
+ * scrollback_scroll
+ *   DESCRIPTION: Move the view of a terminal into its history, called
+ *                on Shift+PgUp and Shift+PgDn.
+ *   INPUTS: terminal_id - terminal ID, the active one
+ *           rows - rows to move, positive is older
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The scrollback page is shown until the view is back
+ *                 at the live screen. Writes to the terminal go on to
+ *                 its own page meanwhile. Takes terminal_lock.
+ */
+void scrollback_scroll(uint32_t terminal_id, int32_t rows)
+{
+    scrollback_t* sb;
+    uint32_t held, flags;
+    int32_t back;
+
+    if (terminal_id >= TERMINAL_COUNT)
+    {
+        return;
+    }
+    spin_lock_irqsave(&terminal_lock, flags);
+    if (scrollback_pool[terminal_id] == NULL)
+    {
+        spin_unlock_irqrestore(&terminal_lock, flags);
+        return;
+    }
+    sb = scrollback_pool[terminal_id];
+    held = (sb->head < SCROLLBACK_LINES) ? sb->head : SCROLLBACK_LINES;
+
+    // Another terminal was shown, start from its live screen
+    back = (view_back != 0 && view_tid == terminal_id) ? (int32_t) view_back : 0;
+    back += rows;
+    if (back > (int32_t) held)
+    {
+        back = held;
+    }
+    if (back <= 0)
+    {
+        scrollback_hide();
+    }
+    else
+    {
+        view_tid = terminal_id;
+        view_back = back;
+        scrollback_draw(terminal_id, back);
+        set_display_page((char*) VIDEO_SCROLLBACK_ADDR);
+    }
+    spin_unlock_irqrestore(&terminal_lock, flags);
+}
+
+/* 
+ * scrollback_exit
+ *   DESCRIPTION: Show the live screen again if the history is shown.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The VRAM page of the terminal is shown and the
+ *                 cursor is put back. Takes terminal_lock.
+ */
+void scrollback_exit(void)
+{
+    uint32_t flags;
+
+    spin_lock_irqsave(&terminal_lock, flags);
+    scrollback_hide();
+    spin_unlock_irqrestore(&terminal_lock, flags);
+}
+
+/* 
+ * scrollback_hide
+ *   DESCRIPTION: scrollback_exit with terminal_lock held.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void scrollback_hide(void)
+{
+    if (view_back == 0)
+    {
+        return;
+    }
+    view_back = 0;
+    set_display_page((char*) terminals[view_tid].video_addr);
+    switchCursor(view_tid);
+}
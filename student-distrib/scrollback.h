@@ -0,0 +1,45 @@
+/**
+ *  scrollback.h - Scrollback history of the terminals
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: 
+ */
+
+#ifndef _SCROLLBACK_H
+#define _SCROLLBACK_H
+
+// Rows kept per terminal, must be power of 2
+#define SCROLLBACK_LINES 2048
+#define SCROLLBACK_MASK (SCROLLBACK_LINES - 1)
+
+// Rows moved by one Shift+PgUp or Shift+PgDn
+#define SCROLLBACK_STEP 12
+
+#include "types.h"
+
+#ifndef ASM
+
+#include "lib.h"
+
+// Rows scrolled off the screen of a terminal, oldest overwritten first
+typedef struct scrollback_t
+{
+    uint16_t lines[SCROLLBACK_LINES][NUM_COLS];
+    uint32_t head;                      // Rows ever appended
+} scrollback_t;
+
+// Allocate the history of a terminal
+extern int32_t scrollback_alloc(uint32_t terminal_id);
+
+// Keep a row scrolled off the screen of a terminal
+extern void scrollback_append(uint32_t terminal_id, const uint16_t* row);
+
+// Move the view of a terminal into its history, positive is older
+extern void scrollback_scroll(uint32_t terminal_id, int32_t rows);
+
+// Show the live screen again if the history is shown
+extern void scrollback_exit(void);
+
+#endif /* ASM */
+
+#endif /* _SCROLLBACK_H */
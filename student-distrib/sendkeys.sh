@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Type lines into the OS through the QEMU monitor, for typebench.
+# Start QEMU with: -monitor unix:/tmp/mp3mon,server,nowait
+# Usage: ./sendkeys.sh [lines] [keys per line] [hold ms]
+# typebench should report lines * (keys + 1) keys and 0 dropped.
+
+SOCK=${SOCK:-/tmp/mp3mon}
+LINES=${1:-20}
+KEYS=${2:-60}
+HOLD=${3:-10}
+
+if [ "$KEYS" -gt 127 ]; then
+    echo "A line holds at most 127 keys."
+    exit 1
+fi
+
+LETTERS=(a b c d e f g h i j k l m n o p q r s t u v w x y z)
+for ((l = 0; l < LINES; l++)); do
+    for ((k = 0; k < KEYS; k++)); do
+        echo "sendkey ${LETTERS[k % 26]} $HOLD"
+    done
+    echo "sendkey ret $HOLD"
+done | socat - UNIX-CONNECT:"$SOCK" > /dev/null
+
+echo "Sent $((LINES * (KEYS + 1))) keys."
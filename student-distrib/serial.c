@@ -0,0 +1,342 @@
+/**
+ *  serial.c - 16550 UART Driver, serial console on COM1
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: OSDev, National Semiconductor PC16550D datasheet
+ */
+
+#include "serial.h"
+#include "interrupts.h"
+#include "keyboard.h"
+
+// Initialize Global Variable
+uint8_t serial_log = SERIAL_LOG;
+uint32_t serial_terminals = 0;
+
+// File-scope variables
+// UART found, its IRQ taken, bytes its TX FIFO takes at once
+static uint8_t serial_present = 0;
+static uint8_t serial_irq_on = 0;
+static uint32_t serial_fifo = 1;
+
+// Transmit ring, the writers move the tail and the IRQ the head
+static uint8_t tx_ring[SERIAL_TX_RING_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+
+// Bytes received by the IRQ for the tasklet
+static uint8_t rx_ring[SERIAL_RX_RING_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+// Bottom half, types the bytes received
+static void serial_tasklet_handle(uint32_t data);
+static tasklet_t serial_tasklet = { NULL, serial_tasklet_handle, 0, 0 };
+
+// Helper function to move queued bytes into the TX FIFO
+static void serial_fill(void);
+
+/*
+ * serial_init
+ *   DESCRIPTION: Find the UART on COM1 and set it up for 115200
+ *                baud 8N1 with its FIFOs.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: A byte is sent to itself in loopback to tell if
+ *                 the UART is there. Without one, writes are dropped.
+ *                 Writes poll the UART until serial_start().
+ */
+void serial_init(void)
+{
+    outb(0x00, SERIAL_IER);
+
+    // Without a UART neither the scratch nor the loopback byte reads back
+    outb(0xA5, SERIAL_SCR);
+    if (inb(SERIAL_SCR) != 0xA5)
+    {
+        return;
+    }
+    outb(LCR_DLAB, SERIAL_LCR);
+    outb(SERIAL_DIVISOR & 0xFF, SERIAL_DATA);
+    outb(SERIAL_DIVISOR >> 8, SERIAL_IER);
+    outb(LCR_8N1, SERIAL_LCR);
+    outb(FCR_ENABLE, SERIAL_IIR);
+    outb(MCR_LOOPBACK, SERIAL_MCR);
+    outb(0xAE, SERIAL_DATA);
+    if (inb(SERIAL_DATA) != 0xAE)
+    {
+        return;
+    }
+
+    // A 16550A reports its FIFOs, older UARTs take a byte at a time
+    if ((inb(SERIAL_IIR) & IIR_FIFO) == IIR_FIFO)
+    {
+        serial_fifo = SERIAL_FIFO_SIZE;
+    }
+    outb(MCR_DTR_RTS_OUT2, SERIAL_MCR);
+    serial_present = 1;
+    serial_terminals = (SERIAL_TERMINAL >= 0) ? (1 << SERIAL_TERMINAL) : 0;
+}
+
+/*
+ * serial_start
+ *   DESCRIPTION: Take the COM1 IRQ, bytes received and the TX FIFO
+ *                running empty interrupt from then on.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none without a UART
+ */
+void serial_start(void)
+{
+    if (!serial_present || request_irq(SERIAL_IRQ, serial_handle, NULL) == -1)
+    {
+        return;
+    }
+    serial_irq_on = 1;
+    outb(IER_RX, SERIAL_IER);
+}
+
+/*
+ * serial_handle
+ *   DESCRIPTION: Handler to handle COM1 interrupts
+ *   INPUTS: ctx - ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The TX FIFO is refilled from the ring, the TX
+ *                 interrupt is turned off once the ring is empty.
+ *                 Bytes received are queued for the tasklet, those
+ *                 beyond its ring are dropped.
+ */
+void serial_handle(void* ctx)
+{
+    uint8_t iir, received = 0;
+
+    while (!((iir = inb(SERIAL_IIR)) & IIR_NONE))
+    {
+        switch (iir & IIR_ID_MASK)
+        {
+            case IIR_TX:
+                serial_fill();
+                if (tx_head == tx_tail)
+                {
+                    outb(IER_RX, SERIAL_IER);
+                }
+                break;
+
+            case IIR_RX:
+            case IIR_RX_TIMEOUT:
+                while (inb(SERIAL_LSR) & LSR_DR)
+                {
+                    if ((rx_tail - rx_head) == SERIAL_RX_RING_SIZE)
+                    {
+                        (void) inb(SERIAL_DATA);
+                        continue;
+                    }
+                    rx_ring[rx_tail & SERIAL_RX_RING_MASK] = inb(SERIAL_DATA);
+                    rx_tail++;
+                    serial_received++;
+                    received = 1;
+                }
+                break;
+
+            case IIR_LSR:
+                (void) inb(SERIAL_LSR);
+                break;
+
+            default:
+                (void) inb(SERIAL_MSR);
+                break;
+        }
+    }
+
+    // Send EOI
+    send_eoi(SERIAL_IRQ);
+
+    if (received)
+    {
+        tasklet_schedule(&serial_tasklet);
+    }
+}
+
+/*
+ * serial_tasklet_handle
+ *   DESCRIPTION: Bottom half of the COM1 interrupt, bytes received
+ *                are typed on the active terminal like keys.
+ *   INPUTS: data - ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: CR is taken as a new line and DEL as backspace,
+ *                 other control bytes are dropped.
+ */
+static void serial_tasklet_handle(uint32_t data)
+{
+    uint8_t c;
+
+    while (rx_head != rx_tail)
+    {
+        c = rx_ring[rx_head & SERIAL_RX_RING_MASK];
+        rx_head++;
+
+        if (c == '\r')
+        {
+            c = '\n';
+        }
+        else if (c == 0x7F)
+        {
+            c = '\b';
+        }
+        if ((c >= ' ' && c < 0x7F) || c == '\n' || c == '\b' || c == '\t')
+        {
+            keyboard_type(c);
+        }
+    }
+
+    // Take the shortcut to handle the new key if not currently in the specified terminal
+    if (pcb->terminal_id != terminal_active)
+    {
+        resched_terminal(terminal_active);
+    }
+}
+
+/*
+ * serial_fill
+ *   DESCRIPTION: Move queued bytes into the TX FIFO if it is empty.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: call with interrupts off
+ */
+static void serial_fill(void)
+{
+    uint32_t i;
+
+    if (!(inb(SERIAL_LSR) & LSR_THRE))
+    {
+        return;
+    }
+    for (i = 0; (i < serial_fifo) && (tx_head != tx_tail); i++)
+    {
+        outb(tx_ring[tx_head & SERIAL_TX_RING_MASK], SERIAL_DATA);
+        tx_head++;
+        serial_sent++;
+    }
+}
+
+/*
+ * serial_write
+ *   DESCRIPTION: Queue bytes for COM1, each new line is sent as
+ *                CR LF.
+ *   INPUTS: buf - bytes to send
+ *           n - number of bytes
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: With the IRQ taken the FIFO is filled at once and
+ *                 the TX interrupt sends the rest, bytes beyond the
+ *                 ring are dropped so the screen never waits for the
+ *                 line. Before that the UART is polled until the
+ *                 ring is empty.
+ */
+void serial_write(const uint8_t* buf, int32_t n)
+{
+    uint32_t flags;
+    int32_t i;
+
+    if (!serial_present)
+    {
+        return;
+    }
+
+    cli_and_save(flags);
+    for (i = 0; i < n; i++)
+    {
+        if ((tx_tail - tx_head) >= SERIAL_TX_RING_SIZE - 1)
+        {
+            serial_lost += n - i;
+            break;
+        }
+        if (buf[i] == '\n')
+        {
+            tx_ring[tx_tail & SERIAL_TX_RING_MASK] = '\r';
+            tx_tail++;
+        }
+        tx_ring[tx_tail & SERIAL_TX_RING_MASK] = buf[i];
+        tx_tail++;
+    }
+
+    if (serial_irq_on)
+    {
+        serial_fill();
+        if (tx_head != tx_tail)
+        {
+            outb(IER_RX | IER_TX, SERIAL_IER);
+        }
+    }
+    else
+    {
+        while (tx_head != tx_tail)
+        {
+            serial_fill();
+        }
+    }
+    restore_flags(flags);
+}
+
+/*
+ * serial_mirror
+ *   DESCRIPTION: Send what is written to a terminal to COM1 as well.
+ *                Other terminals keep their own setting.
+ *   INPUTS: terminal_id - terminal ID
+ *           on - 1 to mirror the terminal, 0 to stop
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 - it was mirrored before, 0 - it was not,
+ *                 -1 - there is no UART
+ *   SIDE EFFECTS: none
+ */
+int32_t serial_mirror(uint32_t terminal_id, uint8_t on)
+{
+    uint32_t bit = 1 << terminal_id;
+    int32_t was;
+
+    if (!serial_present)
+    {
+        return -1;
+    }
+    was = (serial_terminals & bit) ? 1 : 0;
+    if (on)
+    {
+        serial_terminals |= bit;
+    }
+    else
+    {
+        serial_terminals &= ~bit;
+    }
+    return was;
+}
+
+/*
+ * serial_pending
+ *   DESCRIPTION: Bytes queued and not yet sent.  The UART does not say
+ *                how full its TX FIFO is, so while it still sends the
+ *                whole FIFO is counted; 0 means the line is idle.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: bytes waiting, -1 if there is no UART
+ *   SIDE EFFECTS: none
+ */
+int32_t serial_pending(void)
+{
+    int32_t pending;
+
+    if (!serial_present)
+    {
+        return -1;
+    }
+    pending = tx_tail - tx_head;
+    if (!(inb(SERIAL_LSR) & LSR_TEMT))
+    {
+        pending += serial_fifo;
+    }
+    return pending;
+}
@@ -0,0 +1,102 @@
+/**
+ *  serial.h - 16550 UART Driver, serial console on COM1
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: OSDev, National Semiconductor PC16550D datasheet
+ */
+
+#ifndef _SERIAL_H
+#define _SERIAL_H
+
+// COM1 IRQ Code and registers
+#define SERIAL_IRQ 4
+#define SERIAL_BASE 0x3F8
+#define SERIAL_DATA (SERIAL_BASE + 0)   // RBR and THR, DLL with DLAB
+#define SERIAL_IER (SERIAL_BASE + 1)    // DLM with DLAB
+#define SERIAL_IIR (SERIAL_BASE + 2)    // FCR on writes
+#define SERIAL_LCR (SERIAL_BASE + 3)
+#define SERIAL_MCR (SERIAL_BASE + 4)
+#define SERIAL_LSR (SERIAL_BASE + 5)
+#define SERIAL_MSR (SERIAL_BASE + 6)
+#define SERIAL_SCR (SERIAL_BASE + 7)
+
+// 115200 baud from the 1.8432 MHz clock, 8N1
+#define SERIAL_DIVISOR 1
+#define SERIAL_BAUD 115200
+#define LCR_DLAB 0x80
+#define LCR_8N1 0x03
+
+// FIFOs on and cleared, RX interrupt at 14 bytes
+#define FCR_ENABLE 0xC7
+#define IIR_FIFO 0xC0
+#define SERIAL_FIFO_SIZE 16
+
+#define IER_RX 0x01
+#define IER_TX 0x02
+
+#define IIR_NONE 0x01
+#define IIR_ID_MASK 0x0E
+#define IIR_MSR 0x00
+#define IIR_TX 0x02
+#define IIR_RX 0x04
+#define IIR_LSR 0x06
+#define IIR_RX_TIMEOUT 0x0C
+
+#define MCR_DTR_RTS_OUT2 0x0B           // OUT2 passes the IRQ to the PIC
+#define MCR_LOOPBACK 0x1E
+
+#define LSR_DR 0x01
+#define LSR_THRE 0x20
+#define LSR_TEMT 0x40
+
+// Bytes queued for transmit and received, must be power of 2
+#define SERIAL_TX_RING_SIZE 8192
+#define SERIAL_TX_RING_MASK (SERIAL_TX_RING_SIZE - 1)
+#define SERIAL_RX_RING_SIZE 256
+#define SERIAL_RX_RING_MASK (SERIAL_RX_RING_SIZE - 1)
+
+// Kernel messages go to COM1 too, build with -DSERIAL_LOG=0 for none
+#ifndef SERIAL_LOG
+#define SERIAL_LOG 1
+#endif
+
+// Terminal mirrored to COM1 at boot, -1 for none
+#ifndef SERIAL_TERMINAL
+#define SERIAL_TERMINAL 0
+#endif
+
+#include "types.h"
+
+#ifndef ASM
+
+#include "lib.h"
+
+// Mirror kernel messages, and a bit per terminal whose output is mirrored
+uint8_t serial_log;
+uint32_t serial_terminals;
+
+// Bytes sent, received, and dropped because the transmit ring was full
+uint32_t serial_sent;
+uint32_t serial_received;
+uint32_t serial_lost;
+
+// Find and set up the UART, writes poll it until serial_start()
+extern void serial_init(void);
+
+// Take the IRQ, transmit is driven by interrupts from then on
+extern void serial_start(void);
+
+// Handler to handle COM1 interrupts
+extern void serial_handle(void* ctx);
+
+// Queue bytes for COM1, a new line is sent as CR LF
+extern void serial_write(const uint8_t* buf, int32_t n);
+
+// Mirror the output of a terminal to COM1, or stop, return the old setting
+extern int32_t serial_mirror(uint32_t terminal_id, uint8_t on);
+
+// Bytes still waiting to be sent, 0 once the line is idle, -1 with no UART
+extern int32_t serial_pending(void);
+
+#endif /* ASM */
+#endif /* _SERIAL_H */
@@ -32,11 +32,13 @@ void sig_set(pcb_t* pcb, uint8_t sig_num)
         printf("\n<i> Program %s on terminal %u received sig_num %u\n", pcb->command, pcb->terminal_id, sig_num);
     }
     pcb->sig_pending = sig_num;
+    pcb->work_pending |= WORK_SIGNAL;
 }
 
 /* Function: sig_dispatch
  * Description: Dispatch the current signal to handler in current PCB.
- *              This is called by all linkage return.
+ *              This is called by exception linkage return, and by
+ *              interrupt and syscall linkage return when work_pending is set.
  * Inputs: eax - used to preserve eax return code from syscall
  * Outputs: none
  * Side Effects: setup stackframe and dispatch to handler accordingly
@@ -75,6 +77,7 @@ uint32_t sig_dispatch(uint32_t eax)
         // Clear the pending signal and mask the line
         printf("\n<i> Calling custom sig_num %u handler 0x%#x for program %s.\n", pending, pcb->sig_handlers[pending], pcb->command);
         pcb->sig_pending = NULLSIG;
+        pcb->work_pending &= ~WORK_SIGNAL;
         pcb->sig_mask = 1;
 
         // Save eax
@@ -135,6 +138,7 @@ uint32_t sig_dispatch(uint32_t eax)
     {
         // Clear the pending signal
         pcb->sig_pending = NULLSIG;
+        pcb->work_pending &= ~WORK_SIGNAL;
         pcb->sig_mask = 1;
 
         // Call the default handler
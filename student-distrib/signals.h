@@ -17,8 +17,26 @@
 #define SYSKILL     5     // Task Kill by Kernel
 #define NULLSIG     255   // Null Signal
 
-// Maximum PID count
-#define MAX_PID_COUNT 6
+// Maximum PID count, a base shell for each of 12 terminals and some programs
+#define MAX_PID_COUNT 16
+
+// Byte offset of work_pending in pcb_t, tested by the linkage exit paths
+#define PCB_WORK_PENDING_OFFSET 0
+
+// Byte offset of ksp in pcb_t, saved and loaded by switch_to
+#define PCB_KSP_OFFSET 4
+
+// Bits in pcb_t work_pending, any set bit sends the linkage down the slow exit
+#define WORK_SIGNAL 0x1     // sig_pending holds a signal to dispatch
+#define WORK_RING   0x2     // Submission ring has entries for the tick drain
+
+// Process states in pcb_t state
+#define PROC_RUNNABLE   0   // Running, or may be switched to
+#define PROC_NEW        1   // Spawned, starts in user space when first switched to
+#define PROC_BLOCKED    2   // Sleeping on a wait queue
+#define PROC_WAITING    3   // Blocked in execute until its job halts
+#define PROC_ZOMBIE     4   // Halted, waiting to switch away from its stack
+#define PROC_REAPING    5   // Halting, waits for its spawned children to halt
 
 #include "types.h"
 
@@ -34,6 +52,8 @@ typedef struct file_op_ptr_t
     int32_t (*close)(int32_t fd);
     int32_t (*read)(int32_t fd, void* buf, int32_t nbytes);
     int32_t (*write)(int32_t fd, const void* buf, int32_t nbytes);
+    int32_t (*poll)(int32_t fd, uint8_t wait);      // POLL* ready now, wait - also join the wait queues
+    int32_t (*ioctl)(int32_t fd, uint32_t request, uint32_t arg);   // Driver requests, NULL if none
 } file_op_ptr_t;
 
 // File structure for File desciptor
@@ -43,11 +63,14 @@ typedef struct file_desc_t
     uint32_t inode;
     int32_t file_position;
     uint32_t flags;
+    uint32_t status;                    // O_* status flags, set by ioctl
 } file_desc_t;
 
 // File structure for PCB
 typedef struct pcb_t
 {
+    uint32_t work_pending;              // Pending Work Bitmask, keep first
+    uint32_t ksp;                       // Saved Kernel ESP when switched out, keep second
     uint8_t process_id;                 // Process ID, PID
     uint8_t terminal_id;                // Terminal ID, TID
     uint8_t previous_id;                // Previous PID, P_PID
@@ -57,8 +80,6 @@ typedef struct pcb_t
     uint8_t sig_stacksize;              // Signal linkage stacksize
     uint8_t sig_mask;                   // Signal Mask
     uint32_t arg_len;                   // Argument Length
-    uint32_t ebp;                       // Parent EBP
-    uint32_t esp;                       // Parent ESP
     uint32_t tss_esp;                   // Kernel Stack ESP, KSP
     uint32_t sig_ebp;                   // Signal linkage EBP
     uint32_t sig_esp;                   // Signal linkage ESP
@@ -66,6 +87,14 @@ typedef struct pcb_t
     uint32_t user_esp;                  // Last user ESP from linkage
     void* sig_handlers[5];              // Signal Handlers
     uint32_t sig_stackshot[27];         // Signal linkage stackshot
+    struct ring_t* ring;                // Registered Submission Ring
+    uint32_t ring_flags;                // Ring Setup Flags
+    uint8_t state;                      // Process State, PROC_*
+    uint8_t spawned;                    // Started by spawn, no parent stack frame
+    uint8_t children;                   // Live Spawned and Executed Children
+    uint8_t exec_pending;               // Executed child halted, others still run
+    uint32_t start_eip;                 // Program entry of a spawned process
+    int32_t exec_status;                // Saved halt status of the halted child
     file_desc_t file_descriptor [8];    // File Descriptor
 } pcb_t;
 
@@ -0,0 +1,149 @@
+/**
+ *  softirq.c - deferred interrupt work and irq-off tracing
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: Linux softirq and tasklet design notes
+ */
+
+#include "softirq.h"
+#include "syscalls.h"
+
+// File-scope variables
+// Queued tasklets in FIFO order, tasklet_tail points at the last next
+static tasklet_t* tasklet_head = NULL;
+static tasklet_t** tasklet_tail = &tasklet_head;
+
+// Tasklets are running, nested interrupts only queue more
+static volatile uint8_t softirq_active = 0;
+
+// TSC at the start of the current irq-off window, 0 if none
+static uint32_t irqoff_start = 0;
+
+/* Function: tasklet_schedule
+ * Description: Queue a tasklet, called by top halves with interrupts
+ *              off. A tasklet queued twice before it runs runs once,
+ *              so the bottom half must handle everything pending.
+ * Inputs: t - tasklet to queue
+ * Outputs: none
+ * Side Effects: with SOFTIRQ_INLINE the tasklet runs right away
+ */
+void tasklet_schedule(tasklet_t* t)
+{
+#ifdef SOFTIRQ_INLINE
+    t->func(t->data);
+#else
+    if (t->scheduled)
+    {
+        return;
+    }
+    t->scheduled = 1;
+    t->next = NULL;
+    *tasklet_tail = t;
+    tasklet_tail = &(t->next);
+#endif
+}
+
+/* Function: do_softirq
+ * Description: Run queued tasklets with interrupts enabled, until no
+ *              top half queues more. Called by every interrupt after
+ *              its top half. Interrupts nested in a tasklet only run
+ *              their top half, the outer loop picks up what they queue.
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: call and returns with interrupts off, a switch asked
+ *               for by a tasklet waits for the interrupt exit
+ */
+void do_softirq(void)
+{
+    tasklet_t* t;
+    tasklet_t* next;
+
+    if (softirq_active)
+    {
+        return;
+    }
+    softirq_active = 1;
+
+    while (tasklet_head != NULL)
+    {
+        // Take the whole queue, top halves may queue more meanwhile
+        t = tasklet_head;
+        tasklet_head = NULL;
+        tasklet_tail = &tasklet_head;
+
+        preempt_disable();
+        sti();
+        while (t != NULL)
+        {
+            next = t->next;
+            t->scheduled = 0;
+            t->func(t->data);
+            t = next;
+        }
+        cli();
+        preempt_enable();
+    }
+    softirq_active = 0;
+}
+
+/* Function: in_softirq
+ * Description: Tell if tasklets are running
+ * Inputs: none
+ * Outputs: 1 - running, 0 - not running
+ * Side Effects: none
+ */
+int32_t in_softirq(void)
+{
+    return softirq_active;
+}
+
+/* Function: irqoff_trace_start
+ * Description: Mark the start of a window with interrupts disabled,
+ *              called on interrupt entry
+ * Inputs: none
+ * Outputs: none
+ * Side Effects: none
+ */
+void irqoff_trace_start(void)
+{
+    irqoff_start = rdtsc_low();
+}
+
+/* Function: irqoff_trace_stop
+ * Description: Mark the end of the window, before interrupts are
+ *              enabled again. A switch in between ends the window in
+ *              the other process, which is still interrupts off time.
+ * Inputs: irq - IRQ # the window is accounted to
+ * Outputs: TSC cycles in the window, 0 if no window is open
+ * Side Effects: irqoff_hook is called if set
+ */
+uint32_t irqoff_trace_stop(int irq)
+{
+    uint32_t cycles;
+
+    if (irqoff_start == 0)
+    {
+        return 0;
+    }
+    cycles = rdtsc_low() - irqoff_start;
+    irqoff_start = 0;
+    if (irqoff_hook != NULL)
+    {
+        irqoff_hook(irq, cycles);
+    }
+    return cycles;
+}
+
+/* Function: irqoff_record
+ * Description: Default tracing hook, keeps the worst case of each IRQ
+ * Inputs: irq - IRQ #, cycles - length of the window
+ * Outputs: none
+ * Side Effects: irqoff_max is updated
+ */
+void irqoff_record(int irq, uint32_t cycles)
+{
+    if ((irq >= 0) && (irq < IRQ_COUNT) && (cycles > irqoff_max[irq]))
+    {
+        irqoff_max[irq] = cycles;
+    }
+}
@@ -0,0 +1,58 @@
+/**
+ *  softirq.h - deferred interrupt work and irq-off tracing
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: Linux softirq and tasklet design notes
+ */
+
+#ifndef _SOFTIRQ_H
+#define _SOFTIRQ_H
+
+// IRQ lines of the 8259 pair
+#define IRQ_COUNT 16
+
+// Define to run bottom halves inside the hard IRQ like before,
+// the process manager then shows the old irq-off time
+// #define SOFTIRQ_INLINE
+
+#include "types.h"
+
+#ifndef ASM
+
+#include "lib.h"
+
+// Bottom half queued by a top half, runs with interrupts enabled
+typedef struct tasklet_t
+{
+    struct tasklet_t* next;             // Next Queued Tasklet
+    void (*func)(uint32_t data);        // Bottom Half
+    uint32_t data;                      // Argument of func
+    uint8_t scheduled;                  // Queued and not run yet
+} tasklet_t;
+
+// Longest time with interrupts disabled in each IRQ handler, TSC cycles
+uint32_t irqoff_max[IRQ_COUNT];
+
+// Tracing hook, called with the irq-off cycles of every interrupt
+void (*irqoff_hook)(int irq, uint32_t cycles);
+
+// Queue a tasklet to run when the interrupt returns, call with interrupts off
+extern void tasklet_schedule(tasklet_t* t);
+
+// Run queued tasklets with interrupts enabled, called on interrupt exit
+extern void do_softirq(void);
+
+// Tell if tasklets are running, the scheduler must not switch then
+extern int32_t in_softirq(void);
+
+// Mark the start of a window with interrupts disabled
+extern void irqoff_trace_start(void);
+
+// Mark the end of the window, and pass its length to the tracing hook
+extern uint32_t irqoff_trace_stop(int irq);
+
+// Default tracing hook, keeps the worst case of each IRQ
+extern void irqoff_record(int irq, uint32_t cycles);
+
+#endif /* ASM */
+#endif /* _SOFTIRQ_H */
@@ -0,0 +1,100 @@
+/**
+ *  spinlock.h - spinlocks and preemption counter
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: Linux spinlock design notes
+ */
+
+#ifndef _SPINLOCK_H
+#define _SPINLOCK_H
+
+#include "types.h"
+
+#ifndef ASM
+
+// Spinlock, 0 is unlocked
+typedef struct spinlock_t
+{
+    volatile uint32_t locked;
+} spinlock_t;
+
+// Locks held and sections which must not be switched away from,
+// nothing is switched away from while it is not 0
+volatile uint32_t preempt_count;
+
+// A switch was asked for, done at the next safe point: interrupt
+// exit, the last preempt_enable(), blocking and cond_resched()
+volatile uint8_t need_resched;
+
+// Switch if asked for, once preemption is enabled again
+extern void preempt_check_resched(void);
+
+// PCB pool, reserved PIDs and the current PCB
+spinlock_t pcb_lock;
+
+// Terminal info, video_mem, screen_x/y, the active terminal and the
+// line rings. Always taken with the irqsave variant, the PIT flushes the
+// rings. Nothing may printf while holding it, printf takes it itself.
+spinlock_t terminal_lock;
+
+// File system image, its directory entries, inodes and data blocks
+spinlock_t fs_lock;
+
+/* Keep the scheduler from switching away */
+static inline void preempt_disable(void) {
+    preempt_count++;
+    asm volatile ("" : : : "memory");
+}
+
+/* Allow switching again once every section is left */
+static inline void preempt_enable(void) {
+    asm volatile ("" : : : "memory");
+    if ((--preempt_count == 0) && need_resched) {
+        preempt_check_resched();
+    }
+}
+
+/* Take a lock, spinning while another CPU holds it. Only takes
+ * the lock against process and tasklet context, use the irqsave
+ * variant for data IRQ handlers touch too. */
+static inline void spin_lock(spinlock_t* lock) {
+    uint32_t old;
+
+    preempt_disable();
+    do {
+        old = 1;
+        asm volatile ("xchgl %0, %1" : "+r"(old), "+m"(lock->locked) : : "memory");
+    } while (old != 0);
+}
+
+/* Release a lock */
+static inline void spin_unlock(spinlock_t* lock) {
+    asm volatile ("movl $0, %0" : "=m"(lock->locked) : : "memory");
+    preempt_enable();
+}
+
+/* Tell if a lock is held */
+static inline int32_t spin_is_locked(spinlock_t* lock) {
+    return (lock->locked != 0);
+}
+
+/* Disable interrupts, saving EFLAGS in flags, and take the lock */
+#define spin_lock_irqsave(lock, flags)  \
+do {                                    \
+    cli_and_save(flags);                \
+    spin_lock(lock);                    \
+} while (0)
+
+/* Release the lock and restore EFLAGS from flags, a switch asked for
+ * meanwhile happens once interrupts are back on */
+#define spin_unlock_irqrestore(lock, flags) \
+do {                                    \
+    spin_unlock(lock);                  \
+    restore_flags(flags);               \
+    if (need_resched) {                 \
+        preempt_check_resched();        \
+    }                                   \
+} while (0)
+
+#endif /* ASM */
+#endif /* _SPINLOCK_H */
@@ -6,11 +6,37 @@
  */
 
 #include "syscalls.h"
+#include "vidbuf.h"
+#include "vbe.h"
 
 // File-scope helper functions
 // Helper function to find next available PID in poll
 static int find_next_pid();
 
+// Helper function to put a reserved PID into the PCB pool, or give it back
+static void pid_commit(int pid, pcb_t* pcb_pointer);
+
+// Helper function to copy a program into its page in chunks
+static void load_program(int pid, uint32_t inode, int32_t size, uint8_t preemptible);
+
+// Helper function to enter a program loaded by execute
+static void start_program(uint32_t prog_eip);
+
+// PIDs taken by execute while the program loads, not in the pool yet
+static uint32_t pid_reserved = 0;
+
+// Helper function to check syscall arguments against the table flags
+static int32_t check_syscall_args(uint32_t callnum, uint8_t arg_flags, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+
+// Helper function to check the segments of readv/writev
+static int32_t check_iovec(const iovec_t* iov, int32_t iovcnt);
+
+// Helper function to load a program for execute and spawn
+static int32_t execute_program(const uint8_t* command, uint8_t spawn);
+
+// Helper function to close any FD of the current process
+static int32_t close_fd(int32_t fd);
+
 // File-scope data structures
 /* Structs containing pointers to read, write, open, and close funcs */
 struct file_op_ptr_t file_sys_calls =
@@ -18,7 +44,8 @@ struct file_op_ptr_t file_sys_calls =
     file_open,
     file_close,
     file_read,
-    file_write
+    file_write,
+    file_poll
 };
 
 struct file_op_ptr_t rtc_sys_calls =
@@ -26,7 +53,8 @@ struct file_op_ptr_t rtc_sys_calls =
     rtc_open,
     rtc_close,
     rtc_read,
-    rtc_write
+    rtc_write,
+    rtc_poll
 };
 
 struct file_op_ptr_t dir_sys_calls =
@@ -34,41 +62,166 @@ struct file_op_ptr_t dir_sys_calls =
     dir_open,
     dir_close,
     dir_read,
-    dir_write
+    dir_write,
+    file_poll
 };
 
-/* Function: sys_execute
- * Description: takes input command and execute the corresponding program
- * Inputs: 
- * command - uint8_t pointer giving command
- * Outputs - return -1 if unsuccessful
+struct file_op_ptr_t stdin_sys_calls =
+{
+    terminal_open,
+    terminal_close,
+    terminal_read,
+    terminal_write_invalid,
+    terminal_poll,
+    terminal_ioctl
+};
+
+struct file_op_ptr_t stdout_sys_calls =
+{
+    terminal_open,
+    terminal_close,
+    terminal_read_invalid,
+    terminal_write,
+    terminal_poll_out
+};
+
+/* Syscall table indexed by syscall #, shared by INT 0x80 and SYSENTER linkage */
+static const syscall_entry_t syscall_table[SYSCALL_MAX + 1] =
+{
+    { NULL, 0, 0 },                                                     // #0 is not valid
+    { (syscall_handler_t) sys_halt,        1, 0 },
+    { (syscall_handler_t) sys_execute,     1, SC_PTR0 },
+    { (syscall_handler_t) sys_read,        3, SC_FD0 | SC_PTR1 | SC_LEN2 | SC_RING },
+    { (syscall_handler_t) sys_write,       3, SC_FD0 | SC_PTR1 | SC_LEN2 | SC_RING },
+    { (syscall_handler_t) sys_open,        1, SC_PTR0 | SC_RING },
+    { (syscall_handler_t) sys_close,       1, SC_RING },                // Checks reserved FDs itself
+    { (syscall_handler_t) sys_getargs,     2, SC_PTR0 | SC_LEN1 },
+    { (syscall_handler_t) sys_vidmap,      1, 0 },                      // Checks the pointer itself
+    { (syscall_handler_t) sys_set_handler, 2, 0 },                      // NULL handler restores default
+    { (syscall_handler_t) sys_sigreturn,   0, 0 },
+    { (syscall_handler_t) sys_getpid,      0, SC_RING },
+    { (syscall_handler_t) sys_readv,       3, SC_FD0 | SC_PTR1 | SC_RING },
+    { (syscall_handler_t) sys_writev,      3, SC_FD0 | SC_PTR1 | SC_RING },
+    { (syscall_handler_t) sys_ring_setup,  2, 0 },                      // Checks the ring itself
+    { (syscall_handler_t) sys_ring_enter,  1, 0 },
+    { (syscall_handler_t) sys_pipe,        1, SC_PTR0 | SC_RING },
+    { (syscall_handler_t) sys_dup2,        2, SC_FD0 | SC_RING },     // Checks newfd itself
+    { (syscall_handler_t) sys_spawn,       1, SC_PTR0 },
+    { (syscall_handler_t) sys_poll,        3, SC_PTR0 },                // Checks the array end itself
+    { (syscall_handler_t) sys_ioctl,       3, SC_FD0 | SC_RING },
+    { (syscall_handler_t) sys_yield,       0, 0 },
+    { (syscall_handler_t) sys_vidflush,    0, 0 },
+    { (syscall_handler_t) sys_setmode,     3, 0 },
+    { (syscall_handler_t) sys_fbmap,       1, 0 }                       // Checks the pointer itself
+};
+
+/* Function: syscall_dispatch
+ * Description: Common syscall path called by the linkage. Looks up the
+ *              syscall table, checks the arguments according to the
+ *              flags of the entry, and calls the handler. Arguments
+ *              beyond nargs of the entry reach the handler as 0, never
+ *              as what the user left in the register.
+ * Inputs: callnum - syscall #, arg0 ~ arg2 - EBX, ECX, EDX from user
+ * Outputs: return value of the handler, -1 if syscall # or arguments are invalid
  * Side Effects: none
  */
-int32_t sys_execute(const uint8_t* command)
+int32_t syscall_dispatch(uint32_t callnum, uint32_t arg0, uint32_t arg1, uint32_t arg2)
 {
-    // Set progress flag
-    progress = 1;
+    // One unsigned compare rejects both #0 and anything above SYSCALL_MAX
+    if ((callnum - 1) >= SYSCALL_MAX)
+    {
+        return sys_invalid(callnum);
+    }
 
-    // Try to find next available PID
-    int available_pid = find_next_pid();
+    const syscall_entry_t* entry = &syscall_table[callnum];
 
-    // Check if can have more programs
-    if (available_pid == -1)
+    // Clear the registers the call does not take
+    switch (entry->nargs)
     {
-        printf("<!> Maximum process limit exceed. Please quit some programs.\n");
+        case 0:
+            arg0 = 0;
+            /* fall through */
+        case 1:
+            arg1 = 0;
+            /* fall through */
+        case 2:
+            arg2 = 0;
+            /* fall through */
+        default:
+            break;
+    }
+
+    // Most calls carry no argument flags and go straight to the handler
+    if ((entry->arg_flags & ~SC_RING) && (check_syscall_args(callnum, entry->arg_flags, arg0, arg1, arg2) == -1))
+    {
+        return -1;
+    }
+
+    return entry->handler(arg0, arg1, arg2);
+}
+
+/* Function: syscall_ring_dispatch
+ * Description: Dispatch a syscall taken from the submission ring. Calls
+ *              which switch programs or stacks are not allowed there.
+ * Inputs: callnum - syscall #, arg0 ~ arg2 - arguments from the entry
+ * Outputs: return value of the handler, -1 if not allowed or invalid
+ * Side Effects: none
+ */
+int32_t syscall_ring_dispatch(uint32_t callnum, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    if (((callnum - 1) >= SYSCALL_MAX) || !(syscall_table[callnum].arg_flags & SC_RING))
+    {
+        printf("<!> System call #%u cannot be submitted through the ring.\n", callnum);
         error_sound();
-        progress = 0;
         return -1;
     }
+    return syscall_dispatch(callnum, arg0, arg1, arg2);
+}
+
+/* Function: sys_execute
+ * Description: takes input command and execute the corresponding program
+ * Inputs: 
+ * command - uint8_t pointer giving command
+ * Outputs - return -1 if unsuccessful
+ * Side Effects: none
+ */
+int32_t sys_execute(const uint8_t* command)
+{
+    return execute_program(command, 0);
+}
 
-    // Sanity check for multiterminal base terminal init
+/* Function: sys_spawn
+ * Description: load a program like execute, but return to the caller
+ * at once. The new process inherits stdin and stdout, and runs on the
+ * same terminal whenever the caller blocks, which lets a shell run both
+ * sides of a pipe. The caller's next execute does not return until its
+ * spawned children have halted too, and neither does its halt.
+ * Inputs: 
+ * command - uint8_t pointer giving command
+ * Outputs - PID of the new process, -1 if unsuccessful
+ * Side Effects: none
+ */
+int32_t sys_spawn(const uint8_t* command)
+{
+    return execute_program(command, 1);
+}
 
+/* Function: execute_program
+ * Description: load the program of a command into a new process
+ * Inputs: 
+ * command - uint8_t pointer giving command
+ * spawn - 0 to switch to the program now, 1 to leave it for later
+ * Outputs - execute: halt status of the program, spawn: PID of the program,
+ *           -1 if unsuccessful
+ * Side Effects: none
+ */
+static int32_t execute_program(const uint8_t* command, uint8_t spawn)
+{
     // Parameter Check
     if (command == NULL)
     {
         printf("<!> Invalid command.\n");
         error_sound();
-        progress = 0;
         return -1;
     }
 
@@ -91,7 +244,6 @@ int32_t sys_execute(const uint8_t* command)
     {
         printf("<!> Program name is empty.\n");
         error_sound();
-        progress = 0;
         return -1;
     }    
 
@@ -100,6 +252,17 @@ int32_t sys_execute(const uint8_t* command)
     memcpy(prog_name, command, prog_name_len);
     prog_name[prog_name_len] = '\0';
 
+    // Try to find next available PID, it stays reserved until the program starts
+    int available_pid = find_next_pid();
+
+    // Check if can have more programs
+    if (available_pid == -1)
+    {
+        printf("<!> Maximum process limit exceed. Please quit some programs.\n");
+        error_sound();
+        return -1;
+    }
+
     if (verbose_mode)
     {
         // Prints out program name
@@ -117,7 +280,7 @@ int32_t sys_execute(const uint8_t* command)
     // Executable check
     if (check_executable((uint8_t *) prog_name) == -1)
     {
-        progress = 0;
+        pid_commit(available_pid, NULL);
         return -1;
     }
 
@@ -181,26 +344,34 @@ int32_t sys_execute(const uint8_t* command)
         }
     }
     
-    // Create page for new program
-    reMap4MBPage(available_pid);
+    // Only a program has FDs to inherit, not a base shell being started
+    uint8_t parent_live = (pcb_pool[pcb->process_id] == pcb);
 
-    // Load code into memory
+    // Load code into memory, a program may be switched away from meanwhile.
+    // Base shells are started by the scheduler or halt, which may not.
     dentry_t prog_dentry;
     uint8_t* prog_page_addr = (uint8_t*) PROGRAM_PAGE_ADDR;
     int32_t prog_size = return_file_size((uint8_t *) prog_name);
     if (read_dentry_by_name((uint8_t *) prog_name, &prog_dentry) == -1 || prog_size == -1)
     {
-        progress = 0;
+        pid_commit(available_pid, NULL);
         return -1;
     }
-    read_data(prog_dentry.inode_number, 0, prog_page_addr, prog_size);
+    load_program(available_pid, prog_dentry.inode_number, prog_size, parent_live);
     uint32_t prog_eip = (prog_page_addr[27] << 24) | (prog_page_addr[26] << 16) | (prog_page_addr[25] << 8) | prog_page_addr[24];
 
     // Create PCB
     pcb_t* pcb_pointer = (pcb_t*) (KERNEL_STACK_ADDR - (available_pid + 1) * KERNEL_STACK_OFFSET);
     pcb_pointer->process_id = available_pid;
     pcb_pointer->terminal_id = pcb->terminal_id;   // Get from current PCB
-    pcb_pointer->previous_id = pcb->process_id;    // Get from current PCB
+    pcb_pointer->previous_id = parent_live ? pcb->process_id : available_pid;
+    pcb_pointer->work_pending = 0;
+    pcb_pointer->ring = NULL;
+    pcb_pointer->ring_flags = 0;
+    pcb_pointer->state = spawn ? PROC_NEW : PROC_RUNNABLE;
+    pcb_pointer->spawned = spawn;
+    pcb_pointer->children = 0;
+    pcb_pointer->exec_pending = 0;
     pcb_pointer->sig_pending = NULLSIG;
     pcb_pointer->user_esp = NULL;
     pcb_pointer->sig_stacksize = 0;
@@ -219,47 +390,101 @@ int32_t sys_execute(const uint8_t* command)
     memcpy(&(pcb_pointer->command), &prog_name, prog_name_len);
     (pcb_pointer->command)[MAX_CMD_LEN] = '\0';
 
-    // Initialize file desc array 
+    // Initialize file desc array, other FDs of the caller stay private
     int fd_i;
-    for (fd_i = 0; fd_i < 8; fd_i++)
+    for (fd_i = 2; fd_i < FD_COUNT; fd_i++)
     {
         (pcb_pointer->file_descriptor)[fd_i].flags = FD_FLAG_EMPTY;
     }
 
-    // Save old EBP and return address for halt
-    uint32_t ebp, esp;
-    asm volatile (
-        "movl %%ebp, %0  \n"
-        "movl %%esp, %1  \n"
-        : "=r"(ebp), "=r"(esp)
-    );
-    pcb_pointer->ebp = ebp;
-    pcb_pointer->esp = esp;
-    
+    if (parent_live)
+    {
+        // Inherit stdin and stdout, they may be redirected to a pipe
+        (pcb_pointer->file_descriptor)[FD_STDIN] = (pcb->file_descriptor)[FD_STDIN];
+        (pcb_pointer->file_descriptor)[FD_STDOUT] = (pcb->file_descriptor)[FD_STDOUT];
+        pcb->children++;
+
+        // A new program always starts with blocking reads and writes
+        (pcb_pointer->file_descriptor)[FD_STDIN].status = 0;
+        (pcb_pointer->file_descriptor)[FD_STDOUT].status = 0;
+    }
+    else
+    {
+        // stdin and stdout are the terminal
+        (pcb_pointer->file_descriptor)[FD_STDIN].file_op_table_ptr = &stdin_sys_calls;
+        (pcb_pointer->file_descriptor)[FD_STDIN].inode = 0;
+        (pcb_pointer->file_descriptor)[FD_STDIN].file_position = 0;
+        (pcb_pointer->file_descriptor)[FD_STDIN].flags = FD_FLAG_TERMINAL;
+        (pcb_pointer->file_descriptor)[FD_STDIN].status = 0;
+        (pcb_pointer->file_descriptor)[FD_STDOUT].file_op_table_ptr = &stdout_sys_calls;
+        (pcb_pointer->file_descriptor)[FD_STDOUT].inode = 0;
+        (pcb_pointer->file_descriptor)[FD_STDOUT].file_position = 0;
+        (pcb_pointer->file_descriptor)[FD_STDOUT].flags = FD_FLAG_TERMINAL;
+        (pcb_pointer->file_descriptor)[FD_STDOUT].status = 0;
+    }
+
+    if (spawn)
+    {
+        // Started by proc_switch() later on its own kernel stack
+        pcb_pointer->tss_esp = KERNEL_STACK_ADDR - available_pid * KERNEL_STACK_OFFSET - 4;
+        pcb_pointer->start_eip = prog_eip;
+        pid_commit(available_pid, pcb_pointer);
+
+        // Map the caller's program page back
+        reMap4MBPage(pcb->process_id);
+        return available_pid;
+    }
+
+    // Caller waits in here until the program halts
+    if (parent_live)
+    {
+        pcb->state = PROC_WAITING;
+    }
+
     // Save and relocate kernel stack
     tss.esp0 = KERNEL_STACK_ADDR - available_pid * KERNEL_STACK_OFFSET - 4;
     pcb_pointer->tss_esp = tss.esp0;
 
     // Switch current PCB
+    pcb_t* caller = pcb;
     pcb = pcb_pointer;
 
     // Modify TI
     terminals[pcb->terminal_id].pcb = pcb;
     
     // Reset VRTC alarm counter
-    vrtc_alarm[pcb->terminal_id] = 0;
+    vrtc_alarm[pcb->terminal_id] = vrtc_ticks;
 
     // Mark the PCB pool position as occupied
-    pcb_pool[available_pid] = pcb;
+    pid_commit(available_pid, pcb);
+
+    // Halt switches back to the caller, which returns the status from here
+    if (parent_live)
+    {
+        switch_to_call(caller, start_program, prog_eip);
+        return halt_status;
+    }
+
+    // A base shell has no caller to return to
+    start_program(prog_eip);
+
+    // Should never return at here
+    return -1;
+}
 
+/* Function: start_program
+ * Description: IRET into the program of the current process
+ * Inputs: prog_eip - program entry
+ * Outputs: none, never returns
+ * Side Effects: the kernel stack below TSS ESP0 is given up
+ */
+static void start_program(uint32_t prog_eip)
+{
     // Push arguments and call IRET
     uint32_t prog_ss = USER_DS;
     uint32_t prog_esp = PROGRAM_STACK_ADDR - 4;
     uint32_t prog_cs = USER_CS;
 
-    // Clear progress flag
-    progress = 0;
-
     asm volatile (
         "pushl %0  \n"
         "pushl %1  \n"
@@ -271,9 +496,6 @@ int32_t sys_execute(const uint8_t* command)
         : "r"(prog_ss), "r"(prog_esp), "r"(prog_cs), "r"(prog_eip)
         : "memory", "cc"
     );
-
-    // Should never return at here
-    return -1;
 }
 
 /* Function: sys_halt
@@ -285,9 +507,9 @@ int32_t sys_execute(const uint8_t* command)
  */
 int32_t sys_halt(uint8_t status)
 {
-    // Set progress flag
-    progress = 1;
+    uint32_t flags;
 
+    // Runs with interrupts off from the syscall gate until the stack switch
     // Determine halt reason
     halt_status = status;
     if (!status && (((pcb->sig_pending) == DIV_ZERO) || ((pcb->sig_pending) == SEGFAULT)))
@@ -296,9 +518,6 @@ int32_t sys_halt(uint8_t status)
         halt_status = 256;
     }
 
-    // Free the PCB pool, following the old logic
-    pcb_pool[pcb->process_id] = NULL;
-
     if (verbose_mode)
     {
         printf("\n<i> Terminating program PID %u on terminal_id %u, halt_status %d\n", pcb->process_id, pcb->terminal_id, halt_status);
@@ -308,63 +527,111 @@ int32_t sys_halt(uint8_t status)
         putc('\n');
     }
 
-    if (pcb->process_id > 5)
+    if (pcb->process_id >= MAX_PID_COUNT)
     {
         printf("<!> Invalid PID %u, system halted.", pcb->process_id);
         error_sound();
         while (1);
     }
 
-    // Tell the user about the information
-    if (pcb->process_id < TERMINAL_COUNT)
+    // Give the terminal back in line mode
+    terminal_release();
+
+    // Show the last frame drawn in RAM if this process turned buffering on,
+    // a job halting before or after it leaves its buffering alone
+    vidbuf_release(pcb->terminal_id, pcb->process_id);
+
+    // Close all fd, stdin and stdout may be pipe ends
+    int fd_i;
+    for (fd_i = 0; fd_i < FD_COUNT; fd_i++)
     {
+        close_fd(fd_i);
+    }
+
+    // Spawned children still running keep this PID as their parent.
+    // The pipe ends are closed above, so writers to them halt too.
+    proc_wait_children();
+
+    // Tell the user about the information, a base shell is its own parent
+    if (pcb->previous_id == pcb->process_id)
+    {
+        // Free the PCB pool, the restarted shell takes a free PID
+        spin_lock_irqsave(&pcb_lock, flags);
+        pcb_pool[pcb->process_id] = NULL;
+        spin_unlock_irqrestore(&pcb_lock, flags);
+
         printf("<!> Base shell of the terminal_id %u is dead, trying to restart.\n", pcb->terminal_id);
         printf("<!> playing sound...\n");
         OS_start_sound();
         sys_execute((uint8_t *)"shell");
 
         // This should never be called
-        progress = 0;
         return -1;
     }
 
-    // Close all fd. except first two
-    int fd_i;
-	for(fd_i = 2; fd_i < 7; fd_i++)
+    // The parent waits for its children in halt, so it should still be there
+    pcb_t* parent = pcb_pool[pcb->previous_id];
+    if ((parent == NULL) || (parent->process_id != pcb->previous_id))
     {
-        sys_close(fd_i);
+        printf("<!> Parent PID %u of PID %u is gone.\n", pcb->previous_id, pcb->process_id);
+        proc_exit();
     }
 
+    // An executed child leaves its status for the execute of its parent
+    if (!pcb->spawned)
+    {
+        parent->exec_status = halt_status;
+        parent->exec_pending = 1;
+    }
+
+    // Parent resumes when the last child of the job halts, or finishes
+    // its own halt if it was waiting for them there
+    if ((--parent->children == 0) && (parent->state == PROC_REAPING))
+    {
+        parent->state = PROC_RUNNABLE;
+    }
+    if ((parent->children > 0) || !parent->exec_pending)
+    {
+        proc_exit();
+    }
+
+    // Free the PCB pool
+    spin_lock_irqsave(&pcb_lock, flags);
+    pcb_pool[pcb->process_id] = NULL;
+    spin_unlock_irqrestore(&pcb_lock, flags);
+
     // Tear down vidmap page
     unMap4KBVidMemPage();
 
+    // Text mode again if this process set a graphics mode
+    vbe_release(pcb->process_id);
+    unMapFBPage();
+
     // Remap program page
     reMap4MBPage(pcb->previous_id);
 
-    // Give up current stack frame, restore execute EBP, linkage status
-    uint32_t ebp = pcb->ebp;
-    uint32_t esp = pcb->esp;
+    // Linkage status of the execute the parent waits in
+    halt_status = parent->exec_status;
+    parent->exec_pending = 0;
+    parent->state = PROC_RUNNABLE;
 
     // Modify TI
-    terminals[pcb->terminal_id].pcb = pcb_pool[pcb->previous_id];
+    terminals[pcb->terminal_id].pcb = parent;
     terminals[pcb->terminal_id].vidmap = 0;
+    terminals[pcb->terminal_id].fbmap = 0;
 
     // Reset PCB pointer
-    pcb = pcb_pool[pcb->previous_id];
+    pcb_t* child = pcb;
+    pcb = parent;
 
     // Relocate kernel stack
     tss.esp0 = pcb->tss_esp;
 
-    // Clear progress flag
-    progress = 0;
+    // Give up the current stack, the parent returns from its execute
+    switch_to(child, parent);
 
-    asm volatile (
-        "movl %0, %%ebp  \n"
-        "movl %1, %%esp  \n"
-        :
-        : "r"(ebp), "r"(esp)
-    );
-    return halt_status;
+    // Should never return at here
+    return -1;
 }
 
 /* Function: sys_open
@@ -404,6 +671,7 @@ int32_t sys_open(const uint8_t* filename)
              *                 - OTHERS: not valid and unused, fill 0.
              *  flags: - ALL SUPPORTED TYPE: FD_FLAG_RTC, FD_FLAG_DIR, or FD_FLAG_FILE.
              *         - OTHERS: won't open, use FD_FLAG_EMPTY.
+             *  status: - O_* flags, cleared on open, changed by ioctl.
              **/
             if (currFileDentry.file_type == FILE_TYPE_RTC)
             {
@@ -412,6 +680,7 @@ int32_t sys_open(const uint8_t* filename)
                 (pcb->file_descriptor)[i].inode = 2;                            // Default Frequency is 2 Hz
                 (pcb->file_descriptor)[i].file_position = 0;
                 (pcb->file_descriptor)[i].flags = FD_FLAG_RTC;
+                (pcb->file_descriptor)[i].status = 0;
             }
             else if(currFileDentry.file_type == FILE_TYPE_DIR)
             {
@@ -420,6 +689,7 @@ int32_t sys_open(const uint8_t* filename)
                 (pcb->file_descriptor)[i].inode = 0;
                 (pcb->file_descriptor)[i].file_position = 0;
                 (pcb->file_descriptor)[i].flags = FD_FLAG_DIR;
+                (pcb->file_descriptor)[i].status = 0;
             }
             else if (currFileDentry.file_type == FILE_TYPE_FILE)
             {
@@ -428,6 +698,7 @@ int32_t sys_open(const uint8_t* filename)
                 (pcb->file_descriptor)[i].inode = currFileDentry.inode_number;
                 (pcb->file_descriptor)[i].file_position = 0;
                 (pcb->file_descriptor)[i].flags = FD_FLAG_FILE;
+                (pcb->file_descriptor)[i].status = 0;
             }
             else
             {
@@ -458,15 +729,55 @@ int32_t sys_close(int32_t fd)
         error_sound();
         return -1;
     }
+    return close_fd(fd);
+}
+
+/* Function: sys_dup2
+ * Description: system call to make newfd refer to the same file as
+ * oldfd, closing newfd first if it is open. Used to put a pipe end on
+ * stdin or stdout before execute or spawn.
+ * Inputs: oldfd - open FD to copy
+ *         newfd - FD to replace, stdin and stdout are allowed
+ * Outputs: return newfd on success, return -1 if newfd is invalid
+ * Side Effects: none
+ */
+int32_t sys_dup2(int32_t oldfd, int32_t newfd)
+{
+    if ((newfd < 0) || (newfd >= FD_COUNT))
+    {
+        printf("<!> Invalid file descriptor index to duplicate to.\n");
+        error_sound();
+        return -1;
+    }
+    if (oldfd == newfd)
+    {
+        return newfd;
+    }
+    close_fd(newfd);
+    (pcb->file_descriptor)[newfd] = (pcb->file_descriptor)[oldfd];
+    return newfd;
+}
+
+/* Function: close_fd
+ * Description: close any FD of the current process through its driver,
+ * sys_close keeps stdin and stdout away from programs
+ * Inputs: fd - int32_t representing index to file desc array
+ * Outputs: return 0 on a successful close, return -1 if already closed
+ * Side Effects: none
+ */
+static int32_t close_fd(int32_t fd)
+{
     if ((pcb->file_descriptor)[fd].flags == FD_FLAG_EMPTY)
     {
         // Already closed
         return -1;
     }
+    (pcb->file_descriptor)[fd].file_op_table_ptr->close(fd);
     (pcb->file_descriptor)[fd].file_op_table_ptr = 0;
     (pcb->file_descriptor)[fd].file_position = 0;
     (pcb->file_descriptor)[fd].inode = 0;
     (pcb->file_descriptor)[fd].flags = FD_FLAG_EMPTY;
+    (pcb->file_descriptor)[fd].status = 0;
     return 0;
 }
 
@@ -482,90 +793,22 @@ int32_t sys_close(int32_t fd)
 int32_t sys_read(int32_t fd, void* buf, int32_t nbytes)
 {
     /* ========= NOTES FOR ARGUMENT AND RETURN VALUE CONVENTIONS -- PL =========
-    *  FD_STDIN: - Accept ECHO in the current terminal.
-    *            - Not based on file_system. Call terminal_read directly.
-    *            - Pass all arguments directly.
-    *            - Return directly outside sys_read.
-    *            - file_position is not available, do nothing.
-    *  FD_STDOUT: - Cannot read from an output stream.
-    *             - Impossible to reach as we do sanity check.
-    *             - Return -1.
-    *  FD_FLAG_RTC: - Decline ECHO in the current terminal.
-    *               - Based on file_system. Call based on FOT (File Operation Table) in FDE (FD Entry).
-    *               - Pass inode in FDE to arg0 as we handle them in VRTC driver.
-    *               - Return directly outside sys_read.
-    *               - file_position is unused, do nothing.
-    *  FD_FLAG_DIR: - Decline ECHO in the current terminal.
-    *               - Based on file_system. Call based on FOT in FDE.
-    *               - Pass file_position in FDE to arg0.
-    *               - Return directly outside sys_read.
-    *               - file_position increase by 1 if not returning 0.
-    *  FD_FLAG_FILE: - Decline ECHO in the current terminal.
-    *                - Based on file_system. Call based on FOT in FDE.
-    *                - Pass file_position in FDE to arg0, inode in FDE to buf[0].
-    *                - Return directly outside sys_read.
-    *                - file_position increase by bytes_read.
-    *  FD_FLAG_EMPTY: - Unopened FDE, why are we reading from it?
-    *                 - Impossible to reach as we do sanity check.
-    *                 - Return -1.
+    *  fd and buf are checked by syscall_dispatch (SC_FD0 | SC_PTR1), so fd is
+    *  always an open FDE here. Every driver is called with the FD index and
+    *  owns the per-FD state in its FDE:
+    *  FD_FLAG_TERMINAL: - stdin accepts ECHO while reading, stdout is not readable.
+    *  FD_FLAG_RTC: - Waits for the VRTC frequency kept in inode.
+    *  FD_FLAG_DIR: - Reads the file # kept in file_position, increase by 1 if not returning 0.
+    *  FD_FLAG_FILE: - Reads inode from file_position, increase by bytes_read.
     **/
     sti();
-    /* Initial sanity checks */ 
-    if (buf == NULL || fd > 7 || fd < 0 || nbytes < 0 || fd == FD_STDOUT)
+    if (nbytes < 0)
     {
         printf("<!> Invalid function parameter for reading.\n");
         error_sound();
         return -1;
     }
-    if ((fd >= 2) && ((pcb->file_descriptor)[fd].flags == FD_FLAG_EMPTY))
-    {
-        printf("<!> File descriptor is not open for reading.\n");
-        error_sound();
-        return -1;
-    }
-
-    /* To hold return values from child syscalls */
-    int32_t bytes_read;
-
-    /* STDIN case */
-    if (fd == FD_STDIN)
-    {
-        terminals[pcb->terminal_id].echo = 1;
-        bytes_read = terminal_read(fd, buf, nbytes);
-        terminals[pcb->terminal_id].echo = 0;
-        return bytes_read;
-    }
-
-    /* FD_FLAG_RTC case */
-    else if ((pcb->file_descriptor)[fd].flags == FD_FLAG_RTC)
-    {
-        bytes_read = (pcb->file_descriptor)[fd].file_op_table_ptr -> read((pcb->file_descriptor)[fd].inode, buf, nbytes);
-        return bytes_read;
-    }
-
-    /* FD_FLAG_DIR case */
-    else if ((pcb->file_descriptor)[fd].flags == FD_FLAG_DIR)
-    {
-        bytes_read = (pcb->file_descriptor)[fd].file_op_table_ptr -> read((pcb->file_descriptor)[fd].file_position, buf, nbytes);
-        (pcb->file_descriptor)[fd].file_position += (bytes_read == 0 ? 0 : 1);
-        return bytes_read;
-    }
-
-    /* FD_FLAG_FILE case */
-    else if ((pcb->file_descriptor)[fd].flags == FD_FLAG_FILE)
-    {
-        if (nbytes == 0) { return 0; }
-        uint8_t inode = (uint8_t) ((pcb->file_descriptor)[fd].inode);
-        ((uint8_t *) buf)[0] = inode;
-        bytes_read = (pcb->file_descriptor)[fd].file_op_table_ptr -> read((pcb->file_descriptor)[fd].file_position, buf, nbytes);
-        (pcb->file_descriptor)[fd].file_position += bytes_read;
-        return bytes_read;
-    }
-
-    /* Should never reach here as we do sanity check in open call */
-    printf("<!> Invalid or unsupported FDE flag for reading.\n");
-    error_sound();
-    return -1;
+    return (pcb->file_descriptor)[fd].file_op_table_ptr -> read(fd, buf, nbytes);
 }
 
 /* Function: sys_write
@@ -579,36 +822,71 @@ int32_t sys_read(int32_t fd, void* buf, int32_t nbytes)
  */
 int32_t sys_write(int32_t fd, const void* buf, int32_t nbytes)
 {
-    // Sanity Checks
-    if (buf == NULL || fd > 7 || fd < 0 || nbytes < 0 || fd == FD_STDIN) /* NULL buffer, out-bound fd, stdin are invalid */
+    // fd and buf are checked by syscall_dispatch (SC_FD0 | SC_PTR1)
+    if (nbytes < 0)
     {
         printf("<!> Invalid function parameter for writing.\n");
         error_sound();
         return -1;
     }
-    if ((fd >= 2) && ((pcb->file_descriptor)[fd].flags == FD_FLAG_EMPTY))
+    return (pcb->file_descriptor)[fd].file_op_table_ptr -> write(fd, buf, nbytes);
+}
+
+/* Function: sys_readv
+ * Description: read a FD into several buffers within one syscall.
+ *              Segments are filled in order, stop at the first short read.
+ * Inputs: fd - int32_t representing index to file desc array
+ *         iov - array of segments to fill
+ *         iovcnt - number of segments, at most IOV_MAX
+ * Outputs: total bytes read, -1 if the first read failed or iov is invalid
+ * Side Effects: none
+ */
+int32_t sys_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    int32_t iov_i, bytes_read, total = 0;
+    struct file_op_ptr_t* fop = (pcb->file_descriptor)[fd].file_op_table_ptr;
+
+    sti();
+    if (check_iovec(iov, iovcnt) == -1) { return -1; }
+
+    for (iov_i = 0; iov_i < iovcnt; iov_i++)
     {
-        printf("<!> File descriptor is not open for writing.\n");
-        error_sound();
-        return -1;
+        if (iov[iov_i].iov_len == 0) { continue; }
+        bytes_read = fop -> read(fd, iov[iov_i].iov_base, iov[iov_i].iov_len);
+        if (bytes_read == -1) { return (total ? total : -1); }
+        total += bytes_read;
+
+        // A short read means the FD has nothing more for now
+        if (bytes_read < iov[iov_i].iov_len) { break; }
     }
+    return total;
+}
 
-    /* Handle STDOUT as a special case as terminal write */
-    if (fd == FD_STDOUT) { return terminal_write(fd, buf, nbytes); }
+/* Function: sys_writev
+ * Description: write several buffers to a FD within one syscall.
+ *              Segments are written in order, stop at the first short write.
+ * Inputs: fd - int32_t representing index to file desc array
+ *         iov - array of segments to write
+ *         iovcnt - number of segments, at most IOV_MAX
+ * Outputs: total bytes written, -1 if the first write failed or iov is invalid
+ * Side Effects: none
+ */
+int32_t sys_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt)
+{
+    int32_t iov_i, bytes_written, total = 0;
+    struct file_op_ptr_t* fop = (pcb->file_descriptor)[fd].file_op_table_ptr;
 
-    /* Handle VRTC as a special case, change inode number as VRTC frequency */
-    if ((pcb->file_descriptor)[fd].flags == FD_FLAG_RTC)
+    if (check_iovec(iov, iovcnt) == -1) { return -1; }
+
+    for (iov_i = 0; iov_i < iovcnt; iov_i++)
     {
-        int rtc_check_return = rtc_write(fd, buf, nbytes);
-        if (!rtc_check_return)
-        {
-            (pcb->file_descriptor)[fd].inode = *((int*) buf);
-        }
-        return rtc_check_return;
+        if (iov[iov_i].iov_len == 0) { continue; }
+        bytes_written = fop -> write(fd, iov[iov_i].iov_base, iov[iov_i].iov_len);
+        if (bytes_written == -1) { return (total ? total : -1); }
+        total += bytes_written;
+        if (bytes_written < iov[iov_i].iov_len) { break; }
     }
-
-    /* fd write call */
-    return (pcb->file_descriptor)[fd].file_op_table_ptr -> write(fd, buf, nbytes);
+    return total;
 }
 
 /* Function: sys_getargs
@@ -658,13 +936,12 @@ int32_t sys_vidmap (uint8_t** screen_start)
     // Modify TI
     terminals[pcb->terminal_id].vidmap = 1;
 
-    // Call the mapper function accordingly
-    if (pcb->terminal_id == terminal_active)
-    {
-        map4KBVidMemPage();
-    }
-    
-    
+    // Map the page of the terminal, shown or not
+    map4KBVidMemPage();
+
+    // The program reads the page itself, show rows still in the ring
+    screen_flush(video_mem);
+
     // Pass the pointer
     *screen_start = (uint8_t *) PROGRAM_STACK_ADDR;
     
@@ -720,6 +997,201 @@ int32_t sys_sigreturn (void)
     return pcb->sig_eax;
 }
 
+/* Function: sys_getpid
+ * Description: Return the PID of the current process. It does no other work,
+ *              so it doubles as the null syscall for measuring entry cost.
+ * Inputs: none
+ * Outputs: PID of the current process
+ * Side Effects: none
+ */
+int32_t sys_getpid (void)
+{
+    return pcb->process_id;
+}
+
+/* Function: sys_poll
+ * Description: system call to wait until one of several FDs is ready.
+ * Every FD is checked through the poll entry of its operations table,
+ * which also joins the wait queues that would change the answer, so one
+ * sleep covers the keyboard, the RTC and pipes together.
+ * Inputs: fds - entries in the program page, revents is filled
+ *         nfds - number of entries, at most FD_COUNT
+ *         timeout - ms to wait, 0 to only check, negative for no limit
+ * Outputs: number of entries with revents set, 0 on timeout, -1 if invalid
+ * Side Effects: none
+ */
+int32_t sys_poll(pollfd_t* fds, int32_t nfds, int32_t timeout)
+{
+    int32_t fd, fd_i, ready;
+    uint32_t deadline = 0;
+    file_desc_t* fde;
+
+    if ((nfds < 0) || (nfds > FD_COUNT) || ((uint32_t) (fds + nfds) > PROGRAM_STACK_ADDR))
+    {
+        printf("<!> Invalid poll array of %d entries.\n", nfds);
+        error_sound();
+        return -1;
+    }
+    if (timeout > 0)
+    {
+        deadline = rtc_deadline(timeout);
+    }
+
+    // Check and join the wait queues with interrupts off, so no wake up is lost
+    cli();
+    while (1)
+    {
+        ready = 0;
+        for (fd_i = 0; fd_i < nfds; fd_i++)
+        {
+            fd = fds[fd_i].fd;
+            fds[fd_i].revents = 0;
+            if (fd < 0)
+            {
+                continue;
+            }
+            fde = &((pcb->file_descriptor)[fd]);
+            if ((fd >= FD_COUNT) || (fde->flags == FD_FLAG_EMPTY))
+            {
+                fds[fd_i].revents = POLLNVAL;
+            }
+            else
+            {
+                fds[fd_i].revents = fde->file_op_table_ptr->poll(fd, timeout != 0) & (fds[fd_i].events | POLLHUP);
+            }
+            if (fds[fd_i].revents)
+            {
+                ready++;
+            }
+        }
+
+        if (ready || (timeout == 0) || ((timeout > 0) && rtc_timer_due(deadline)))
+        {
+            break;
+        }
+        if (timeout > 0)
+        {
+            rtc_timer_wait(deadline);
+        }
+        proc_block();
+    }
+    sti();
+
+    return ready;
+}
+
+/* Function: sys_ioctl
+ * Description: system call to change how a FD behaves. F_GETFL and
+ * F_SETFL read and write the O_* status flags every driver honors, other
+ * requests go to the ioctl entry of the operations table if it has one.
+ * Inputs: fd - int32_t representing index to file desc array
+ *         request - F_* or a driver request such as TCSETMODE
+ *         arg - argument of the request
+ * Outputs: result of the request, -1 if it is not supported
+ * Side Effects: none
+ */
+int32_t sys_ioctl(int32_t fd, uint32_t request, uint32_t arg)
+{
+    // fd is checked by syscall_dispatch (SC_FD0)
+    file_desc_t* fde = &((pcb->file_descriptor)[fd]);
+
+    switch (request)
+    {
+        case F_GETFL:
+            return fde->status;
+        case F_SETFL:
+            if (arg & ~O_NONBLOCK)
+            {
+                printf("<!> Invalid status flags 0x%#x.\n", arg);
+                error_sound();
+                return -1;
+            }
+            fde->status = arg;
+            return 0;
+        default:
+            if (fde->file_op_table_ptr->ioctl == NULL)
+            {
+                printf("<!> FD %d does not support ioctl request %u.\n", fd, request);
+                error_sound();
+                return -1;
+            }
+            return fde->file_op_table_ptr->ioctl(fd, request, arg);
+    }
+}
+
+/* Function: sys_yield
+ * Description: Give the rest of the time slice away. Another process
+ *              of the terminal runs if one may, otherwise the next
+ *              terminal which is started, as on a PIT tick.
+ * Inputs: none
+ * Outputs: 0 once the caller runs again
+ * Side Effects: runs with interrupts off like every syscall
+ */
+int32_t sys_yield(void)
+{
+    pcb_t* next = proc_find_runnable(pcb->terminal_id);
+    unsigned int tid;
+
+    if (next != NULL)
+    {
+        proc_switch(next);
+        return 0;
+    }
+
+    // The same pick as the PIT, which leaves uninitialized terminals alone
+    if (scheduler_enable)
+    {
+        tid = terminal_next(pcb->terminal_id);
+        if (tid != pcb->terminal_id)
+        {
+            resched_terminal(tid);
+            preempt_schedule();
+        }
+    }
+    return 0;
+}
+
+/* Function: sys_vidflush
+ * Description: Copy the rows a double buffered vidmap changed to the
+ *              VRAM page of the terminal, see TCSETVIDBUF.
+ * Inputs: none
+ * Outputs: rows copied, -1 if the vidmap is not double buffered
+ * Side Effects: none
+ */
+int32_t sys_vidflush(void)
+{
+    if (!terminals[pcb->terminal_id].vidbuf)
+    {
+        printf("<!> Vidmap of terminal %u is not double buffered.\n", pcb->terminal_id);
+        error_sound();
+        return -1;
+    }
+    return vidbuf_flush(pcb->terminal_id);
+}
+
+/* Function: sys_setmode
+ * Description: Set a Bochs VBE graphics mode, shown while the terminal
+ *              of the process is, or text mode again with 0, 0, 0.
+ * Inputs: width, height - pixels, bpp - 8, 16 or 32 bits per pixel
+ * Outputs: 0 - success, -1 - failed
+ * Side Effects: the framebuffer is cleared, halt goes back to text mode
+ */
+int32_t sys_setmode(uint32_t width, uint32_t height, uint32_t bpp)
+{
+    return vbe_setmode(width, height, bpp);
+}
+
+/* Function: sys_fbmap
+ * Description: Map the framebuffer of the mode set to 0x8800000
+ * Inputs: fb_start - place to store the mapped framebuffer pointer
+ * Outputs: 0 - success, -1 - failed
+ * Side Effects: the pages are write combining if the CPU has PAT
+ */
+int32_t sys_fbmap(uint8_t** fb_start)
+{
+    return vbe_map(fb_start);
+}
+
 /* Function: sys_invalid
  * Description: print out # for invalid syscall
  * Inputs: callnum - syscall #
@@ -733,25 +1205,150 @@ int32_t sys_invalid(unsigned int callnum)
     return -1;
 }
 
+/* Function: check_syscall_args
+ * Description: check syscall arguments against the SC_* flags of its table entry
+ * Inputs: callnum - syscall #, arg_flags - SC_* flags, arg0 ~ arg2 - arguments
+ * Outputs: 0 - valid, -1 - invalid
+ * Side Effects: print out the error message on screen if invalid. A
+ *               negative byte count is left to the handler to reject.
+ */
+static int32_t check_syscall_args(uint32_t callnum, uint8_t arg_flags, uint32_t arg0, uint32_t arg1, uint32_t arg2)
+{
+    // FD must be in range and already opened
+    if ((arg_flags & SC_FD0) && ((arg0 >= FD_COUNT) || ((pcb->file_descriptor)[arg0].flags == FD_FLAG_EMPTY)))
+    {
+        printf("<!> File descriptor %d is not open for system call #%u.\n", (int32_t) arg0, callnum);
+        error_sound();
+        return -1;
+    }
+
+    // Pointers must stay inside the program page
+    if (((arg_flags & SC_PTR0) && ((arg0 < PROGRAM_PAGE_ADDR) || (arg0 >= PROGRAM_STACK_ADDR))) ||
+        ((arg_flags & SC_PTR1) && ((arg1 < PROGRAM_PAGE_ADDR) || (arg1 >= PROGRAM_STACK_ADDR))))
+    {
+        printf("<!> Invalid pointer parameter for system call #%u.\n", callnum);
+        error_sound();
+        return -1;
+    }
+
+    // So must the last byte of a buffer with a length, without wrapping around
+    if (((arg_flags & SC_LEN1) && ((int32_t) arg1 > 0) && ((arg0 + arg1 < arg0) || (arg0 + arg1 > PROGRAM_STACK_ADDR))) ||
+        ((arg_flags & SC_LEN2) && ((int32_t) arg2 > 0) && ((arg1 + arg2 < arg1) || (arg1 + arg2 > PROGRAM_STACK_ADDR))))
+    {
+        printf("<!> Buffer runs past the program page for system call #%u.\n", callnum);
+        error_sound();
+        return -1;
+    }
+    return 0;
+}
+
+/* Function: check_iovec
+ * Description: check the segment array of readv/writev, the array itself
+ *              and every segment must stay inside the program page
+ * Inputs: iov - segment array, iovcnt - number of segments
+ * Outputs: 0 - valid, -1 - invalid
+ * Side Effects: print out the error message on screen if invalid
+ */
+static int32_t check_iovec(const iovec_t* iov, int32_t iovcnt)
+{
+    int32_t iov_i;
+    uint32_t base;
+
+    if ((iovcnt < 0) || (iovcnt > IOV_MAX) || ((uint32_t) (iov + iovcnt) > PROGRAM_STACK_ADDR))
+    {
+        printf("<!> Invalid segment count %d for vectored I/O.\n", iovcnt);
+        error_sound();
+        return -1;
+    }
+    for (iov_i = 0; iov_i < iovcnt; iov_i++)
+    {
+        base = (uint32_t) iov[iov_i].iov_base;
+        if ((iov[iov_i].iov_len < 0) || (base < PROGRAM_PAGE_ADDR) || (base + iov[iov_i].iov_len > PROGRAM_STACK_ADDR))
+        {
+            printf("<!> Invalid segment %d for vectored I/O.\n", iov_i);
+            error_sound();
+            return -1;
+        }
+    }
+    return 0;
+}
+
 /* Function: find_next_pid
- * Description: find next available pid in pcb pool
+ * Description: find next available pid in pcb pool and reserve it,
+ *              so a program loading with preemption on keeps its PID
  * Inputs: none
  * Outputs: -1 - pcb pool full, int - next available pid
- * Side Effects: none
+ * Side Effects: the PID is reserved until pid_commit()
  */
 int find_next_pid()
 {
     int i;
+    uint32_t flags;
+
+    spin_lock_irqsave(&pcb_lock, flags);
     for (i = 0; i < MAX_PID_COUNT; i++)
     {
-        if (pcb_pool[i] == NULL)
+        if ((pcb_pool[i] == NULL) && !(pid_reserved & (1 << i)))
         {
+            pid_reserved |= (1 << i);
+            spin_unlock_irqrestore(&pcb_lock, flags);
             return i;
         }
     }
+    spin_unlock_irqrestore(&pcb_lock, flags);
     return -1;
 }
 
+/* Function: pid_commit
+ * Description: put the PCB of a reserved PID into the pool
+ * Inputs: pid - PID from find_next_pid()
+ *         pcb_pointer - PCB of the new process, NULL gives the PID back
+ * Outputs: none
+ * Side Effects: the reservation is cleared
+ */
+static void pid_commit(int pid, pcb_t* pcb_pointer)
+{
+    uint32_t flags;
+
+    spin_lock_irqsave(&pcb_lock, flags);
+    if (pcb_pointer != NULL)
+    {
+        pcb_pool[pid] = pcb_pointer;
+    }
+    pid_reserved &= ~(1 << pid);
+    spin_unlock_irqrestore(&pcb_lock, flags);
+}
+
+/* Function: load_program
+ * Description: copy a program into the page of its PID in chunks. The
+ *              scheduler may switch away between chunks, which maps the
+ *              program page of the caller back, so every chunk maps the
+ *              page of the new program again.
+ * Inputs: pid - PID of the new program, inode - inode of the program
+ *         size - program size, preemptible - allow switching between chunks
+ * Outputs: none
+ * Side Effects: call with interrupts off, returns with the page of pid mapped
+ */
+static void load_program(int pid, uint32_t inode, int32_t size, uint8_t preemptible)
+{
+    int32_t offset;
+
+    for (offset = 0; offset < size; offset += LOAD_CHUNK_SIZE)
+    {
+        // No switch may map another page while the chunk is copied
+        preempt_disable();
+        reMap4MBPage(pid);
+        read_data(inode, offset, (uint8_t*) PROGRAM_PAGE_ADDR + offset, min(LOAD_CHUNK_SIZE, size - offset));
+        preempt_enable();
+
+        if (preemptible)
+        {
+            cond_resched();
+        }
+    }
+    reMap4MBPage(pid);
+}
+
 /* Function: play_sound
  * Description: play sound at specific frequency and duration
  * Inputs: frequency - sound frequency
@@ -11,10 +11,45 @@
 // Syscall Vector Index on IDT
 #define SYSCALL_INDEX 0x80
 
+// Largest valid syscall #
+#define SYSCALL_MAX 24
+
+// Syscall #, same as ece391sysnum.h for programs
+#define SYS_HALT        1
+#define SYS_EXECUTE     2
+#define SYS_READ        3
+#define SYS_WRITE       4
+#define SYS_OPEN        5
+#define SYS_CLOSE       6
+#define SYS_GETARGS     7
+#define SYS_VIDMAP      8
+#define SYS_SET_HANDLER 9
+#define SYS_SIGRETURN   10
+#define SYS_GETPID      11
+#define SYS_READV       12
+#define SYS_WRITEV      13
+#define SYS_RING_SETUP  14
+#define SYS_RING_ENTER  15
+#define SYS_PIPE        16
+#define SYS_DUP2        17
+#define SYS_SPAWN       18
+#define SYS_POLL        19
+#define SYS_IOCTL       20
+#define SYS_YIELD       21
+#define SYS_VIDFLUSH    22
+#define SYS_SETMODE     23
+#define SYS_FBMAP       24
+
+// CPUID leaf 1 EDX bit for SYSENTER/SYSEXIT support
+#define CPUID_SEP_BIT 11
+
 // Program Load, Stack Address
 #define PROGRAM_PAGE_ADDR 0x08048000
 #define PROGRAM_STACK_ADDR 0x08400000
 
+// Bytes of a program copied between two preemption points
+#define LOAD_CHUNK_SIZE 4096
+
 // Kernel Stack Address, Offset
 #define KERNEL_STACK_ADDR 0x00800000
 #define KERNEL_STACK_OFFSET 0x2000
@@ -22,12 +57,46 @@
 // FD #
 #define FD_STDIN 0
 #define FD_STDOUT 1
+#define FD_COUNT 8
 
 // FD Flags
 #define FD_FLAG_EMPTY 0
 #define FD_FLAG_RTC 1
 #define FD_FLAG_DIR 2
 #define FD_FLAG_FILE 3
+#define FD_FLAG_TERMINAL 4
+#define FD_FLAG_PIPE 5
+
+// Poll events, returned by the poll entry of each FD operations table
+#define POLLIN   0x01   // Read will not wait
+#define POLLOUT  0x04   // Write will not wait
+#define POLLHUP  0x10   // Other end of a pipe is closed
+#define POLLNVAL 0x20   // FD is not open
+
+// FD status flags, kept in the status of each FDE
+#define O_NONBLOCK 0x1  // Read and write return at once instead of waiting
+
+// ioctl requests, F_* apply to any FD, the others go to the driver
+#define F_GETFL      1  // Return the O_* status flags
+#define F_SETFL      2  // Replace the O_* status flags with arg
+#define TCGETMODE    3  // stdin: return the TERM_* mode
+#define TCSETMODE    4  // stdin: set the TERM_* mode to arg
+#define TCSETTIMEOUT 5  // stdin: give up reading after arg ms, 0 waits forever
+#define TCGETLOST    6  // stdin: return the keys dropped since boot
+#define TCSETVIDBUF  7  // stdin: arg 1 draws vidmap in RAM until vidflush, 0 in VRAM
+#define TCSETSERIAL  8  // stdin: arg 1 mirrors the terminal to COM1, 0 stops, return the old one
+#define TCGETSERIAL  9  // stdin: return the bytes COM1 has yet to send, -1 without one
+
+// Syscall argument flags, checked by syscall_dispatch before the handler runs
+#define SC_FD0  0x01    // arg0 is a FD index which must be open
+#define SC_PTR0 0x02    // arg0 is a pointer into the program page
+#define SC_PTR1 0x04    // arg1 is a pointer into the program page
+#define SC_LEN1 0x08    // arg1 is the byte count of the arg0 buffer, which must end there too
+#define SC_LEN2 0x10    // arg2 is the byte count of the arg1 buffer, which must end there too
+#define SC_RING 0x80    // May be submitted through the ring, not an argument check
+
+// Maximum segments in one readv/writev call
+#define IOV_MAX 16
 
 // Maximum Command Length
 #define MAX_CMD_LEN 31
@@ -43,23 +112,57 @@
 #include "terminal.h"
 #include "keyboard.h"
 #include "signals.h"
+#include "ring.h"
+#include "pipe.h"
+#include "softirq.h"
+#include "spinlock.h"
+
+// Syscall table entry, handler is called with all three argument registers
+typedef int32_t (*syscall_handler_t)(uint32_t arg0, uint32_t arg1, uint32_t arg2);
+typedef struct syscall_entry_t
+{
+    syscall_handler_t handler;          // Syscall Handler
+    uint8_t nargs;                      // Arguments used, the rest are passed as 0
+    uint8_t arg_flags;                  // SC_* Argument Flags
+} syscall_entry_t;
+
+// Segment of a readv/writev call
+typedef struct iovec_t
+{
+    void* iov_base;                     // Segment Buffer
+    int32_t iov_len;                    // Segment Length in Bytes
+} iovec_t;
+
+// Entry of a poll call
+typedef struct pollfd_t
+{
+    int32_t fd;                         // FD to check, ignored if negative
+    int16_t events;                     // POLLIN and/or POLLOUT wanted
+    int16_t revents;                    // Events found, set by poll
+} pollfd_t;
 
 // Global Variables
 // PCB of current process
 struct pcb_t* pcb;
 
-// In Progress Flag
-volatile uint8_t progress;
-
 // Used by halt-execution return routine
 int32_t halt_status;
 
 // PCB pool for execute to find next available PID
 struct pcb_t* pcb_pool[MAX_PID_COUNT];
 
+// Validate the arguments and call the syscall through the syscall table
+extern int32_t syscall_dispatch(uint32_t callnum, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+
+// Dispatch a syscall submitted through the ring, only SC_RING entries are allowed
+extern int32_t syscall_ring_dispatch(uint32_t callnum, uint32_t arg0, uint32_t arg1, uint32_t arg2);
+
 // Takes input command and execute the corresponding program
 extern int32_t sys_execute(const uint8_t* command);
 
+// Start a program without waiting for it, it runs when the caller blocks
+extern int32_t sys_spawn(const uint8_t* command);
+
 // Takes status command and halt the program
 extern int32_t sys_halt(uint8_t status);
 
@@ -69,12 +172,21 @@ extern int32_t sys_open(const uint8_t* filename);
 // System call for closing a file
 extern int32_t sys_close(int32_t fd);
 
+// Make newfd refer to what oldfd refers to
+extern int32_t sys_dup2(int32_t oldfd, int32_t newfd);
+
 // System call for read a file
 extern int32_t sys_read(int32_t fd, void* buf, int32_t nbytes);
 
 // System call for write a file
 extern int32_t sys_write(int32_t fd, const void* buf, int32_t nbytes);
 
+// Read a FD into several buffers in one call
+extern int32_t sys_readv(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
+// Write several buffers to a FD in one call
+extern int32_t sys_writev(int32_t fd, const iovec_t* iov, int32_t iovcnt);
+
 // Get the trimmed argument after the command name
 extern int32_t sys_getargs(uint8_t* buf, int32_t nbytes);
 
@@ -87,6 +199,27 @@ extern int32_t sys_set_handler(int32_t signum, void* handler_address);
 // Return from user space signal handler
 extern int32_t sys_sigreturn(void);
 
+// Return the PID of the current process, also used as the null syscall
+extern int32_t sys_getpid(void);
+
+// Wait until one of several FDs is ready, or the timeout in ms passes
+extern int32_t sys_poll(pollfd_t* fds, int32_t nfds, int32_t timeout);
+
+// Get or set FD status flags, or pass a request to the driver
+extern int32_t sys_ioctl(int32_t fd, uint32_t request, uint32_t arg);
+
+// Give the rest of the time slice to the next process which may run
+extern int32_t sys_yield(void);
+
+// Copy the rows a double buffered vidmap changed to VRAM
+extern int32_t sys_vidflush(void);
+
+// Set a graphics mode, or text mode again with 0, 0, 0
+extern int32_t sys_setmode(uint32_t width, uint32_t height, uint32_t bpp);
+
+// Map the framebuffer of the mode set to 0x8800000
+extern int32_t sys_fbmap(uint8_t** fb_start);
+
 // Print out # for invalid syscall
 extern int32_t sys_invalid(unsigned int callnum);
 
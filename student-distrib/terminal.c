@@ -6,63 +6,89 @@
  */
 
 #include "terminal.h"
+#include "vidbuf.h"
+#include "palloc.h"
+#include "serial.h"
+
+// Keyboard input ring, written by the keyboard IRQ and read by
+// terminal_read without another copy. Indexes run freely.
+// [head, commit) is readable, [commit, tail) is the line being typed.
+// The IRQ only moves commit and tail, readers only move head.
+typedef struct input_ring_t
+{
+    volatile uint32_t head;             // Next byte to read
+    volatile uint32_t commit;           // End of the finished lines
+    volatile uint32_t tail;             // End of the line being typed
+    uint32_t keys;                      // Keys taken since boot
+    uint32_t lost;                      // Keys dropped, ring or line was full
+    unsigned char buf[KEYBOARD_RING_SIZE];
+} input_ring_t;
+
+// File-scope helper functions
+// Helper function to drop all input of a terminal
+static void input_flush(uint8_t terminal_id);
 
 // File-scope variables
-// Local terminal buffer
-// Altered by copy_buffer
-static unsigned char buf_local[3][KEYBOARD_BUFFER_SIZE];
-static unsigned int buf_ready[3];
-static unsigned int buf_size_in[3];
+// Keyboard input of each terminal, a page taken when it is created
+static input_ring_t* input[TERMINAL_COUNT];
+
+// Readers and pollers waiting for a line
+static wait_queue_t line_wq[TERMINAL_COUNT];
+
+// Read timeout in ms and the PID which set it or the mode
+// Altered by terminal_ioctl
+static uint32_t read_timeout[TERMINAL_COUNT];
+static uint32_t mode_pid[TERMINAL_COUNT];
 
 /* 
  * terminal_open
- *   DESCRIPTION: Initialize the local terminal buffer.
+ *   DESCRIPTION: Initialize the keyboard input ring.
  *                Modified in CP5 to support scheduler.
  *   INPUTS: filename - used to pass terminal ID
  *           if NULL, initialize all terminals.
  *   OUTPUTS: none
  *   RETURN VALUE: 0 - success
- *   SIDE EFFECTS: Local terminal buffer will be reinitialized.
+ *   SIDE EFFECTS: Typed input will be dropped.
  *                 Not enforced double calls, can be called
  *                 multiple times to initialize the buffer.
  */
 int32_t terminal_open(const uint8_t* filename)
 {
+    uint8_t terminal_id;
+
     if (filename == NULL)
     {
-        memset(&buf_local[0][0], '\0', sizeof(KEYBOARD_BUFFER_SIZE));
-        buf_ready[0] = 0;
-        buf_size_in[0] = 0;
-        memset(&buf_local[1][0], '\0', sizeof(KEYBOARD_BUFFER_SIZE));
-        buf_ready[1] = 0;
-        buf_size_in[1] = 0;
-        memset(&buf_local[2][0], '\0', sizeof(KEYBOARD_BUFFER_SIZE));
-        buf_ready[2] = 0;
-        buf_size_in[2] = 0;
+        for (terminal_id = 0; terminal_id < TERMINAL_COUNT; terminal_id++)
+        {
+            input_flush(terminal_id);
+        }
     }
     else
     {
-        memset(&(buf_local[*filename][0]), '\0', sizeof(KEYBOARD_BUFFER_SIZE));
-        buf_ready[*filename] = 0;
-        buf_size_in[*filename] = 0;
+        input_flush(*filename);
     }
     return 0;
 }
 
 /* 
  * terminal_read
- *   DESCRIPTION: Read the keyboard buffer until a new line
- *                character was detected.
+ *   DESCRIPTION: Read the next line from the input ring, without
+ *                the new line character. In cbreak and raw mode
+ *                every key is readable as soon as it is typed.
  *   INPUTS: n - number of bytes should be written to buf
- *           fd - ignored
+ *           fd - O_NONBLOCK in its status returns at once
  *   OUTPUTS: buf - buffer to write
  *            WARNING! The actual size of this buffer should
  *            always larger then specified n.
  *   RETURN VALUE: int32_t - number of bytes actually written to buf
+ *                 0 - nothing typed before the timeout
  *                 -1 - failed
- *   SIDE EFFECTS: Local terminal buffer will be reinitialized.
+ *   SIDE EFFECTS: The bytes read are consumed from the input ring,
+ *                 the rest of a long line and lines typed ahead stay
+ *                 for the next read.
+ *                 Other processes run while waiting.
  */
-int32_t terminal_read(int32_t fd, void* buf, uint32_t n)
+int32_t terminal_read(int32_t fd, void* buf, int32_t n)
 {
     // Parameter safe check
     if (buf == NULL)
@@ -78,14 +104,55 @@ int32_t terminal_read(int32_t fd, void* buf, uint32_t n)
     //    return -1;
     }
 
-    // Reset terminal local buf by reopening
-    terminal_open(&(pcb->terminal_id));
+    // Sleep until a line is finished, the timeout passes,
+    // or not at all with O_NONBLOCK.
+    uint8_t terminal_id = pcb->terminal_id;
+    input_ring_t* in = input[terminal_id];
+    uint8_t nonblock = (pcb->file_descriptor)[fd].status & O_NONBLOCK;
+    uint32_t timeout = read_timeout[terminal_id];
+    uint32_t deadline = rtc_deadline(timeout);
+    cli();
+    terminals[terminal_id].echo = 1;
+    while ((in->head == in->commit) && !nonblock)
+    {
+        if (timeout && rtc_timer_due(deadline))
+        {
+            break;
+        }
+        poll_wait(&line_wq[terminal_id]);
+        if (timeout)
+        {
+            rtc_timer_wait(deadline);
+        }
+        proc_block();
+    }
+    terminals[terminal_id].echo = 0;
+    sti();
 
-    // Spin and wait, when buf is ready, copy buf
-    while(!buf_ready[pcb->terminal_id]);
-    memcpy(buf, &(buf_local[pcb->terminal_id][0]), min(buf_size_in[pcb->terminal_id], n));
+    // The keyboard IRQ only appends behind commit, so copy without cli
+    uint32_t head = in->head;
+    uint32_t commit = in->commit;
+    int32_t count = 0;
+    unsigned char key;
+    while ((head != commit) && (count < n))
+    {
+        key = in->buf[head & KEYBOARD_RING_MASK];
+        if ((key == '\n') && (terminals[terminal_id].mode == TERM_COOKED))
+        {
+            break;
+        }
+        ((unsigned char*) buf)[count++] = key;
+        head++;
+    }
 
-    return (int32_t) min(buf_size_in[pcb->terminal_id], n);
+    // The line is complete, consume its new line too
+    if ((head != commit) && (in->buf[head & KEYBOARD_RING_MASK] == '\n') && (terminals[terminal_id].mode == TERM_COOKED))
+    {
+        head++;
+    }
+    in->head = head;
+
+    return count;
 }
 
 /* 
@@ -96,16 +163,14 @@ int32_t terminal_read(int32_t fd, void* buf, uint32_t n)
  *           fd - ignored
  *           WARNING! The actual size of this buffer should
  *           always larger than specified n.
- *           WARNING! n is unsigned. This means passing a
- *           negative value will be treated as a extreme large
- *           value and is possible to crash the driver (and
- *           will crash the kernel)!
  *   OUTPUTS: none
  *   RETURN VALUE: int32_t - number of bytes actually written to screen
  *                 -1 - failed
- *   SIDE EFFECTS: Supplied buf will be written to screen.
+ *   SIDE EFFECTS: Supplied buf will be written to screen. ANSI
+ *                 escape sequences move the cursor, erase, scroll
+ *                 and set colors, see putbuf_ansi.
  */
-int32_t terminal_write(int32_t fd, const void* buf, uint32_t n)
+int32_t terminal_write(int32_t fd, const void* buf, int32_t n)
 {
     // Parameter safe check
     if (buf == NULL)
@@ -115,14 +180,185 @@ int32_t terminal_write(int32_t fd, const void* buf, uint32_t n)
     }
     // Unfortunately, there are no good way to check buf's actual size...
 
-    // Loop and print requested buffer
-    int i;
-    for (i = 0; i < n; i++)
+    return putbuf_ansi((const uint8_t*) buf, n, &terminals[pcb->terminal_id].ansi);
+}
+
+/* 
+ * terminal_poll
+ *   DESCRIPTION: Poll entry of stdin. Readable when a line is ready,
+ *                or any key in cbreak and raw mode.
+ *   INPUTS: fd - ignored
+ *           wait - join the wait queue for a line
+ *   OUTPUTS: none
+ *   RETURN VALUE: POLLIN if a line is ready, 0 otherwise
+ *   SIDE EFFECTS: none
+ */
+int32_t terminal_poll(int32_t fd, uint8_t wait)
+{
+    uint8_t terminal_id = pcb->terminal_id;
+
+    if (input[terminal_id]->head != input[terminal_id]->commit)
+    {
+        return POLLIN;
+    }
+    if (wait)
     {
-        putc(*((unsigned char*) buf + i));
+        poll_wait(&line_wq[terminal_id]);
     }
+    return 0;
+}
 
-    return n;
+/* 
+ * terminal_poll_out
+ *   DESCRIPTION: Poll entry of stdout, writes never wait.
+ *   INPUTS: ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: POLLOUT
+ *   SIDE EFFECTS: none
+ */
+int32_t terminal_poll_out(int32_t fd, uint8_t wait)
+{
+    return POLLOUT;
+}
+
+/* 
+ * terminal_ioctl
+ *   DESCRIPTION: ioctl entry of stdin. Switches between line mode
+ *                and cbreak or raw mode, and sets the read timeout.
+ *                Both last until the program which set them halts.
+ *                TCGETLOST tells how many keys were dropped.
+ *                TCSETSERIAL mirrors the terminal to COM1, and
+ *                TCGETSERIAL tells how many bytes wait to be sent.
+ *   INPUTS: fd - ignored
+ *           request - TCGETMODE, TCSETMODE, TCSETTIMEOUT, TCGETLOST,
+ *                     TCSETVIDBUF, TCSETSERIAL or TCGETSERIAL
+ *           arg - TERM_* mode, timeout in ms, or 1 / 0 to turn on / off
+ *   OUTPUTS: none
+ *   RETURN VALUE: mode for TCGETMODE, count for TCGETLOST and
+ *                 TCGETSERIAL, the old setting for TCSETSERIAL,
+ *                 0 - success, -1 - failed
+ *   SIDE EFFECTS: Changing the mode drops the input typed so far.
+ */
+int32_t terminal_ioctl(int32_t fd, uint32_t request, uint32_t arg)
+{
+    uint8_t terminal_id = pcb->terminal_id;
+
+    switch (request)
+    {
+        case TCGETMODE:
+            return terminals[terminal_id].mode;
+
+        case TCSETMODE:
+            if (arg > TERM_RAW)
+            {
+                printf("terminal_ioctl: Mode %u is not valid.\n", arg);
+                return -1;
+            }
+            // Input typed for the other mode is meaningless
+            cli();
+            terminals[terminal_id].mode = arg;
+            input_flush(terminal_id);
+            sti();
+            mode_pid[terminal_id] = pcb->process_id;
+            return 0;
+
+        case TCSETTIMEOUT:
+            read_timeout[terminal_id] = arg;
+            mode_pid[terminal_id] = pcb->process_id;
+            return 0;
+
+        case TCGETLOST:
+            return input[terminal_id]->lost;
+
+        case TCSETVIDBUF:
+            if (arg > 1)
+            {
+                printf("terminal_ioctl: Vidmap buffering %u is not valid.\n", arg);
+                return -1;
+            }
+            return vidbuf_set(terminal_id, arg);
+
+        case TCSETSERIAL:
+            if (arg > 1)
+            {
+                printf("terminal_ioctl: Serial mirror %u is not valid.\n", arg);
+                return -1;
+            }
+            return serial_mirror(terminal_id, arg);
+
+        case TCGETSERIAL:
+            return serial_pending();
+
+        default:
+            printf("terminal_ioctl: Request %u is not supported.\n", request);
+            return -1;
+    }
+}
+
+/* 
+ * terminal_release
+ *   DESCRIPTION: Called by halt. If the current program changed
+ *                the mode or timeout of its terminal, go back to
+ *                line mode without timeout for the shell. Colors
+ *                and the scroll region set by escape sequences
+ *                are reset when an executed program halts.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Keys left by a cbreak or raw mode program are
+ *                 dropped.
+ */
+void terminal_release(void)
+{
+    uint8_t terminal_id = pcb->terminal_id;
+
+    // Colors and a scroll region are left by the foreground program,
+    // spawned jobs run beside it
+    if (!pcb->spawned)
+    {
+        ansi_reset(&terminals[terminal_id].ansi);
+    }
+
+    if (mode_pid[terminal_id] != pcb->process_id)
+    {
+        return;
+    }
+    read_timeout[terminal_id] = 0;
+    if (terminals[terminal_id].mode != TERM_COOKED)
+    {
+        cli();
+        terminals[terminal_id].mode = TERM_COOKED;
+        input_flush(terminal_id);
+        sti();
+    }
+}
+
+/* 
+ * terminal_read_invalid
+ *   DESCRIPTION: Read entry of stdout, which is not readable.
+ *   INPUTS: ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1
+ *   SIDE EFFECTS: none
+ */
+int32_t terminal_read_invalid(int32_t fd, void* buf, int32_t n)
+{
+    printf("terminal_read: Cannot read from stdout.\n");
+    return -1;
+}
+
+/* 
+ * terminal_write_invalid
+ *   DESCRIPTION: Write entry of stdin, which is not writable.
+ *   INPUTS: ignored
+ *   OUTPUTS: none
+ *   RETURN VALUE: -1
+ *   SIDE EFFECTS: none
+ */
+int32_t terminal_write_invalid(int32_t fd, const void* buf, int32_t n)
+{
+    printf("terminal_write: Cannot write to stdin.\n");
+    return -1;
 }
 
 /* 
@@ -161,32 +397,143 @@ void enable_cursor(uint8_t cursor_start, uint8_t cursor_end)
 }
 
 /* 
- * copy_buffer
- *   DESCRIPTION: Copy the supplied external buffer.
- *                Modified in CP5 to support scheduler.
- *   INPUTS: size - number of bytes should be copied
- *           buf - buffer to copy
- *           terminal_id - terminal buffer ID
+ * terminal_put_key
+ *   DESCRIPTION: Append a key to the input ring. In line mode it
+ *                joins the line being typed and a new line makes
+ *                the line readable, in cbreak and raw mode it is
+ *                readable at once.
+ *   INPUTS: key - character typed
+ *           terminal_id - terminal ID
  *           NOTE: this function is called exclusively by
- *           keyboard driver. Its size will not exceed 128,
- *           and the buf size will always be 128.
+ *           keyboard driver.
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 - taken, -1 - dropped
+ *   SIDE EFFECTS: Readers are woken once the key is readable.
+ *                 Keys are dropped if the ring is full, or if the
+ *                 line has KEYBOARD_BUFFER_SIZE characters.
+ */
+int32_t terminal_put_key(unsigned char key, uint8_t terminal_id)
+{
+    input_ring_t* in = input[terminal_id];
+    uint8_t cooked = (terminals[terminal_id].mode == TERM_COOKED);
+
+    if (in == NULL)
+    {
+        return -1;
+    }
+    if ((in->tail - in->head) == KEYBOARD_RING_SIZE)
+    {
+        in->lost++;
+        return -1;
+    }
+    if (cooked && (key != '\n') && ((in->tail - in->commit) >= KEYBOARD_BUFFER_SIZE))
+    {
+        in->lost++;
+        return -1;
+    }
+
+    in->buf[in->tail & KEYBOARD_RING_MASK] = key;
+    in->tail++;
+    in->keys++;
+    if (!cooked || (key == '\n'))
+    {
+        in->commit = in->tail;
+        wake_up(&line_wq[terminal_id]);
+    }
+    return 0;
+}
+
+/* 
+ * terminal_erase_key
+ *   DESCRIPTION: Remove the last key of the line being typed,
+ *                for backspace in line mode.
+ *   INPUTS: terminal_id - terminal ID
+ *   OUTPUTS: none
+ *   RETURN VALUE: key removed, 0 if the line is empty
+ *   SIDE EFFECTS: none
+ */
+unsigned char terminal_erase_key(uint8_t terminal_id)
+{
+    input_ring_t* in = input[terminal_id];
+
+    if ((in == NULL) || (in->tail == in->commit))
+    {
+        return 0;
+    }
+    in->tail--;
+    return in->buf[in->tail & KEYBOARD_RING_MASK];
+}
+
+/* 
+ * terminal_drop_line
+ *   DESCRIPTION: Drop the line being typed, finished lines stay.
+ *   INPUTS: terminal_id - terminal ID
  *   OUTPUTS: none
  *   RETURN VALUE: none
- *   SIDE EFFECTS: Local buf will be replaced with the supplied buf.
+ *   SIDE EFFECTS: none
  */
-void copy_buffer(unsigned char* buf, unsigned int size, uint8_t terminal_id)
+void terminal_drop_line(uint8_t terminal_id)
 {
-    // Parameter safe check
-    if (buf == NULL)
+    if (input[terminal_id] == NULL)
+    {
+        return;
+    }
+    input[terminal_id]->tail = input[terminal_id]->commit;
+}
+
+/* 
+ * terminal_input_stats
+ *   DESCRIPTION: Keys taken and dropped by a terminal since boot,
+ *                shown by the process manager.
+ *   INPUTS: terminal_id - terminal ID
+ *   OUTPUTS: keys - keys taken, lost - keys dropped
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void terminal_input_stats(uint8_t terminal_id, uint32_t* keys, uint32_t* lost)
+{
+    if (input[terminal_id] == NULL)
     {
-        printf("copy_buffer: Input buf pointer is not valid.\n");
-        buf_ready[terminal_id] = 1;
+        *keys = 0;
+        *lost = 0;
         return;
     }
+    *keys = input[terminal_id]->keys;
+    *lost = input[terminal_id]->lost;
+}
+
+/* 
+ * terminal_input_alloc
+ *   DESCRIPTION: Take a page for the input ring of a terminal,
+ *                called when the terminal is created.
+ *   INPUTS: terminal_id - terminal ID
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 - success, -1 - no memory
+ *   SIDE EFFECTS: none if the terminal has a ring already
+ */
+int32_t terminal_input_alloc(uint8_t terminal_id)
+{
+    if (input[terminal_id] == NULL)
+    {
+        input[terminal_id] = page_alloc(1);
+    }
+    return (input[terminal_id] == NULL) ? -1 : 0;
+}
 
-    // Copy the buffer
-    buf_size_in[terminal_id] = size;
-    memcpy(&(buf_local[terminal_id][0]), buf, buf_size_in[terminal_id]);
-    buf_ready[terminal_id] = 1;
-    return;
+/* 
+ * input_flush
+ *   DESCRIPTION: Drop all input of a terminal, typed ahead or not.
+ *   INPUTS: terminal_id - terminal ID
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: call with interrupts off
+ */
+static void input_flush(uint8_t terminal_id)
+{
+    if (input[terminal_id] == NULL)
+    {
+        return;
+    }
+    input[terminal_id]->commit = input[terminal_id]->tail;
+    input[terminal_id]->head = input[terminal_id]->tail;
 }
@@ -12,18 +12,48 @@
 #define CURSOR_END   15
 #define KEYBOARD_BUFFER_SIZE 128
 
+// Keyboard input ring of each terminal, must be power of 2
+#define KEYBOARD_RING_SIZE 1024
+#define KEYBOARD_RING_MASK (KEYBOARD_RING_SIZE - 1)
+
+// Input modes of stdin, set by the TCSETMODE ioctl
+#define TERM_COOKED 0   // Line editing, read returns whole lines
+#define TERM_CBREAK 1   // Every key is readable at once, still echoed
+#define TERM_RAW    2   // Every key is readable at once, not echoed
+
 #ifndef ASM
 
 #include "lib.h"
 
-// Initialize the local terminal buffer.
+// Initialize the keyboard input ring.
 extern int32_t terminal_open();
 
-// Read the keyboard buffer until a new line character was detected.
-extern int32_t terminal_read(int32_t fd, void* buf, uint32_t n);
+// Take a page for the input ring of a new terminal.
+extern int32_t terminal_input_alloc(uint8_t terminal_id);
+
+// Read the next line typed, or the keys typed in cbreak and raw mode.
+extern int32_t terminal_read(int32_t fd, void* buf, int32_t n);
 
 // Write the supplied buf to screen.
-extern int32_t terminal_write(int32_t fd, const void* buf, uint32_t n);
+extern int32_t terminal_write(int32_t fd, const void* buf, int32_t n);
+
+// Reject reading from stdout.
+extern int32_t terminal_read_invalid(int32_t fd, void* buf, int32_t n);
+
+// Reject writing to stdin.
+extern int32_t terminal_write_invalid(int32_t fd, const void* buf, int32_t n);
+
+// Tell if a line is ready on stdin.
+extern int32_t terminal_poll(int32_t fd, uint8_t wait);
+
+// stdout is always writable.
+extern int32_t terminal_poll_out(int32_t fd, uint8_t wait);
+
+// Set the input mode or read timeout of stdin.
+extern int32_t terminal_ioctl(int32_t fd, uint32_t request, uint32_t arg);
+
+// Restore the line mode if the current program changed it.
+extern void terminal_release(void);
 
 // Do nothing.
 extern int32_t terminal_close(int32_t fd);
@@ -31,8 +61,17 @@ extern int32_t terminal_close(int32_t fd);
 // Enables the cursor.
 extern void enable_cursor(uint8_t cursor_start, uint8_t cursor_end);
 
-// Copy the supplied external buffer.
-extern void copy_buffer(unsigned char* buf, unsigned int size, uint8_t terminal_id);
+// Append a typed key to the input ring.
+extern int32_t terminal_put_key(unsigned char key, uint8_t terminal_id);
+
+// Remove the last key of the line being typed.
+extern unsigned char terminal_erase_key(uint8_t terminal_id);
+
+// Drop the line being typed.
+extern void terminal_drop_line(uint8_t terminal_id);
+
+// Keys taken and dropped since boot.
+extern void terminal_input_stats(uint8_t terminal_id, uint32_t* keys, uint32_t* lost);
 
 #endif /* ASM */
 #endif /* _TERMINAL_H */
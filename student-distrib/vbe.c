@@ -0,0 +1,447 @@
+/**
+ *  vbe.c - Bochs VBE linear framebuffer
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: Bochs vbe.h, QEMU hw/display/vga.c, OSDev
+ */
+
+#include "vbe.h"
+#include "vidbuf.h"
+
+// Physical framebuffer, 0 if there is no Bochs VBE card
+static uint32_t vbe_lfb = 0;
+static uint8_t vbe_probed = 0;
+
+// Mode set by a process, fb_pid is -1 in text mode
+static int32_t fb_pid = -1;
+static uint32_t fb_tid = 0;
+static uint32_t fb_width = 0;
+static uint32_t fb_height = 0;
+static uint32_t fb_bpp = 0;
+static uint8_t fb_shown = 0;
+
+// Text mode to come back to, and the text pages while it is not shown
+static vga_state_t vga_text;
+static uint8_t text_ram[FB_TEXT_PAGES][VIDEO_MEM_BYTES] __attribute__((aligned(VIDEO_MEM_BYTES)));
+
+// VRAM page each view mapped before, 0 if it was in RAM
+static uint32_t text_phys[VIDEO_VIEW_COUNT];
+
+static void vbe_write(uint32_t reg, uint32_t val)
+{
+    outw(reg, VBE_INDEX_PORT);
+    outw(val, VBE_DATA_PORT);
+}
+
+static uint32_t vbe_read(uint32_t reg)
+{
+    outw(reg, VBE_INDEX_PORT);
+    return inw(VBE_DATA_PORT);
+}
+
+/*
+ * vbe_probe
+ *   DESCRIPTION: Look for a Bochs VBE card and its framebuffer once.
+ *                Sets PAT entry 1 to write combining for its pages.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: 1 if there is a framebuffer, 0 if not
+ *   SIDE EFFECTS: Scans the devices on PCI bus 0.
+ */
+static int32_t vbe_probe(void)
+{
+    uint32_t id, dev, eax, ebx, ecx, edx, low, high;
+
+    if (vbe_probed)
+    {
+        return (vbe_lfb != 0);
+    }
+    vbe_probed = 1;
+
+    id = vbe_read(VBE_REG_ID);
+    if (id < VBE_ID2 || id > VBE_ID_MAX)
+    {
+        return 0;
+    }
+
+    for (dev = 0; dev < PCI_DEVICE_COUNT; dev++)
+    {
+        outl(PCI_CONFIG_ENABLE | (dev << 11), PCI_CONFIG_ADDRESS);
+        if (inl(PCI_CONFIG_DATA) == VBE_PCI_ID)
+        {
+            outl(PCI_CONFIG_ENABLE | (dev << 11) | PCI_BAR0, PCI_CONFIG_ADDRESS);
+            vbe_lfb = inl(PCI_CONFIG_DATA) & PCI_BAR_MEM_MASK;
+            break;
+        }
+    }
+
+    // Pages with only PWT set are write through without PAT
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (vbe_lfb != 0 && (edx & CPUID_PAT))
+    {
+        rdmsr(PAT_MSR, low, high);
+        low = (low & ~PAT_ENTRY1_MASK) | PAT_ENTRY1_WC;
+        asm volatile ("wbinvd" : : : "memory");
+        wrmsr(PAT_MSR, low, high);
+        flushTLB();
+    }
+    return (vbe_lfb != 0);
+}
+
+/*
+ * vga_save
+ *   DESCRIPTION: Read the VGA registers and palette.
+ *   INPUTS: st - where to keep them
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+static void vga_save(vga_state_t* st)
+{
+    uint32_t i;
+
+    st->misc = inb(VGA_MISC_READ);
+    for (i = 0; i < VGA_SEQ_COUNT; i++)
+    {
+        outb(i, VGA_SEQ_INDEX);
+        st->seq[i] = inb(VGA_SEQ_DATA);
+    }
+    for (i = 0; i < VGA_CRTC_COUNT; i++)
+    {
+        outb(i, VGA_CRTC_INDEX);
+        st->crtc[i] = inb(VGA_CRTC_DATA);
+    }
+    for (i = 0; i < VGA_GFX_COUNT; i++)
+    {
+        outb(i, VGA_GFX_INDEX);
+        st->gfx[i] = inb(VGA_GFX_DATA);
+    }
+
+    // Reading the input status puts the attribute port back to index
+    for (i = 0; i < VGA_ATTR_COUNT; i++)
+    {
+        (void) inb(VGA_INPUT_STATUS);
+        outb(i | VGA_ATTR_PAS, VGA_ATTR_INDEX);
+        st->attr[i] = inb(VGA_ATTR_READ);
+    }
+    (void) inb(VGA_INPUT_STATUS);
+
+    outb(0, VGA_DAC_READ_INDEX);
+    for (i = 0; i < VGA_DAC_COUNT; i++)
+    {
+        st->dac[i] = inb(VGA_DAC_DATA);
+    }
+}
+
+/*
+ * vga_restore
+ *   DESCRIPTION: Write back the VGA registers and palette, except the
+ *                start address and cursor which stay as set meanwhile.
+ *   INPUTS: st - registers from vga_save
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: VBE leaves graphics settings behind, this undoes them.
+ */
+static void vga_restore(vga_state_t* st)
+{
+    uint32_t i;
+
+    outb(st->misc, VGA_MISC_WRITE);
+    for (i = 0; i < VGA_SEQ_COUNT; i++)
+    {
+        outb(i, VGA_SEQ_INDEX);
+        outb(st->seq[i], VGA_SEQ_DATA);
+    }
+
+    // CRTC 0 to 7 are write protected until the protect bit is cleared
+    outb(VGA_CRTC_PROTECT, VGA_CRTC_INDEX);
+    outb(st->crtc[VGA_CRTC_PROTECT] & ~VGA_CRTC_PROTECT_BIT, VGA_CRTC_DATA);
+    for (i = 0; i < VGA_CRTC_COUNT; i++)
+    {
+        if (i >= VGA_CRTC_LIVE_FIRST && i <= VGA_CRTC_LIVE_LAST)
+        {
+            continue;
+        }
+        outb(i, VGA_CRTC_INDEX);
+        outb(st->crtc[i], VGA_CRTC_DATA);
+    }
+    for (i = 0; i < VGA_GFX_COUNT; i++)
+    {
+        outb(i, VGA_GFX_INDEX);
+        outb(st->gfx[i], VGA_GFX_DATA);
+    }
+    for (i = 0; i < VGA_ATTR_COUNT; i++)
+    {
+        (void) inb(VGA_INPUT_STATUS);
+        outb(i | VGA_ATTR_PAS, VGA_ATTR_INDEX);
+        outb(st->attr[i], VGA_ATTR_INDEX);
+    }
+    (void) inb(VGA_INPUT_STATUS);
+
+    outb(0, VGA_DAC_WRITE_INDEX);
+    for (i = 0; i < VGA_DAC_COUNT; i++)
+    {
+        outb(st->dac[i], VGA_DAC_DATA);
+    }
+}
+
+/*
+ * vga_palette_332
+ *   DESCRIPTION: Load a palette where 8 bpp pixels are RRRGGGBB.
+ *   INPUTS: none
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The DAC takes 6 bits per color.
+ */
+static void vga_palette_332(void)
+{
+    uint32_t i;
+
+    outb(0, VGA_DAC_WRITE_INDEX);
+    for (i = 0; i < VGA_DAC_COUNT / 3; i++)
+    {
+        outb(((i >> 5) & 0x7) * 63 / 7, VGA_DAC_DATA);
+        outb(((i >> 2) & 0x7) * 63 / 7, VGA_DAC_DATA);
+        outb((i & 0x3) * 63 / 3, VGA_DAC_DATA);
+    }
+}
+
+/*
+ * text_pages_to_ram
+ *   DESCRIPTION: Back the text pages with RAM, or with VRAM again.
+ *   INPUTS: on - 1 for RAM, 0 for VRAM
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: VRAM below 0xC0000 is not decoded while VBE is on,
+ *                 terminals keep writing their pages in RAM meanwhile.
+ *                 Views of terminals in VRAM follow their page, the
+ *                 vidmap of the current process is remapped.
+ */
+static void text_pages_to_ram(uint8_t on)
+{
+    uint32_t i, page;
+
+    if (on)
+    {
+        for (i = 0; i < FB_TEXT_PAGES; i++)
+        {
+            memcpy(text_ram[i], (void*) ((VIDEO_MEM_PAGE + i) << 12), VIDEO_MEM_BYTES);
+            pageTableLow[VIDEO_MEM_PAGE + i].physicalAddress = ((uint32_t) text_ram[i]) >> 12;
+        }
+    }
+    else
+    {
+        for (i = 0; i < FB_TEXT_PAGES; i++)
+        {
+            pageTableLow[VIDEO_MEM_PAGE + i].physicalAddress = VIDEO_MEM_PAGE + i;
+        }
+    }
+
+    // Views in RAM are left alone, text_phys is 0 for them
+    for (i = 0; i < VIDEO_VIEW_COUNT; i++)
+    {
+        page = pageTableLow[VIDEO_VIEW_PAGE + i].physicalAddress;
+        if (on && page >= VIDEO_MEM_PAGE && page < VIDEO_MEM_PAGE + FB_TEXT_PAGES)
+        {
+            text_phys[i] = page;
+            pageTableLow[VIDEO_VIEW_PAGE + i].physicalAddress = ((uint32_t) text_ram[page - VIDEO_MEM_PAGE]) >> 12;
+        }
+        else if (!on && text_phys[i] != 0)
+        {
+            pageTableLow[VIDEO_VIEW_PAGE + i].physicalAddress = text_phys[i];
+            text_phys[i] = 0;
+        }
+    }
+    if (pcb != NULL)
+    {
+        pageTableHigh[0].physicalAddress = vidbuf_page(pcb->terminal_id);
+    }
+    flushTLB();
+
+    if (!on)
+    {
+        for (i = 0; i < FB_TEXT_PAGES; i++)
+        {
+            memcpy((void*) ((VIDEO_MEM_PAGE + i) << 12), text_ram[i], VIDEO_MEM_BYTES);
+        }
+    }
+}
+
+/*
+ * vbe_show
+ *   DESCRIPTION: Show the framebuffer of the mode set, or text mode.
+ *   INPUTS: on - 1 for the framebuffer, 0 for text mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Interrupts are off while VRAM changes hands. The
+ *                 framebuffer starts FB_VRAM_OFFSET into VRAM, so the
+ *                 text and font planes below are left alone.
+ */
+void vbe_show(uint8_t on)
+{
+    uint32_t flags, pitch;
+
+    if (on == fb_shown || (on && fb_pid == -1))
+    {
+        return;
+    }
+
+    cli_and_save(flags);
+    if (on)
+    {
+        vga_save(&vga_text);
+        text_pages_to_ram(1);
+
+        vbe_write(VBE_REG_ENABLE, 0);
+        vbe_write(VBE_REG_XRES, fb_width);
+        vbe_write(VBE_REG_YRES, fb_height);
+        vbe_write(VBE_REG_BPP, fb_bpp);
+        vbe_write(VBE_REG_ENABLE, VBE_ENABLED | VBE_LFB_ENABLED | VBE_NOCLEARMEM);
+
+        // Display start, the line pitch of VBE is the width
+        pitch = fb_width * fb_bpp / 8;
+        vbe_write(VBE_REG_X_OFFSET, (FB_VRAM_OFFSET % pitch) / (fb_bpp / 8));
+        vbe_write(VBE_REG_Y_OFFSET, FB_VRAM_OFFSET / pitch);
+
+        if (fb_bpp == 8)
+        {
+            vga_palette_332();
+        }
+    }
+    else
+    {
+        vbe_write(VBE_REG_ENABLE, 0);
+        vga_restore(&vga_text);
+        text_pages_to_ram(0);
+    }
+    fb_shown = on;
+    restore_flags(flags);
+}
+
+/*
+ * vbe_follow
+ *   DESCRIPTION: Show the framebuffer if its terminal is the one shown.
+ *   INPUTS: terminal_id - terminal shown
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void vbe_follow(uint32_t terminal_id)
+{
+    vbe_show(fb_pid != -1 && fb_tid == terminal_id);
+}
+
+/*
+ * vbe_release
+ *   DESCRIPTION: Go back to text mode if a process set the mode.
+ *   INPUTS: pid - process halting or asking for text mode
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: none
+ */
+void vbe_release(uint32_t pid)
+{
+    if (fb_pid != (int32_t) pid)
+    {
+        return;
+    }
+    vbe_show(0);
+    fb_pid = -1;
+}
+
+/*
+ * vbe_setmode
+ *   DESCRIPTION: Set a graphics mode for the current process, shown
+ *                whenever its terminal is.
+ *   INPUTS: width, height - pixels, multiples of 8 for width
+ *           bpp - 8, 16 or 32 bits per pixel, 8 is RRRGGGBB
+ *           all 0 for text mode again
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: The framebuffer is cleared. Another process keeps
+ *                 its mode until it asks for text mode or halts.
+ */
+int32_t vbe_setmode(uint32_t width, uint32_t height, uint32_t bpp)
+{
+    uint32_t pages;
+
+    if (fb_pid != -1 && fb_pid != pcb->process_id)
+    {
+        printf("<!> Framebuffer is used by process %d.\n", fb_pid);
+        error_sound();
+        return -1;
+    }
+
+    if (width == 0 && height == 0 && bpp == 0)
+    {
+        vbe_release(pcb->process_id);
+        return 0;
+    }
+
+    if (width < FB_MIN_WIDTH || width > FB_MAX_WIDTH || (width & 0x7) ||
+        height < FB_MIN_HEIGHT || height > FB_MAX_HEIGHT ||
+        (bpp != 8 && bpp != 16 && bpp != 32))
+    {
+        printf("<!> Graphics mode %ux%ux%u is not supported.\n", width, height, bpp);
+        error_sound();
+        return -1;
+    }
+
+    if (!vbe_probe())
+    {
+        printf("<!> No Bochs VBE framebuffer found.\n");
+        error_sound();
+        return -1;
+    }
+
+    // A new mode of the same process is set from text mode
+    vbe_show(0);
+    fb_pid = pcb->process_id;
+    fb_tid = pcb->terminal_id;
+    fb_width = width;
+    fb_height = height;
+    fb_bpp = bpp;
+
+    pages = (width * height * (bpp / 8) + VIDEO_MEM_BYTES - 1) / VIDEO_MEM_BYTES;
+    setFBPages(vbe_lfb + FB_VRAM_OFFSET, pages);
+    mapFBPage();
+    memset((void*) FB_USER_ADDR, 0, pages * VIDEO_MEM_BYTES);
+    if (!terminals[fb_tid].fbmap)
+    {
+        unMapFBPage();
+    }
+
+    vbe_follow(terminal_active);
+    return 0;
+}
+
+/*
+ * vbe_map
+ *   DESCRIPTION: Map the framebuffer of the mode of the current process
+ *                at FB_USER_ADDR, rows are width * bpp / 8 bytes apart.
+ *   INPUTS: fb_start - place to store the framebuffer pointer
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 on success, -1 on failure
+ *   SIDE EFFECTS: The pages are write combining if the CPU has PAT.
+ */
+int32_t vbe_map(uint8_t** fb_start)
+{
+    if (fb_start == NULL || (uint32_t) fb_start < PROGRAM_PAGE_ADDR || (uint32_t) fb_start > (PROGRAM_STACK_ADDR - 4))
+    {
+        printf("<!> Specified fbmap address 0x%#x is not valid.\n", (uint32_t) fb_start);
+        error_sound();
+        return -1;
+    }
+
+    if (fb_pid != pcb->process_id)
+    {
+        printf("<!> Set a graphics mode before mapping the framebuffer.\n");
+        error_sound();
+        return -1;
+    }
+
+    terminals[fb_tid].fbmap = 1;
+    mapFBPage();
+    *fb_start = (uint8_t*) FB_USER_ADDR;
+    return 0;
+}
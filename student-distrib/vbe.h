@@ -0,0 +1,125 @@
+/**
+ *  vbe.h - Bochs VBE linear framebuffer
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: Bochs vbe.h, QEMU hw/display/vga.c, OSDev
+ */
+
+#ifndef _VBE_H
+#define _VBE_H
+
+#include "types.h"
+
+// Bochs VBE registers, the std VGA of QEMU has them too
+#define VBE_INDEX_PORT 0x1CE
+#define VBE_DATA_PORT 0x1CF
+#define VBE_REG_ID 0
+#define VBE_REG_XRES 1
+#define VBE_REG_YRES 2
+#define VBE_REG_BPP 3
+#define VBE_REG_ENABLE 4
+#define VBE_REG_X_OFFSET 8
+#define VBE_REG_Y_OFFSET 9
+
+// ID 2 and later can do 32 bpp with a linear framebuffer
+#define VBE_ID2 0xB0C2
+#define VBE_ID_MAX 0xB0CF
+
+#define VBE_ENABLED 0x01
+#define VBE_LFB_ENABLED 0x40
+#define VBE_NOCLEARMEM 0x80
+
+// PCI configuration mechanism #1, the framebuffer is BAR 0 of the card
+#define PCI_CONFIG_ADDRESS 0xCF8
+#define PCI_CONFIG_DATA 0xCFC
+#define PCI_CONFIG_ENABLE 0x80000000
+#define PCI_DEVICE_COUNT 32
+#define PCI_BAR0 0x10
+#define PCI_BAR_MEM_MASK 0xFFFFFFF0
+#define VBE_PCI_ID 0x11111234           // Device 0x1111, vendor 0x1234
+
+// Modes allowed, the framebuffer has to fit the 4MB of pageTableFB
+#define FB_MIN_WIDTH 320
+#define FB_MIN_HEIGHT 200
+#define FB_MAX_WIDTH 1024
+#define FB_MAX_HEIGHT 768
+
+// The VGA planes with text and font take the first 256KB of VRAM, the
+// framebuffer starts above them so text mode comes back untouched
+#define FB_VRAM_OFFSET 0x40000
+
+// User address of the framebuffer, PDE FB_PAGE_DIR_ENTRY
+#define FB_USER_ADDR 0x08800000
+
+// PAT entry 1 is write through after reset, the framebuffer gets
+// write combining there, used by pages with only PWT set
+#define CPUID_PAT (1 << 16)
+#define PAT_MSR 0x277
+#define PAT_ENTRY1_MASK 0xFF00
+#define PAT_ENTRY1_WC 0x0100
+
+// VGA registers saved while the framebuffer is shown
+#define VGA_MISC_READ 0x3CC
+#define VGA_MISC_WRITE 0x3C2
+#define VGA_SEQ_INDEX 0x3C4
+#define VGA_SEQ_DATA 0x3C5
+#define VGA_CRTC_INDEX 0x3D4
+#define VGA_CRTC_DATA 0x3D5
+#define VGA_GFX_INDEX 0x3CE
+#define VGA_GFX_DATA 0x3CF
+#define VGA_ATTR_INDEX 0x3C0
+#define VGA_ATTR_READ 0x3C1
+#define VGA_INPUT_STATUS 0x3DA
+#define VGA_DAC_READ_INDEX 0x3C7
+#define VGA_DAC_WRITE_INDEX 0x3C8
+#define VGA_DAC_DATA 0x3C9
+
+#define VGA_SEQ_COUNT 5
+#define VGA_CRTC_COUNT 25
+#define VGA_GFX_COUNT 9
+#define VGA_ATTR_COUNT 21
+#define VGA_DAC_COUNT 768
+#define VGA_CRTC_PROTECT 0x11
+#define VGA_CRTC_PROTECT_BIT 0x80
+#define VGA_ATTR_PAS 0x20               // Attribute index bit to keep the screen on
+
+// Start address and cursor, kept up to date by lib.c while hidden
+#define VGA_CRTC_LIVE_FIRST 0x0C
+#define VGA_CRTC_LIVE_LAST 0x0F
+
+// Text pages backed by RAM while the framebuffer is shown
+#define FB_TEXT_PAGES VIDEO_VRAM_PAGES
+
+#ifndef ASM
+
+#include "lib.h"
+
+// VGA state of text mode
+typedef struct vga_state_t
+{
+    uint8_t misc;
+    uint8_t seq[VGA_SEQ_COUNT];
+    uint8_t crtc[VGA_CRTC_COUNT];
+    uint8_t gfx[VGA_GFX_COUNT];
+    uint8_t attr[VGA_ATTR_COUNT];
+    uint8_t dac[VGA_DAC_COUNT];
+} vga_state_t;
+
+// Set a graphics mode for this process, or 0x0x0 for text mode again
+extern int32_t vbe_setmode(uint32_t width, uint32_t height, uint32_t bpp);
+
+// Map the framebuffer of the mode of this process
+extern int32_t vbe_map(uint8_t** fb_start);
+
+// Show the framebuffer while its terminal is shown
+extern void vbe_follow(uint32_t terminal_id);
+
+// Show the framebuffer, or text mode
+extern void vbe_show(uint8_t on);
+
+// Text mode again if the halting process set the mode
+extern void vbe_release(uint32_t pid);
+
+#endif /* ASM */
+
+#endif /* _VBE_H */
@@ -0,0 +1,176 @@
+/**
+ *  vidbuf.c - Double buffered vidmap
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: 
+ */
+
+#include "vidbuf.h"
+#include "palloc.h"
+
+// Bytes of a screen, copied to the RAM page and the shadow
+#define VIDBUF_SCREEN_BYTES (NUM_ROWS * NUM_COLS * 2)
+
+// RAM pages the vidmap points at while double buffered, taken the first
+// time a terminal turns buffering on and kept for the next program
+static uint16_t* vidbuf_ram[TERMINAL_COUNT];
+
+// Rows as last copied to VRAM, compared in RAM instead of reading VRAM,
+// the page after the RAM page
+static uint16_t* vidbuf_shadow[TERMINAL_COUNT];
+
+// Process which turned buffering on, valid while the terminal is buffered
+static uint32_t vidbuf_pid[TERMINAL_COUNT];
+
+// Helper function to draw in VRAM again
+static void vidbuf_off(uint32_t terminal_id);
+
+/* 
+ * vidbuf_page
+ *   DESCRIPTION: Page the vidmap of a terminal maps.
+ *   INPUTS: terminal_id - terminal ID
+ *   OUTPUTS: none
+ *   RETURN VALUE: page # of the RAM page while double buffered,
+ *                 of the page backing the terminal page otherwise,
+ *                 RAM too while vbe.c shows a framebuffer
+ *   SIDE EFFECTS: none
+ */
+uint32_t vidbuf_page(uint32_t terminal_id)
+{
+    if (terminals[terminal_id].vidbuf)
+    {
+        return ((uint32_t) vidbuf_ram[terminal_id]) >> 12;
+    }
+    return pageTableLow[terminals[terminal_id].video_page].physicalAddress;
+}
+
+/* 
+ * vidbuf_set
+ *   DESCRIPTION: Draw the vidmap of a terminal in a RAM page until
+ *                vidflush, or straight in VRAM again. Only the
+ *                process which turned buffering on may change it.
+ *   INPUTS: terminal_id - terminal ID of the current process
+ *           on - 1 for RAM, 0 for VRAM
+ *   OUTPUTS: none
+ *   RETURN VALUE: 0 - success, -1 - no memory for the RAM page, or
+ *                 another process turned buffering on
+ *   SIDE EFFECTS: The RAM page starts as a copy of the screen. Going
+ *                 back to VRAM copies the last changes first. The
+ *                 vidmap page is remapped.
+ */
+int32_t vidbuf_set(uint32_t terminal_id, uint8_t on)
+{
+    terminal_t* term = &terminals[terminal_id];
+
+    if (term->vidbuf && (vidbuf_pid[terminal_id] != pcb->process_id))
+    {
+        printf("<!> Vidmap is double buffered by process %u.\n", vidbuf_pid[terminal_id]);
+        return -1;
+    }
+    if (term->vidbuf == on)
+    {
+        return 0;
+    }
+
+    if (on)
+    {
+        if (vidbuf_ram[terminal_id] == NULL)
+        {
+            if ((vidbuf_ram[terminal_id] = page_alloc(2)) == NULL)
+            {
+                return -1;
+            }
+            vidbuf_shadow[terminal_id] = vidbuf_ram[terminal_id] + VIDEO_MEM_BYTES / 2;
+        }
+        screen_flush((char*) term->video_addr);
+        memcpy(vidbuf_ram[terminal_id], term->video_addr, VIDBUF_SCREEN_BYTES);
+        memcpy(vidbuf_shadow[terminal_id], term->video_addr, VIDBUF_SCREEN_BYTES);
+        vidbuf_pid[terminal_id] = pcb->process_id;
+        term->vidbuf = 1;
+        pageTableHigh[0].physicalAddress = vidbuf_page(terminal_id);
+        flushTLB();
+    }
+    else
+    {
+        vidbuf_off(terminal_id);
+    }
+    return 0;
+}
+
+/* 
+ * vidbuf_release
+ *   DESCRIPTION: Draw in VRAM again if a process turned buffering on.
+ *   INPUTS: terminal_id - terminal ID
+ *           pid - process halting
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: Buffering turned on by another process of the
+ *                 terminal stays on.
+ */
+void vidbuf_release(uint32_t terminal_id, uint32_t pid)
+{
+    if (terminals[terminal_id].vidbuf && (vidbuf_pid[terminal_id] == pid))
+    {
+        vidbuf_off(terminal_id);
+    }
+}
+
+/* 
+ * vidbuf_off
+ *   DESCRIPTION: Copy the last changes to VRAM and map it again.
+ *   INPUTS: terminal_id - terminal ID of the current process
+ *   OUTPUTS: none
+ *   RETURN VALUE: none
+ *   SIDE EFFECTS: The vidmap page is remapped.
+ */
+static void vidbuf_off(uint32_t terminal_id)
+{
+    (void) vidbuf_flush(terminal_id);
+    terminals[terminal_id].vidbuf = 0;
+    pageTableHigh[0].physicalAddress = vidbuf_page(terminal_id);
+    flushTLB();
+}
+
+/* 
+ * vidbuf_flush
+ *   DESCRIPTION: Copy the rows changed in the RAM page to VRAM.
+ *   INPUTS: terminal_id - terminal ID
+ *   OUTPUTS: none
+ *   RETURN VALUE: rows copied, -1 if not double buffered
+ *   SIDE EFFECTS: Rows are compared with what was copied last, so
+ *                 rows left alone cost no VRAM access.
+ */
+int32_t vidbuf_flush(uint32_t terminal_id)
+{
+    terminal_t* term = &terminals[terminal_id];
+    uint32_t* ram = (uint32_t*) vidbuf_ram[terminal_id];
+    uint32_t* shadow = (uint32_t*) vidbuf_shadow[terminal_id];
+    uint32_t row, col;
+    int32_t copied = 0;
+
+    if (!term->vidbuf)
+    {
+        return -1;
+    }
+
+    // Text scrolled meanwhile must not land over the rows later
+    screen_flush((char*) term->video_addr);
+
+    for (row = 0; row < NUM_ROWS; row++)
+    {
+        // Two cells per dword
+        for (col = 0; col < NUM_COLS / 2; col++)
+        {
+            if (ram[col] != shadow[col])
+            {
+                memcpy((uint16_t*) term->video_addr + row * NUM_COLS, ram, NUM_COLS * 2);
+                memcpy(shadow, ram, NUM_COLS * 2);
+                copied++;
+                break;
+            }
+        }
+        ram += NUM_COLS / 2;
+        shadow += NUM_COLS / 2;
+    }
+    return copied;
+}
@@ -0,0 +1,31 @@
+/**
+ *  vidbuf.h - Double buffered vidmap
+ *  Copyright (C) 2022 lenovohpdellasus. All Rights Reserved.
+ *  Author: Peizhe Liu
+ *  Sources: 
+ */
+
+#ifndef _VIDBUF_H
+#define _VIDBUF_H
+
+#include "types.h"
+
+#ifndef ASM
+
+#include "lib.h"
+
+// Page the vidmap of a terminal maps, its RAM page while double buffered
+extern uint32_t vidbuf_page(uint32_t terminal_id);
+
+// Draw the vidmap of a terminal in RAM, or in VRAM again
+extern int32_t vidbuf_set(uint32_t terminal_id, uint8_t on);
+
+// Draw in VRAM again if the process halting turned buffering on
+extern void vidbuf_release(uint32_t terminal_id, uint32_t pid);
+
+// Copy the rows changed in RAM to VRAM
+extern int32_t vidbuf_flush(uint32_t terminal_id);
+
+#endif /* ASM */
+
+#endif /* _VIDBUF_H */
@@ -19,6 +19,14 @@
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE    104
 
+/* Offset of esp0 inside the TSS, used by the SYSENTER linkage */
+#define TSS_ESP0_OFFSET 4
+
+/* SYSENTER/SYSEXIT model-specific registers */
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
 /* Number of vectors in the interrupt descriptor table (IDT) */
 #define NUM_VEC     256
 
@@ -0,0 +1,46 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define SBUFSIZE 33
+#define BIGFILE "verylargetextwithverylongname.txt"
+
+/*
+ * Print a file like cat does, 1 KB per write, and count how many
+ * characters per second the terminal takes.  Only the writes are timed.
+ * The file defaults to the largest text file.
+ */
+int main ()
+{
+    static uint8_t buf[BUFSIZE];
+    uint8_t name[SBUFSIZE];
+    int32_t fd, cnt;
+    uint32_t chars = 0, cycles = 0, start, cps;
+
+    if (0 != ece391_getargs (name, SBUFSIZE) || '\0' == name[0])
+        ece391_strcpy (name, (uint8_t*)BIGFILE);
+    if (0 == (cps = ece391_cycles_per_second ()))
+        return 3;
+
+    if (-1 == (fd = ece391_open (name))) {
+        ece391_fdputs (1, (uint8_t*)"file not found\n");
+        return 2;
+    }
+    while (0 < (cnt = ece391_read (fd, buf, BUFSIZE))) {
+        start = ece391_rdtsc_low ();
+        if (-1 == ece391_write (1, buf, cnt))
+            return 3;
+        cycles += ece391_rdtsc_low () - start;
+        chars += cnt;
+    }
+    (void)ece391_close (fd);
+
+    ece391_put_num ("\n", chars, " characters in ");
+    ece391_put_num ("", cycles, " cycles");
+    if (0 != chars && 0 != cycles / chars)
+        ece391_put_num (", ", cps / (cycles / chars), " characters per second");
+    ece391_fdputs (1, (uint8_t*)"\n");
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define FRAMES 16
+#define SBUFSIZE 33
+#define DEFAULT_WIDTH 640
+#define DEFAULT_HEIGHT 480
+#define DEFAULT_BPP 32
+
+/* Next decimal number in the arguments, def if there is none */
+static uint32_t
+next_num (uint8_t** p, uint32_t def)
+{
+    uint32_t num = 0;
+
+    while (' ' == **p)
+        (*p)++;
+    if (**p < '0' || **p > '9')
+        return def;
+    while (**p >= '0' && **p <= '9')
+        num = num * 10 + (*(*p)++ - '0');
+    return num;
+}
+
+/*
+ * Fill the whole framebuffer FRAMES times with dword stores, a new color
+ * each frame.  Usage: fillbench [width height bpp], 640 480 32 if none.
+ */
+int main ()
+{
+    uint8_t arg[SBUFSIZE], *p = arg, *fb;
+    uint32_t width, height, bpp, dwords, pixels, cps, per_us, us, start, i, f;
+    uint32_t* dst;
+
+    arg[0] = '\0';
+    (void)ece391_getargs (arg, SBUFSIZE);
+    width = next_num (&p, DEFAULT_WIDTH);
+    height = next_num (&p, DEFAULT_HEIGHT);
+    bpp = next_num (&p, DEFAULT_BPP);
+
+    /* time the RTC in text mode, the mode set below clears the screen */
+    cps = ece391_cycles_per_second ();
+    if (-1 == ece391_setmode (width, height, bpp)) {
+        ece391_fdputs (1, (uint8_t*)"could not set the graphics mode\n");
+        return 3;
+    }
+    if (-1 == ece391_fbmap (&fb)) {
+        (void)ece391_setmode (0, 0, 0);
+        ece391_fdputs (1, (uint8_t*)"could not map the framebuffer\n");
+        return 3;
+    }
+
+    pixels = width * height;
+    dwords = pixels * (bpp / 8) / 4;
+    start = ece391_rdtsc_low ();
+    for (f = 0; f < FRAMES; f++) {
+        dst = (uint32_t*)fb;
+        for (i = 0; i < dwords; i++)
+            dst[i] = 0x01010101 * (f * 37 + 11);
+    }
+    start = ece391_rdtsc_low () - start;
+    (void)ece391_setmode (0, 0, 0);
+
+    per_us = cps / 1000000;
+    if (0 == per_us || 0 == (us = start / per_us)) {
+        ece391_fdputs (1, (uint8_t*)"could not time the RTC\n");
+        return 3;
+    }
+    ece391_put_num ("", width, "x");
+    ece391_put_num ("", height, "x");
+    ece391_put_num ("", bpp, ": ");
+    ece391_put_num ("", FRAMES, " frames, ");
+    ece391_put_num ("", start / FRAMES, " cycles per frame\n");
+    ece391_put_num ("fill rate: ", pixels * FRAMES / us, ".");
+    ece391_put_num ("", pixels * FRAMES * 10 / us % 10, " Mpixels per second, ");
+    ece391_put_num ("", dwords * 4 * FRAMES / us, " MB per second\n");
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define SBUFSIZE 33
+#define RTC_HZ 4
+#define PATTERN "the"
+#define SAVED_STDOUT 7
+
+/* Run cmd with stdout on a pipe, returns the bytes it wrote, or -1 */
+static int32_t
+count_output (const uint8_t* cmd, uint32_t* cycles)
+{
+    static uint8_t buf[BUFSIZE];
+    int32_t fds[2], pid, cnt, total = 0;
+    uint32_t start;
+
+    if (-1 == ece391_pipe (fds))
+        return -1;
+    (void)ece391_dup2 (1, SAVED_STDOUT);
+    (void)ece391_dup2 (fds[1], 1);
+    (void)ece391_close (fds[1]);
+    start = ece391_rdtsc_low ();
+    pid = ece391_spawn (cmd);
+    (void)ece391_dup2 (SAVED_STDOUT, 1);
+    (void)ece391_close (SAVED_STDOUT);
+    if (-1 == pid) {
+        (void)ece391_close (fds[0]);
+        return -1;
+    }
+    while (0 < (cnt = ece391_read (fds[0], buf, BUFSIZE)))
+        total += cnt;
+    *cycles = ece391_rdtsc_low () - start;
+    (void)ece391_close (fds[0]);
+    return total;
+}
+
+/*
+ * Output throughput of grep on the terminal.  grep runs once into a pipe
+ * to count its output, then once onto the screen.  The pattern defaults
+ * to PATTERN.
+ */
+int main ()
+{
+    uint8_t cmd[SBUFSIZE + 5];
+    int32_t rtc, freq = RTC_HZ, garbage, chars;
+    uint32_t piped, shown, cps;
+
+    ece391_strcpy (cmd, (uint8_t*)"grep ");
+    if (0 != ece391_getargs (cmd + 5, SBUFSIZE) || '\0' == cmd[5])
+        ece391_strcpy (cmd + 5, (uint8_t*)PATTERN);
+
+    if (-1 == (rtc = ece391_open ((uint8_t*)"rtc")))
+        return 3;
+    (void)ece391_write (rtc, &freq, 4);
+    (void)ece391_read (rtc, &garbage, 4);
+    cps = ece391_rdtsc_low ();
+    (void)ece391_read (rtc, &garbage, 4);
+    cps = (ece391_rdtsc_low () - cps) * RTC_HZ;
+    (void)ece391_close (rtc);
+
+    if (0 >= (chars = count_output (cmd, &piped))) {
+        ece391_fdputs (1, (uint8_t*)"grep printed nothing\n");
+        return 2;
+    }
+    shown = ece391_rdtsc_low ();
+    (void)ece391_execute (cmd);
+    shown = ece391_rdtsc_low () - shown;
+
+    ece391_put_num ("\n", chars, " characters");
+    ece391_put_num (", into a pipe in ", piped, " cycles");
+    ece391_put_num (", on the screen in ", shown, " cycles\n");
+    if (0 != shown / chars)
+        ece391_put_num ("grep output: ", cps / (shown / chars), " characters per second\n");
+    return 0;
+}
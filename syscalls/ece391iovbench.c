@@ -0,0 +1,158 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define SBUFSIZE 33
+
+static uint32_t traps;
+static uint32_t lines;
+static int32_t use_writev;
+
+/* Print one matching line the way grep does, with either call style */
+static void
+emit_line (const char* fname, uint8_t* line, int32_t len)
+{
+    struct ece391_iovec iov[4];
+
+    lines++;
+    if (!use_writev) {
+        line[len] = '\0';
+        ece391_fdputs (1, (uint8_t*)fname);
+        ece391_fdputs (1, (uint8_t*)":");
+        ece391_fdputs (1, line);
+        ece391_fdputs (1, (uint8_t*)"\n");
+        traps += 4;
+        return;
+    }
+    iov[0].iov_base = (void*)fname;
+    iov[0].iov_len = ece391_strlen ((uint8_t*)fname);
+    iov[1].iov_base = ":";
+    iov[1].iov_len = 1;
+    iov[2].iov_base = line;
+    iov[2].iov_len = len;
+    iov[3].iov_base = "\n";
+    iov[3].iov_len = 1;
+    (void)ece391_writev (1, iov, 4);
+    traps++;
+}
+
+/* Search one file, lines longer than BUFSIZE are split */
+static int32_t
+grep_file (const char* s, const char* fname)
+{
+    int32_t fd, cnt, last, start, end, check, s_len;
+    uint8_t data[BUFSIZE+1];
+
+    s_len = ece391_strlen ((uint8_t*)s);
+    if (-1 == (fd = ece391_open ((uint8_t*)fname)))
+        return -1;
+    traps++;
+    last = 0;
+    do {
+        cnt = ece391_read (fd, data + last, BUFSIZE - last);
+        traps++;
+        if (-1 == cnt)
+            return -1;
+        last += cnt;
+        start = 0;
+        while (start < last) {
+            for (end = start; end < last && '\n' != data[end]; end++);
+            /* an unfinished line waits for the next read unless it fills the buffer */
+            if (end == last && 0 != cnt && (0 != start || last < BUFSIZE))
+                break;
+            for (check = start; check + s_len <= end; check++) {
+                if (0 == ece391_strncmp (data + check, (uint8_t*)s, s_len)) {
+                    emit_line (fname, data + start, end - start);
+                    break;
+                }
+            }
+            start = end + 1;
+        }
+        /* keep the partial line for the next read */
+        for (end = 0; start + end < last; end++)
+            data[end] = data[start + end];
+        last = (start < last) ? last - start : 0;
+    } while (0 != cnt);
+    (void)ece391_close (fd);
+    traps++;
+    return 0;
+}
+
+/* Grep the whole filesystem, returns the cycles spent */
+static uint32_t
+grep_all (const char* s)
+{
+    int32_t fd, cnt;
+    uint8_t buf[SBUFSIZE];
+    uint32_t start;
+
+    traps = lines = 0;
+    start = ece391_rdtsc_low ();
+    if (-1 == (fd = ece391_open ((uint8_t*)".")))
+        return 0;
+    while (0 < (cnt = ece391_read (fd, buf, SBUFSIZE-1))) {
+        traps++;
+        buf[cnt] = '\0';
+        if ('.' == buf[0] || 0 == ece391_strcmp (buf, (uint8_t*)"rtc"))
+            continue;
+        (void)grep_file (s, (char*)buf);
+    }
+    (void)ece391_close (fd);
+    return ece391_rdtsc_low () - start;
+}
+
+static void
+report (const char* name, uint32_t cycles, uint32_t cps)
+{
+    uint8_t buf[SBUFSIZE];
+    uint32_t per_line;
+
+    if (0 == lines) {
+        ece391_fdputs (1, (uint8_t*)"no matching lines\n");
+        return;
+    }
+    per_line = cycles / lines;
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (lines, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" lines, ");
+    ece391_fdputs (1, ece391_itoa (traps * 100 / lines, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" traps per 100 lines, ");
+    ece391_fdputs (1, ece391_itoa (per_line, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles per line");
+    if (0 != cps && 0 != per_line) {
+        ece391_fdputs (1, (uint8_t*)", ");
+        ece391_fdputs (1, ece391_itoa (cps / per_line, buf, 10));
+        ece391_fdputs (1, (uint8_t*)" lines per second");
+    }
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+int main ()
+{
+    uint8_t search[BUFSIZE];
+    uint32_t cps, cycles[2], line_cnt[2], trap_cnt[2];
+
+    if (0 != ece391_getargs (search, BUFSIZE)) {
+        ece391_fdputs (1, (uint8_t*)"usage: iovbench <pattern>\n");
+        return 3;
+    }
+    cps = ece391_cycles_per_second ();
+
+    for (use_writev = 0; use_writev < 2; use_writev++) {
+        cycles[use_writev] = grep_all ((char*)search);
+        line_cnt[use_writev] = lines;
+        trap_cnt[use_writev] = traps;
+    }
+
+    /* print both results after the grep output has scrolled by */
+    lines = line_cnt[0];
+    traps = trap_cnt[0];
+    report ("fdputs: ", cycles[0], cps);
+    lines = line_cnt[1];
+    traps = trap_cnt[1];
+    report ("writev: ", cycles[1], cps);
+    return 0;
+}
+
@@ -0,0 +1,38 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define TIMEOUT_MS 1000
+#define SBUFSIZE 33
+
+/* Print every key as it is typed, a dot for each idle second, q quits */
+int main ()
+{
+    uint8_t keys[SBUFSIZE], buf[SBUFSIZE];
+    int32_t cnt, i;
+
+    if (-1 == ece391_ioctl (0, TCSETMODE, TERM_RAW) ||
+        -1 == ece391_ioctl (0, TCSETTIMEOUT, TIMEOUT_MS)) {
+        ece391_fdputs (1, (uint8_t*)"could not switch stdin to raw mode\n");
+        return 3;
+    }
+    ece391_fdputs (1, (uint8_t*)"raw mode, type keys, q quits\n");
+
+    while (1) {
+        if (-1 == (cnt = ece391_read (0, keys, SBUFSIZE)))
+            return 3;
+        if (0 == cnt) {
+            ece391_fdputs (1, (uint8_t*)".");
+            continue;
+        }
+        for (i = 0; i < cnt; i++) {
+            if ('q' == keys[i]) {
+                ece391_fdputs (1, (uint8_t*)"\n");
+                return 0;
+            }
+            ece391_fdputs (1, (uint8_t*)" ");
+            ece391_fdputs (1, ece391_itoa (keys[i], buf, 10));
+        }
+    }
+}
@@ -0,0 +1,97 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ROUNDS 100000
+#define FILE_ROUNDS 10000
+#define BUFSIZE 16
+
+/* Time ROUNDS null syscalls through the currently selected entry path */
+static uint32_t
+time_null_syscall (void)
+{
+    uint32_t i, start;
+
+    start = ece391_rdtsc_low ();
+    for (i = 0; i < ROUNDS; i++)
+        (void)ece391_getpid ();
+    return (ece391_rdtsc_low () - start) / ROUNDS;
+}
+
+static void
+report (const char* name, uint32_t cycles)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (cycles, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles per round trip\n");
+}
+
+/* 
+ * Time read, write, open and close through the currently selected entry
+ * path.  Reads and writes move zero bytes so only the dispatch and driver
+ * lookup are measured, not the copy or the screen.
+ */
+static int32_t
+time_file_syscalls (void)
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t i, start, mid, open_cycles, close_cycles;
+    int32_t fd;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"frame0.txt"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open frame0.txt\n");
+        return -1;
+    }
+
+    start = ece391_rdtsc_low ();
+    for (i = 0; i < FILE_ROUNDS; i++)
+        (void)ece391_read (fd, buf, 0);
+    report ("  read:  ", (ece391_rdtsc_low () - start) / FILE_ROUNDS);
+
+    start = ece391_rdtsc_low ();
+    for (i = 0; i < FILE_ROUNDS; i++)
+        (void)ece391_write (1, buf, 0);
+    report ("  write: ", (ece391_rdtsc_low () - start) / FILE_ROUNDS);
+
+    (void)ece391_close (fd);
+
+    open_cycles = close_cycles = 0;
+    for (i = 0; i < FILE_ROUNDS; i++) {
+        start = ece391_rdtsc_low ();
+        fd = ece391_open ((uint8_t*)"frame0.txt");
+        mid = ece391_rdtsc_low ();
+        (void)ece391_close (fd);
+        close_cycles += ece391_rdtsc_low () - mid;
+        open_cycles += mid - start;
+    }
+    report ("  open:  ", open_cycles / FILE_ROUNDS);
+    report ("  close: ", close_cycles / FILE_ROUNDS);
+
+    return 0;
+}
+
+int main ()
+{
+    int32_t fast = ece391_fast_syscall;
+
+    ece391_fast_syscall = 0;
+    report ("int 0x80: ", time_null_syscall ());
+    if (-1 == time_file_syscalls ())
+        return 3;
+
+    if (0 == fast) {
+        ece391_fdputs (1, (uint8_t*)"sysenter: not supported by this processor\n");
+        return 0;
+    }
+
+    ece391_fast_syscall = fast;
+    report ("sysenter: ", time_null_syscall ());
+    if (-1 == time_file_syscalls ())
+        return 3;
+
+    return 0;
+}
+
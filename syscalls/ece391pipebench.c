@@ -0,0 +1,128 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define READ_SIZE 4096
+#define SBUFSIZE 33
+#define SAVED_STDOUT 7
+
+static uint8_t data[READ_SIZE];
+
+/* Parse a decimal number, *s is left after it */
+static int32_t
+parse_num (uint8_t** s)
+{
+    int32_t num = 0;
+
+    while (' ' == **s)
+        (*s)++;
+    for (; **s >= '0' && **s <= '9'; (*s)++)
+        num = num * 10 + (**s - '0');
+    return num;
+}
+
+/* Writer side "-w <chunk> <KB>", started with stdout on the pipe */
+static int32_t
+write_all (uint8_t* arg)
+{
+    int32_t chunk, left;
+
+    chunk = parse_num (&arg);
+    left = parse_num (&arg) * 1024;
+    if (chunk <= 0 || chunk > READ_SIZE)
+        return 3;
+    for (; left > 0; left -= chunk)
+        if (-1 == ece391_write (1, data, chunk < left ? chunk : left))
+            return 2;
+    return 0;
+}
+
+/* Spawn a writer of chunk bytes per call and read the pipe dry */
+static int32_t
+time_pipe (const char* chunk, uint8_t* kb, uint32_t* cycles)
+{
+    int32_t fds[2], cnt, total = 0;
+    uint8_t cmd[2 * SBUFSIZE];
+    uint32_t start;
+
+    if (-1 == ece391_pipe (fds))
+        return -1;
+    ece391_strcpy (cmd, (uint8_t*)"pipebench -w ");
+    ece391_strcpy (cmd + ece391_strlen (cmd), (uint8_t*)chunk);
+    ece391_strcpy (cmd + ece391_strlen (cmd), (uint8_t*)" ");
+    ece391_strcpy (cmd + ece391_strlen (cmd), kb);
+
+    start = ece391_rdtsc_low ();
+    (void)ece391_dup2 (1, SAVED_STDOUT);
+    (void)ece391_dup2 (fds[1], 1);
+    (void)ece391_close (fds[1]);
+    cnt = ece391_spawn (cmd);
+    (void)ece391_dup2 (SAVED_STDOUT, 1);
+    (void)ece391_close (SAVED_STDOUT);
+    if (-1 == cnt) {
+        (void)ece391_close (fds[0]);
+        return -1;
+    }
+
+    /* the writer runs whenever this read waits on an empty pipe */
+    while (0 < (cnt = ece391_read (fds[0], data, READ_SIZE)))
+        total += cnt;
+    *cycles = ece391_rdtsc_low () - start;
+    (void)ece391_close (fds[0]);
+    return total;
+}
+
+static void
+report (const char* chunk, int32_t kb, int32_t bytes, uint32_t cycles, uint32_t cps)
+{
+    uint8_t buf[SBUFSIZE];
+    uint32_t per_kb;
+
+    ece391_fdputs (1, (uint8_t*)"chunk ");
+    ece391_fdputs (1, (uint8_t*)chunk);
+    ece391_fdputs (1, (uint8_t*)": ");
+    if (bytes != kb * 1024) {
+        ece391_fdputs (1, ece391_itoa (bytes, buf, 10));
+        ece391_fdputs (1, (uint8_t*)" bytes arrived, expected ");
+        ece391_fdputs (1, ece391_itoa (kb * 1024, buf, 10));
+        ece391_fdputs (1, (uint8_t*)"\n");
+        return;
+    }
+    per_kb = cycles / kb;
+    ece391_fdputs (1, ece391_itoa (per_kb, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles per KB");
+    if (0 != cps && 0 != per_kb) {
+        ece391_fdputs (1, (uint8_t*)", ");
+        ece391_fdputs (1, ece391_itoa (cps / per_kb, buf, 10));
+        ece391_fdputs (1, (uint8_t*)" KB per second");
+    }
+    ece391_fdputs (1, (uint8_t*)"\n");
+}
+
+int main ()
+{
+    static const char* chunks[] = { "64", "512", "4096" };
+    uint8_t arg[SBUFSIZE], *p = arg;
+    uint32_t cps, cycles, i;
+    int32_t bytes, kb;
+
+    if (0 != ece391_getargs (arg, SBUFSIZE))
+        arg[0] = '\0';
+    if ('-' == arg[0] && 'w' == arg[1])
+        return write_all (arg + 2);
+    if (0 >= (kb = parse_num (&p))) {
+        ece391_fdputs (1, (uint8_t*)"usage: pipebench <KB to move>\n");
+        return 3;
+    }
+
+    cps = ece391_cycles_per_second ();
+    for (i = 0; i < sizeof (chunks) / sizeof (chunks[0]); i++) {
+        if (-1 == (bytes = time_pipe (chunks[i], arg, &cycles))) {
+            ece391_fdputs (1, (uint8_t*)"could not start the writer\n");
+            return 3;
+        }
+        report (chunks[i], kb, bytes, cycles, cps);
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define RTC_HZ 64
+#define SECONDS 4
+#define BUFSIZE 128
+
+struct poll_stats {
+    uint32_t ticks;         /* RTC wakeups */
+    uint32_t lines;         /* stdin wakeups */
+    uint32_t polls;         /* poll calls made */
+    uint32_t err_sum;       /* sum of |interval - period| in cycles */
+    uint32_t err_max;
+    uint32_t blocked;       /* cycles spent inside poll */
+    uint32_t total;
+};
+
+/* Multiplex stdin and the RTC for SECONDS, timeout 0 spins on poll */
+static void
+run (int32_t rtc_fd, int32_t timeout, uint32_t cps, struct poll_stats* st)
+{
+    struct ece391_pollfd pfd[2];
+    uint8_t buf[BUFSIZE];
+    uint32_t start, before, after, last, err, period = cps / RTC_HZ;
+    int32_t garbage, cnt;
+
+    pfd[0].fd = 0;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = rtc_fd;
+    pfd[1].events = POLLIN;
+
+    /* line up with an RTC period first */
+    (void)ece391_read (rtc_fd, &garbage, 4);
+    start = last = ece391_rdtsc_low ();
+    while (st->ticks < SECONDS * RTC_HZ) {
+        before = ece391_rdtsc_low ();
+        cnt = ece391_poll (pfd, 2, timeout);
+        after = ece391_rdtsc_low ();
+        st->polls++;
+        st->blocked += after - before;
+        if (-1 == cnt)
+            break;
+        if (pfd[1].revents & POLLIN) {
+            (void)ece391_read (rtc_fd, &garbage, 4);
+            err = after - last;
+            err = (err > period) ? err - period : period - err;
+            st->err_sum += err;
+            if (err > st->err_max)
+                st->err_max = err;
+            last = after;
+            st->ticks++;
+        }
+        if (pfd[0].revents & POLLIN) {
+            cnt = ece391_read (0, buf, BUFSIZE - 1);
+            st->lines++;
+            ece391_fdputs (1, (uint8_t*)"  line of ");
+            ece391_fdputs (1, ece391_itoa (cnt, buf, 10));
+            ece391_fdputs (1, (uint8_t*)" bytes while the RTC keeps ticking\n");
+        }
+    }
+    st->total = ece391_rdtsc_low () - start;
+}
+
+static void
+report (const char* name, struct poll_stats* st, uint32_t cps, int32_t blocking)
+{
+    uint32_t per_us = cps / 1000000;
+
+    if (0 == st->ticks || 0 == per_us || st->total < 100) {
+        ece391_fdputs (1, (uint8_t*)"no RTC wakeups measured\n");
+        return;
+    }
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_put_num ("", st->ticks, " RTC and ");
+    ece391_put_num ("", st->lines, " stdin wakeups, ");
+    ece391_put_num ("", st->polls / SECONDS, " polls per second\n");
+    ece391_put_num ("  wakeup latency vs 64 Hz: avg ", st->err_sum / st->ticks / per_us, " us, ");
+    ece391_put_num ("max ", st->err_max / per_us, " us\n");
+    /* cycles spent blocked in poll are free for the other terminals */
+    if (blocking)
+        ece391_put_num ("  CPU used: ", 100 - st->blocked / (st->total / 100), "%\n");
+    else
+        ece391_fdputs (1, (uint8_t*)"  CPU used: 100%, poll never sleeps\n");
+}
+
+int main ()
+{
+    struct poll_stats blocking, spinning;
+    int32_t fd, freq = RTC_HZ;
+    uint32_t cps;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open the RTC\n");
+        return 3;
+    }
+    (void)ece391_write (fd, &freq, 4);
+    cps = ece391_rtc_cycles (fd, RTC_HZ);
+
+    blocking.ticks = blocking.lines = blocking.polls = 0;
+    blocking.err_sum = blocking.err_max = blocking.blocked = 0;
+    spinning = blocking;
+
+    ece391_fdputs (1, (uint8_t*)"type lines, stdin and a 64 Hz RTC are polled together\n");
+    run (fd, -1, cps, &blocking);
+    run (fd, 0, cps, &spinning);
+    (void)ece391_close (fd);
+
+    report ("blocking poll: ", &blocking, cps, 1);
+    report ("spinning poll: ", &spinning, cps, 0);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391sysnum.h"
+#include "ece391syscall.h"
+
+#define ROUNDS 3200
+#define BUFSIZE 16
+
+static struct ece391_ring ring;
+
+static void
+report (const char* name, uint32_t cycles)
+{
+    uint8_t buf[BUFSIZE];
+
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_fdputs (1, ece391_itoa (cycles, buf, 10));
+    ece391_fdputs (1, (uint8_t*)" cycles per call\n");
+}
+
+/* Zero-byte writes to stdout, one trap each */
+static uint32_t
+time_traps (uint32_t callnum)
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t i, start;
+
+    start = ece391_rdtsc_low ();
+    for (i = 0; i < ROUNDS; i++) {
+        if (SYS_WRITE == callnum)
+            (void)ece391_write (1, buf, 0);
+        else
+            (void)ece391_getpid ();
+    }
+    return (ece391_rdtsc_low () - start) / ROUNDS;
+}
+
+/* Same calls, a full ring per trap */
+static uint32_t
+time_ring (uint32_t callnum)
+{
+    uint8_t buf[BUFSIZE];
+    uint32_t i, j, start;
+    struct ece391_sqe* sqe;
+
+    start = ece391_rdtsc_low ();
+    for (i = 0; i < ROUNDS; i += RING_ENTRIES) {
+        for (j = 0; j < RING_ENTRIES; j++) {
+            sqe = &ring.sqes[ring.sq_tail % RING_ENTRIES];
+            sqe->callnum = callnum;
+            sqe->args[0] = 1;
+            sqe->args[1] = (uint32_t)buf;
+            sqe->args[2] = 0;
+            sqe->user_data = j;
+            ring.sq_tail++;
+        }
+        (void)ece391_ring_enter (0);
+        ring.cq_head = ring.cq_tail;
+    }
+    return (ece391_rdtsc_low () - start) / ROUNDS;
+}
+
+int main ()
+{
+    if (-1 == ece391_ring_setup (&ring, 0)) {
+        ece391_fdputs (1, (uint8_t*)"ring setup failed\n");
+        return 3;
+    }
+
+    report ("getpid, trap each: ", time_traps (SYS_GETPID));
+    report ("getpid, ring:      ", time_ring (SYS_GETPID));
+    report ("write 0, trap each: ", time_traps (SYS_WRITE));
+    report ("write 0, ring:      ", time_ring (SYS_WRITE));
+
+    (void)ece391_ring_setup (0, 0);
+    return 0;
+}
+
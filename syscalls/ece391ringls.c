@@ -0,0 +1,68 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391sysnum.h"
+#include "ece391syscall.h"
+
+#define SBUFSIZE 33
+#define BATCH 16
+
+static struct ece391_ring ring;
+static uint8_t names[BATCH][SBUFSIZE];
+
+/* Queue one syscall on the submission ring */
+static void
+submit (uint32_t callnum, uint32_t a0, uint32_t a1, uint32_t a2, uint32_t user_data)
+{
+    struct ece391_sqe* sqe = &ring.sqes[ring.sq_tail % RING_ENTRIES];
+
+    sqe->callnum = callnum;
+    sqe->args[0] = a0;
+    sqe->args[1] = a1;
+    sqe->args[2] = a2;
+    sqe->user_data = user_data;
+    ring.sq_tail++;
+}
+
+/* 
+ * ls through the submission ring: each batch of directory reads costs one
+ * trap, and printing the whole batch costs one more.
+ */
+int main ()
+{
+    int32_t fd, i, cnt, done = 0;
+    struct ece391_cqe* cqe;
+
+    if (-1 == ece391_ring_setup (&ring, 0)) {
+        ece391_fdputs (1, (uint8_t*)"ring setup failed\n");
+        return 3;
+    }
+    if (-1 == (fd = ece391_open ((uint8_t*)"."))) {
+        ece391_fdputs (1, (uint8_t*)"directory open failed\n");
+        return 2;
+    }
+
+    while (!done) {
+        for (i = 0; i < BATCH; i++)
+            submit (SYS_READ, fd, (uint32_t)names[i], SBUFSIZE - 1, i);
+        (void)ece391_ring_enter (0);
+
+        /* completions come back in submission order */
+        for (; ring.cq_head != ring.cq_tail; ring.cq_head++) {
+            cqe = &ring.cqes[ring.cq_head % RING_ENTRIES];
+            cnt = cqe->res;
+            if (cnt <= 0) {
+                done = 1;
+                continue;
+            }
+            names[cqe->user_data][cnt] = '\n';
+            submit (SYS_WRITE, 1, (uint32_t)names[cqe->user_data], cnt + 1, 0);
+        }
+        (void)ece391_ring_enter (0);
+        ring.cq_head = ring.cq_tail;
+    }
+
+    (void)ece391_close (fd);
+    return 0;
+}
+
@@ -0,0 +1,131 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define RTC_HZ 256
+#define IDLE_TICKS 512
+#define MAX_TICKS 4096
+#define READS 300
+#define READ_SIZE 40960
+#define BIGFILE "fish"
+#define SBUFSIZE 33
+#define SAVED_STDOUT 7
+
+static uint8_t data[READ_SIZE];
+
+struct lat_stats {
+    uint32_t ticks;         /* RTC periods measured */
+    uint32_t late_sum;      /* sum of cycles past the period */
+    uint32_t late_max;
+};
+
+/* Reader side "-r", read the largest file READS times without blocking */
+static int32_t
+read_loop (void)
+{
+    int32_t fd, i;
+
+    for (i = 0; i < READS; i++) {
+        if (-1 == (fd = ece391_open ((uint8_t*)BIGFILE)))
+            return 3;
+        (void)ece391_read (fd, data, READ_SIZE);
+        (void)ece391_close (fd);
+    }
+    return 0;
+}
+
+/*
+ * Time RTC periods until ticks reach max, or until the pipe hangs up
+ * if hup_fd is not -1.  Lateness is how much a period overran.
+ */
+static void
+measure (int32_t rtc_fd, int32_t hup_fd, uint32_t max, uint32_t period, struct lat_stats* st)
+{
+    struct ece391_pollfd pfd;
+    uint32_t last, now, late;
+    int32_t garbage;
+
+    pfd.fd = hup_fd;
+    pfd.events = POLLIN;
+    st->ticks = st->late_sum = st->late_max = 0;
+
+    (void)ece391_read (rtc_fd, &garbage, 4);
+    last = ece391_rdtsc_low ();
+    while (st->ticks < max) {
+        (void)ece391_read (rtc_fd, &garbage, 4);
+        now = ece391_rdtsc_low ();
+        late = (now - last > period) ? now - last - period : 0;
+        last = now;
+        st->late_sum += late;
+        if (late > st->late_max)
+            st->late_max = late;
+        st->ticks++;
+        if (-1 != hup_fd && 0 < ece391_poll (&pfd, 1, 0) && (pfd.revents & POLLHUP))
+            break;
+    }
+}
+
+static void
+report (const char* name, struct lat_stats* st, uint32_t cps)
+{
+    uint32_t per_us = cps / 1000000;
+
+    if (0 == st->ticks || 0 == per_us) {
+        ece391_fdputs (1, (uint8_t*)"no RTC periods measured\n");
+        return;
+    }
+    ece391_fdputs (1, (uint8_t*)name);
+    ece391_put_num ("", st->ticks, " periods, late by avg ");
+    ece391_put_num ("", st->late_sum / st->ticks / per_us, " us, ");
+    ece391_put_num ("max ", st->late_max / per_us, " us\n");
+}
+
+/*
+ * Scheduling latency of a 256 Hz RTC waiter, alone and while a spawned
+ * reader copies a large file over and over.  The reader never blocks,
+ * so without kernel preemption the waiter only runs between its reads.
+ */
+int main ()
+{
+    struct lat_stats idle, busy;
+    uint8_t arg[SBUFSIZE];
+    int32_t rtc, fds[2], freq = RTC_HZ, cnt;
+    uint32_t cps;
+
+    if (0 == ece391_getargs (arg, SBUFSIZE) && '-' == arg[0] && 'r' == arg[1])
+        return read_loop ();
+
+    if (-1 == (rtc = ece391_open ((uint8_t*)"rtc"))) {
+        ece391_fdputs (1, (uint8_t*)"could not open the RTC\n");
+        return 3;
+    }
+    (void)ece391_write (rtc, &freq, 4);
+    cps = ece391_rtc_cycles (rtc, RTC_HZ);
+
+    measure (rtc, -1, IDLE_TICKS, cps / RTC_HZ, &idle);
+
+    /* the reader keeps the write end as stdout, it hangs up on exit */
+    if (-1 == ece391_pipe (fds))
+        return 3;
+    (void)ece391_dup2 (1, SAVED_STDOUT);
+    (void)ece391_dup2 (fds[1], 1);
+    (void)ece391_close (fds[1]);
+    cnt = ece391_spawn ((uint8_t*)"rtclat -r");
+    (void)ece391_dup2 (SAVED_STDOUT, 1);
+    (void)ece391_close (SAVED_STDOUT);
+    if (-1 == cnt) {
+        ece391_fdputs (1, (uint8_t*)"could not start the reader\n");
+        return 3;
+    }
+
+    measure (rtc, fds[0], MAX_TICKS, cps / RTC_HZ, &busy);
+    while (0 < ece391_read (fds[0], data, READ_SIZE))
+        ;
+    (void)ece391_close (fds[0]);
+    (void)ece391_close (rtc);
+
+    report ("idle:         ", &idle, cps);
+    report ("during reads: ", &busy, cps);
+    return 0;
+}
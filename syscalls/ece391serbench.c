@@ -0,0 +1,86 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define LINES 64
+#define LINE_LEN 64             /* with its new line */
+
+/* Give the CPU away until COM1 has sent every byte queued */
+static void
+drain (void)
+{
+    while (ece391_ioctl (0, TCGETSERIAL, 0) > 0)
+        (void)ece391_yield ();
+}
+
+/* Write the text one line at a time, return the cycles it took */
+static uint32_t
+write_lines (const uint8_t* text)
+{
+    uint32_t start, i;
+
+    start = ece391_rdtsc_low ();
+    for (i = 0; i < LINES; i++)
+        (void)ece391_write (1, text + i * LINE_LEN, LINE_LEN);
+    return ece391_rdtsc_low () - start;
+}
+
+/*
+ * Write the same lines to the screen with the terminal not mirrored and
+ * then mirrored to COM1, and time how long the serial port takes to send
+ * them.  The mirror setting found at start is put back.  Usage: serbench
+ */
+int main ()
+{
+    static uint8_t text[LINES * LINE_LEN];
+    uint32_t plain_cycles, mirror_cycles, serial_cycles, cps, per_us;
+    uint32_t start, bytes, ms, i, j;
+    int32_t mirrored;
+
+    /* stop mirroring, keeping the setting to put back */
+    mirrored = ece391_ioctl (0, TCSETSERIAL, 0);
+    if (-1 == mirrored) {
+        ece391_fdputs (1, (uint8_t*)"serbench: no serial port\n");
+        return 1;
+    }
+
+    for (i = 0; i < LINES; i++) {
+        for (j = 0; j < LINE_LEN - 1; j++)
+            text[i * LINE_LEN + j] = 'a' + (i + j) % 26;
+        text[i * LINE_LEN + j] = '\n';
+    }
+
+    cps = ece391_cycles_per_second ();
+
+    /* the screen alone */
+    plain_cycles = write_lines (text);
+
+    /* the screen and COM1, the port sends while the lines are written */
+    drain ();
+    (void)ece391_ioctl (0, TCSETSERIAL, 1);
+    start = ece391_rdtsc_low ();
+    mirror_cycles = write_lines (text);
+    drain ();
+    serial_cycles = ece391_rdtsc_low () - start;
+    (void)ece391_ioctl (0, TCSETSERIAL, mirrored);
+
+    /* every new line goes out as CR LF */
+    bytes = LINES * (LINE_LEN + 1);
+    per_us = cps / 1000000;
+    ece391_put_num ("screen only:   ", plain_cycles / LINES, " cycles per line");
+    if (0 != per_us)
+        ece391_put_num (", ", plain_cycles / per_us, " us in all");
+    ece391_put_num ("\nscreen + COM1: ", mirror_cycles / LINES, " cycles per line");
+    if (0 != per_us)
+        ece391_put_num (", ", mirror_cycles / per_us, " us in all");
+    ece391_put_num ("\nCOM1: ", bytes, " bytes");
+    ms = (0 != per_us) ? serial_cycles / per_us / 1000 : 0;
+    if (0 != ms) {
+        ece391_put_num (" in ", ms, " ms, ");
+        ece391_put_num ("", bytes * 1000 / ms, " bytes/s\n");
+    } else {
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+    return 0;
+}
@@ -4,15 +4,56 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define SAVED_STDIN 6
+#define SAVED_STDOUT 7
+
+/*
+ * Run "left | right".  left is spawned with stdout on the pipe, then
+ * right is executed with stdin on it; the execute returns once both
+ * have halted.  The terminal is kept in spare FDs meanwhile.
+ */
+static int32_t
+run_pipeline (uint8_t* left, uint8_t* right)
+{
+    int32_t fds[2], rval = -1;
+
+    if (-1 == ece391_pipe (fds))
+        return -1;
+    (void)ece391_dup2 (0, SAVED_STDIN);
+    (void)ece391_dup2 (1, SAVED_STDOUT);
+
+    (void)ece391_dup2 (fds[1], 1);
+    (void)ece391_close (fds[1]);
+    if (-1 != ece391_spawn (left)) {
+        (void)ece391_dup2 (SAVED_STDOUT, 1);
+        (void)ece391_dup2 (fds[0], 0);
+        rval = ece391_execute (right);
+    }
+
+    /* restoring the terminal also drops the last ends of the pipe here */
+    (void)ece391_dup2 (SAVED_STDIN, 0);
+    (void)ece391_dup2 (SAVED_STDOUT, 1);
+    (void)ece391_close (fds[0]);
+    (void)ece391_close (SAVED_STDIN);
+    (void)ece391_close (SAVED_STDOUT);
+    return rval;
+}
 
 int main ()
 {
-    int32_t cnt, rval;
+    int32_t cnt, rval, bar;
     uint8_t buf[BUFSIZE];
-    ece391_fdputs (1, (uint8_t*)"Starting 391 Shell\n");
+    struct ece391_iovec iov[2];
+    const char* status = "Starting 391 Shell\n";
 
     while (1) {
-        ece391_fdputs (1, (uint8_t*)"391OS> ");
+        /* status of the last command and the prompt go out in one trap */
+        iov[0].iov_base = (void*)status;
+        iov[0].iov_len = ece391_strlen ((uint8_t*)status);
+        iov[1].iov_base = "391OS> ";
+        iov[1].iov_len = 7;
+        (void)ece391_writev (1, iov, 2);
+        status = "";
 	if (-1 == (cnt = ece391_read (0, buf, BUFSIZE-1))) {
 	    ece391_fdputs (1, (uint8_t*)"read from keyboard failed\n");
 	    return 3;
@@ -24,13 +65,19 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = ece391_execute (buf);
+	for (bar = 0; '\0' != buf[bar] && '|' != buf[bar]; bar++);
+	if ('|' == buf[bar]) {
+	    buf[bar] = '\0';
+	    rval = run_pipeline (buf, buf + bar + 1);
+	} else {
+	    rval = ece391_execute (buf);
+	}
 	if (-1 == rval)
-	    ece391_fdputs (1, (uint8_t*)"no such command\n");
+	    status = "no such command\n";
 	else if (256 == rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated by exception\n");
+	    status = "program terminated by exception\n";
 	else if (0 != rval)
-	    ece391_fdputs (1, (uint8_t*)"program terminated abnormally\n");
+	    status = "program terminated abnormally\n";
     }
 }
 
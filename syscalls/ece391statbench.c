@@ -0,0 +1,87 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define FRAMES 200
+#define COLS 80
+#define ROWS 24                 /* the last row would scroll */
+#define FIELD 5                 /* digits of the frame counter */
+
+/* Append s to buf at *len */
+static void
+append (uint8_t* buf, uint32_t* len, const char* s)
+{
+    while ('\0' != *s)
+        buf[(*len)++] = *s++;
+}
+
+/* Write frame as FIELD digits with leading zeros at buf */
+static void
+put_field (uint8_t* buf, uint32_t frame)
+{
+    int32_t i;
+
+    for (i = FIELD - 1; i >= 0; i--) {
+        buf[i] = '0' + frame % 10;
+        frame /= 10;
+    }
+}
+
+/*
+ * Redraw the screen FRAMES times with a frame counter in a status line
+ * at the top, first by writing every cell, then by writing only the
+ * counter with escape sequences.  Usage: statbench
+ */
+int main ()
+{
+    static uint8_t full[COLS * ROWS + 8];
+    uint8_t status[48];
+    uint32_t full_len = 0, status_len = 0, full_at, status_at, cps, per_us;
+    uint32_t full_cycles, status_cycles, start, frame, i;
+
+    /* cursor home, the status row, then text rows */
+    append (full, &full_len, "\033[H");
+    full_at = full_len + 6;
+    append (full, &full_len, "frame 00000");
+    for (i = 11; i < COLS; i++)
+        full[full_len++] = ' ';
+    for (i = COLS; i < COLS * ROWS; i++)
+        full[full_len++] = 'a' + i % 26;
+
+    /* the counter only: move there, write it in reverse video */
+    append (status, &status_len, "\033[1;7H\033[7m");
+    status_at = status_len;
+    append (status, &status_len, "00000\033[m");
+
+    cps = ece391_cycles_per_second ();
+    (void)ece391_fdputs (1, (uint8_t*)"\033[2J");
+
+    start = ece391_rdtsc_low ();
+    for (frame = 0; frame < FRAMES; frame++) {
+        put_field (full + full_at, frame);
+        (void)ece391_write (1, full, full_len);
+    }
+    full_cycles = ece391_rdtsc_low () - start;
+
+    start = ece391_rdtsc_low ();
+    for (frame = 0; frame < FRAMES; frame++) {
+        put_field (status + status_at, frame);
+        (void)ece391_write (1, status, status_len);
+    }
+    status_cycles = ece391_rdtsc_low () - start;
+
+    (void)ece391_fdputs (1, (uint8_t*)"\033[2J\033[H");
+    per_us = cps / 1000000;
+    ece391_put_num ("full rewrite: ", full_len, " bytes, ");
+    ece391_put_num ("", full_cycles / FRAMES, " cycles per frame");
+    if (0 != per_us)
+        ece391_put_num (", ", full_cycles / FRAMES / per_us, " us");
+    ece391_put_num ("\nstatus line:  ", status_len, " bytes, ");
+    ece391_put_num ("", status_cycles / FRAMES, " cycles per frame");
+    if (0 != per_us)
+        ece391_put_num (", ", status_cycles / FRAMES / per_us, " us");
+    if (0 != status_cycles)
+        ece391_put_num ("\nspeedup: ", full_cycles / status_cycles, "x\n");
+    return 0;
+}
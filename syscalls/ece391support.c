@@ -102,3 +102,49 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+
+/* Read the time stamp counter, only the low word is needed for deltas */
+uint32_t ece391_rdtsc_low(void)
+{
+    uint32_t low, high;
+
+    asm volatile ("rdtsc" : "=a" (low), "=d" (high));
+    return low;
+}
+
+/* Print a decimal number to stdout between two strings */
+void ece391_put_num(const char* before, uint32_t num, const char* after)
+{
+    uint8_t buf[ECE391_NUMSIZE];
+
+    ece391_fdputs (1, (uint8_t*)before);
+    ece391_fdputs (1, ece391_itoa (num, buf, 10));
+    ece391_fdputs (1, (uint8_t*)after);
+}
+
+/* Cycles per second timed over one period of an RTC FD already set to hz */
+uint32_t ece391_rtc_cycles(int32_t rtc_fd, uint32_t hz)
+{
+    int32_t garbage;
+    uint32_t start;
+
+    /* line up with a tick first */
+    (void)ece391_read (rtc_fd, &garbage, 4);
+    start = ece391_rdtsc_low ();
+    (void)ece391_read (rtc_fd, &garbage, 4);
+    return (ece391_rdtsc_low () - start) * hz;
+}
+
+/* Cycles per second with the RTC at ECE391_RTC_HZ, 0 if it is in use */
+uint32_t ece391_cycles_per_second(void)
+{
+    int32_t fd, freq = ECE391_RTC_HZ;
+    uint32_t cps;
+
+    if (-1 == (fd = ece391_open ((uint8_t*)"rtc")))
+        return 0;
+    (void)ece391_write (fd, &freq, 4);
+    cps = ece391_rtc_cycles (fd, ECE391_RTC_HZ);
+    (void)ece391_close (fd);
+    return cps;
+}
@@ -9,5 +9,13 @@ extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
 
+/* Timing helpers shared by the benchmarks */
+#define ECE391_NUMSIZE 33       /* 32 binary digits and the NUL */
+#define ECE391_RTC_HZ 4
+extern uint32_t ece391_rdtsc_low(void);
+extern void ece391_put_num(const char* before, uint32_t num, const char* after);
+extern uint32_t ece391_rtc_cycles(int32_t rtc_fd, uint32_t hz);
+extern uint32_t ece391_cycles_per_second(void);
+
 #endif /* ECE391SUPPORT_H */
 
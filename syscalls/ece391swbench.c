@@ -0,0 +1,183 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define ROUNDS 10000
+#define SBUFSIZE 33
+#define SAVED_STDIN 6
+#define SAVED_STDOUT 7
+
+/* Child side "-c", send every byte back until stdin is closed */
+static int32_t
+echo (void)
+{
+    uint8_t b;
+
+    while (1 == ece391_read (0, &b, 1))
+        if (1 != ece391_write (1, &b, 1))
+            return 2;
+    return 0;
+}
+
+/* Child side "-y", yield back to the parent for every one of its yields */
+static int32_t
+yield_loop (void)
+{
+    int32_t i;
+
+    for (i = 0; i < ROUNDS; i++)
+        (void)ece391_yield ();
+    return 0;
+}
+
+/* Start "swbench <arg>" with stdout on a pipe, returns the read end */
+static int32_t
+spawn_child (const char* cmd)
+{
+    int32_t fds[2], pid;
+
+    if (-1 == ece391_pipe (fds))
+        return -1;
+    (void)ece391_dup2 (1, SAVED_STDOUT);
+    (void)ece391_dup2 (fds[1], 1);
+    (void)ece391_close (fds[1]);
+    pid = ece391_spawn ((uint8_t*)cmd);
+    (void)ece391_dup2 (SAVED_STDOUT, 1);
+    (void)ece391_close (SAVED_STDOUT);
+    if (-1 == pid) {
+        (void)ece391_close (fds[0]);
+        return -1;
+    }
+    return fds[0];
+}
+
+/*
+ * Yield back and forth with a yielding child, every yield of this
+ * process switches to the child and back.  Returns cycles per switch.
+ */
+static uint32_t
+time_yield (void)
+{
+    int32_t fd, i;
+    uint32_t start;
+    uint8_t b;
+
+    if (-1 == (fd = spawn_child ("swbench -y")))
+        return 0;
+    start = ece391_rdtsc_low ();
+    for (i = 0; i < ROUNDS; i++)
+        (void)ece391_yield ();
+    start = ece391_rdtsc_low () - start;
+
+    /* the pipe reads end of file once the child halted */
+    while (0 < ece391_read (fd, &b, 1))
+        ;
+    (void)ece391_close (fd);
+    return start / (2 * ROUNDS);
+}
+
+/* One byte through a pipe and back in one process, nothing switches */
+static uint32_t
+time_alone (void)
+{
+    int32_t fds[2], i;
+    uint32_t start;
+    uint8_t b = 0;
+
+    if (-1 == ece391_pipe (fds))
+        return 0;
+    start = ece391_rdtsc_low ();
+    for (i = 0; i < ROUNDS; i++) {
+        (void)ece391_write (fds[1], &b, 1);
+        (void)ece391_read (fds[0], &b, 1);
+    }
+    start = ece391_rdtsc_low () - start;
+    (void)ece391_close (fds[0]);
+    (void)ece391_close (fds[1]);
+    return start / ROUNDS;
+}
+
+/*
+ * One byte to the echo child and back.  Each read waits on an empty
+ * pipe, so every round trip switches to the child and back once.
+ */
+static uint32_t
+time_pingpong (void)
+{
+    int32_t to_child[2], to_parent[2], pid, i;
+    uint32_t start;
+    uint8_t b = 0;
+
+    if (-1 == ece391_pipe (to_child))
+        return 0;
+    if (-1 == ece391_pipe (to_parent)) {
+        (void)ece391_close (to_child[0]);
+        (void)ece391_close (to_child[1]);
+        return 0;
+    }
+    (void)ece391_dup2 (0, SAVED_STDIN);
+    (void)ece391_dup2 (1, SAVED_STDOUT);
+    (void)ece391_dup2 (to_child[0], 0);
+    (void)ece391_dup2 (to_parent[1], 1);
+    (void)ece391_close (to_child[0]);
+    (void)ece391_close (to_parent[1]);
+    pid = ece391_spawn ((uint8_t*)"swbench -c");
+    (void)ece391_dup2 (SAVED_STDIN, 0);
+    (void)ece391_dup2 (SAVED_STDOUT, 1);
+    (void)ece391_close (SAVED_STDIN);
+    (void)ece391_close (SAVED_STDOUT);
+    if (-1 == pid) {
+        (void)ece391_close (to_child[1]);
+        (void)ece391_close (to_parent[0]);
+        return 0;
+    }
+
+    start = ece391_rdtsc_low ();
+    for (i = 0; i < ROUNDS; i++) {
+        (void)ece391_write (to_child[1], &b, 1);
+        (void)ece391_read (to_parent[0], &b, 1);
+    }
+    start = ece391_rdtsc_low () - start;
+
+    /* the child sees end of file and halts */
+    (void)ece391_close (to_child[1]);
+    while (0 < ece391_read (to_parent[0], &b, 1))
+        ;
+    (void)ece391_close (to_parent[0]);
+    return start / ROUNDS;
+}
+
+int main ()
+{
+    uint8_t arg[SBUFSIZE];
+    uint32_t alone, pingpong, yield, cps;
+
+    if (0 == ece391_getargs (arg, SBUFSIZE) && '-' == arg[0]) {
+        if ('c' == arg[1])
+            return echo ();
+        if ('y' == arg[1])
+            return yield_loop ();
+    }
+
+    alone = time_alone ();
+    if (0 == (pingpong = time_pingpong ())) {
+        ece391_fdputs (1, (uint8_t*)"could not start the echo child\n");
+        return 3;
+    }
+
+    ece391_put_num ("pipe round trip alone: ", alone, " cycles\n");
+    ece391_put_num ("ping-pong round trip:  ", pingpong, " cycles\n");
+    /* the child does the same pipe calls, the rest is two switches */
+    if (pingpong > 2 * alone)
+        ece391_put_num ("switch cost:           ", (pingpong - 2 * alone) / 2, " cycles\n");
+
+    cps = ece391_cycles_per_second ();
+    if (0 == (yield = time_yield ())) {
+        ece391_fdputs (1, (uint8_t*)"could not start the yield child\n");
+        return 3;
+    }
+    ece391_put_num ("yield ping-pong:       ", yield, " cycles per switch");
+    ece391_put_num (", ", cps / yield, " switches per second\n");
+    return 0;
+}
@@ -21,6 +21,151 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+extern int32_t ece391_getpid (void);
+
+/* One segment of a readv/writev call, at most 16 segments per call. */
+struct ece391_iovec {
+    void* iov_base;
+    int32_t iov_len;
+};
+extern int32_t ece391_readv (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+extern int32_t ece391_writev (int32_t fd, const struct ece391_iovec* iov, int32_t iovcnt);
+
+/*
+ * Batched submission ring.  The program fills sqes[sq_tail % RING_ENTRIES]
+ * with a syscall number and its three arguments, bumps sq_tail, then calls
+ * ece391_ring_enter once for the whole batch.  Results show up in cqes
+ * between cq_head and cq_tail.  Only read, write, open, close, getpid,
+ * readv, writev, pipe and dup2 may be submitted.  With RING_F_TICK the
+ * kernel also runs entries that do not wait (everything but RTC and
+ * terminal reads and pipe reads and writes) when the scheduler tick
+ * returns to the program.
+ */
+#define RING_ENTRIES 32
+#define RING_F_TICK 0x1
+
+struct ece391_sqe {
+    uint32_t callnum;
+    uint32_t args[3];
+    uint32_t user_data;
+};
+
+struct ece391_cqe {
+    uint32_t user_data;
+    int32_t res;
+};
+
+struct ece391_ring {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    struct ece391_sqe sqes[RING_ENTRIES];
+    struct ece391_cqe cqes[RING_ENTRIES];
+};
+extern int32_t ece391_ring_setup (struct ece391_ring* ring, uint32_t flags);
+extern int32_t ece391_ring_enter (uint32_t to_submit);
+
+/*
+ * Pipes.  ece391_pipe fills fds[0] with the read end and fds[1] with the
+ * write end.  Reads wait for data and return 0 once every write end is
+ * closed; writes wait for space and fail once every read end is closed.
+ * ece391_dup2 makes newfd (stdin and stdout included) refer to oldfd.
+ * Programs started by execute or ece391_spawn get the caller's stdin and
+ * stdout.  ece391_spawn returns the PID at once instead of waiting; the
+ * program runs whenever the caller waits.  The caller's next execute
+ * returns only after its spawned programs halt.
+ */
+extern int32_t ece391_pipe (int32_t* fds);
+extern int32_t ece391_dup2 (int32_t oldfd, int32_t newfd);
+extern int32_t ece391_spawn (const uint8_t* command);
+
+/*
+ * Wait until one of up to 8 FDs is ready.  revents gets POLLIN or POLLOUT
+ * as asked in events, POLLHUP when the other end of a pipe is closed, and
+ * POLLNVAL when the FD is not open; entries with a negative fd are
+ * skipped.  stdin is readable once a line is ready, an RTC FD once its
+ * period has passed.  timeout is in ms, 0 only checks, -1 waits forever.
+ * Returns the number of entries with revents set, 0 on timeout.
+ */
+#define POLLIN   0x01
+#define POLLOUT  0x04
+#define POLLHUP  0x10
+#define POLLNVAL 0x20
+
+struct ece391_pollfd {
+    int32_t fd;
+    int16_t events;
+    int16_t revents;
+};
+extern int32_t ece391_poll (struct ece391_pollfd* fds, int32_t nfds, int32_t timeout);
+
+/*
+ * Change how a FD behaves.  F_SETFL with O_NONBLOCK makes reads and
+ * writes return at once: stdin returns 0 when nothing was typed, a pipe
+ * returns -1 when it is empty or full.  On stdin, TCSETMODE picks line
+ * mode (TERM_COOKED), or TERM_CBREAK / TERM_RAW where every key is
+ * readable as typed, echoed in cbreak only.  TCSETTIMEOUT makes stdin
+ * reads return 0 after the given ms, 0 waits forever.  The mode and
+ * timeout are undone when the program halts.  Keys typed while nobody
+ * reads are kept; TCGETLOST returns how many were dropped because the
+ * input ring or the line typed was full.  TCSETVIDBUF 1 makes the vidmap
+ * page a RAM page that reaches the screen only through ece391_vidflush,
+ * 0 maps the screen again; only the program which turned it on may turn
+ * it off, and its halt does so.  TCSETSERIAL 1 copies what the terminal shows
+ * to COM1 as well, 0 stops, and returns the setting it replaced; other
+ * terminals keep theirs.  TCGETSERIAL returns the bytes still waiting to
+ * go out on the line, 0 only once the line is idle, -1 if there is no
+ * serial port.
+ */
+#define F_GETFL      1
+#define F_SETFL      2
+#define TCGETMODE    3
+#define TCSETMODE    4
+#define TCSETTIMEOUT 5
+#define TCGETLOST    6
+#define TCSETVIDBUF  7
+#define TCSETSERIAL  8
+#define TCGETSERIAL  9
+
+#define O_NONBLOCK   0x1
+
+#define TERM_COOKED  0
+#define TERM_CBREAK  1
+#define TERM_RAW     2
+
+extern int32_t ece391_ioctl (int32_t fd, uint32_t request, uint32_t arg);
+
+/*
+ * Give up the rest of the time slice.  Another process of the terminal
+ * runs if one can, otherwise the next terminal.  Returns 0 once this
+ * program runs again.
+ */
+extern int32_t ece391_yield (void);
+
+/*
+ * Copy the rows changed in a vidmap page buffered by TCSETVIDBUF to the
+ * screen.  Returns the rows copied, -1 if the vidmap is not buffered.
+ */
+extern int32_t ece391_vidflush (void);
+
+/*
+ * Switch the screen to a Bochs VBE graphics mode while the terminal of
+ * this program is shown, 8 bpp pixels are RRRGGGBB.  Width 320 to 1024
+ * in steps of 8, height 200 to 768, bpp 8, 16 or 32.  All 0 goes back
+ * to text mode, so does halting.  Returns 0, or -1 if the mode is not
+ * supported or another program has the framebuffer.
+ */
+extern int32_t ece391_setmode (uint32_t width, uint32_t height, uint32_t bpp);
+
+/*
+ * Map the framebuffer of the mode set, rows are width * bpp / 8 bytes
+ * apart.  The pages are write combining, so plain stores are fast.
+ */
+extern int32_t ece391_fbmap (uint8_t** fb_start);
+
+/* Nonzero if wrappers enter through SYSENTER instead of INT 0x80. */
+extern int32_t ece391_fast_syscall;
 
 enum signums {
 	DIV_ZERO = 0,
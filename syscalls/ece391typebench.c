@@ -0,0 +1,64 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 1024
+#define SBUFSIZE 33
+#define RTC_HZ 4
+#define HOLD_SECONDS 2
+#define IDLE_MS 3000
+
+/*
+ * Count keys typed into this terminal, e.g. by sendkeys.sh through the
+ * QEMU monitor.  Nothing is read for HOLD_SECONDS after the first key,
+ * so those keys must survive as typeahead.  Stops once no key arrives
+ * for IDLE_MS.  Each line counts its new line as a key.
+ */
+int main ()
+{
+    static uint8_t buf[BUFSIZE];
+    uint8_t arg[SBUFSIZE], *p;
+    struct ece391_pollfd pfd;
+    int32_t rtc, freq = RTC_HZ, garbage, cnt, i;
+    uint32_t expected = 0, keys = 0, lost, start, cycles, cps;
+
+    if (0 == ece391_getargs (arg, SBUFSIZE))
+        for (p = arg; *p >= '0' && *p <= '9'; p++)
+            expected = expected * 10 + (*p - '0');
+    if (-1 == (rtc = ece391_open ((uint8_t*)"rtc")))
+        return 3;
+    (void)ece391_write (rtc, &freq, 4);
+    lost = ece391_ioctl (0, TCGETLOST, 0);
+
+    ece391_fdputs (1, (uint8_t*)"start typing or sendkeys.sh\n");
+    pfd.fd = 0;
+    pfd.events = POLLIN;
+    (void)ece391_poll (&pfd, 1, -1);
+
+    /* leave the keys in the input ring for a while, and time the RTC */
+    start = ece391_rdtsc_low ();
+    cps = ece391_rtc_cycles (rtc, RTC_HZ);
+    for (i = 2; i < HOLD_SECONDS * RTC_HZ; i++)
+        (void)ece391_read (rtc, &garbage, 4);
+    (void)ece391_close (rtc);
+
+    cycles = ece391_rdtsc_low ();
+    while (0 < ece391_poll (&pfd, 1, IDLE_MS)) {
+        if (-1 == (cnt = ece391_read (0, buf, BUFSIZE)))
+            return 3;
+        keys += cnt + 1;
+        cycles = ece391_rdtsc_low ();
+    }
+    cycles -= start;
+    lost = ece391_ioctl (0, TCGETLOST, 0) - lost;
+
+    ece391_put_num ("", keys, " keys");
+    if (0 != keys && 0 != cps && cycles / keys != 0)
+        ece391_put_num (" at ", cps / (cycles / keys), " keys per second");
+    ece391_put_num (", ", lost, " dropped by the kernel");
+    if (0 != expected)
+        ece391_put_num (", ", expected > keys ? expected - keys : 0, " missing");
+    ece391_fdputs (1, (uint8_t*)"\n");
+    return 0;
+}